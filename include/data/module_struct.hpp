@@ -1,6 +1,8 @@
 #ifndef OWASM_VM_MODULE_STRUCT_HPP
 #define OWASM_VM_MODULE_STRUCT_HPP
 
+#include <memory>
+#include <span>
 #include <vector>
 #include <string>
 #include "data/types.hpp"
@@ -25,6 +27,8 @@ enum class SectionType : u8 {
 struct Limits {
     u32 min;
     u32 max;
+    bool hasMax;
+    bool shared;
 };
 
 struct FuncSignature {
@@ -101,13 +105,15 @@ struct LocalVar {
 
 struct FunctionBody {
     std::vector<LocalVar> locals;
-    std::vector<u8> code;  // function body (instructions + 0x0B)
+    std::span<const u8> code;  // function body (instructions + 0x0B), in WasmModule::bytes
 };
 
 struct DataSegment {
+    bool passive;     // only used by memory.init, has no memory and offset
     u32 memIndex;
     std::vector<u8> offsetExpr;
-    std::vector<u8> data;
+    std::span<const u8> data;   // in WasmModule::bytes
+    u64 fileOffset;   // of data in the module file
 };
 
 struct DataCountSection {
@@ -119,6 +125,9 @@ struct FuncIndex {
 };
 
 struct WasmModule {
+    std::string path;   // module file, data segments may be mapped from it
+    // Keeps the bytes that function bodies and data segments point into, like the mapped file
+    std::shared_ptr<const void> bytes;
     std::vector<CustomSection> customSection;
     std::vector<FuncSignature> typesSection;
     std::vector<Import> importSection;
@@ -5,6 +5,7 @@
 #include <cstdint>
 namespace omega::wass {
 using u8  = uint8_t;
+using u16 = uint16_t;
 using u32 = uint32_t;
 using u64 = uint64_t;
 using i32 = int32_t;
@@ -17,6 +18,7 @@ enum ValType : u8 {
     I64   = 0x7E,
     F32   = 0x7D,
     F64   = 0x7C,
+    V128  = 0x7B,
     BLOCK = 0x40,
     REF   = 0x78
 };
@@ -69,6 +71,7 @@ constexpr u8 var        = 0x01;
 namespace lims {
 constexpr u8 min_flag = 0x00;
 constexpr u8 max_flag = 0x01;
+constexpr u8 shared_flag = 0x02;   // threads proposal, only valid together with max_flag
 }
 
 namespace expr {
@@ -0,0 +1,24 @@
+#ifndef OWASM_VM_AOT_HPP
+#define OWASM_VM_AOT_HPP
+#include "runtime/compiled_module.hpp"
+#include <dlfcn.h>
+#include <memory>
+#include <string>
+
+namespace omega::wass {
+
+using AotLibrary = std::unique_ptr<void, int (*)(void *)>;
+
+// Translates the module into C. Every function whose body uses supported opcodes becomes a C
+// function with the calling convention of compiled code (frame base and JitRuntime), exported
+// through a table indexed by function; the others are left to the stack tier.
+std::string translateModuleToC(const CompiledModule &compiled_module);
+
+// Loads the ahead-of-time compiled module from so_path. When the file is missing or was built
+// from a different module, the C translation is compiled into it first with the system C
+// compiler ($OWASM_AOT_CC, a program name or path, clang by default). Sets
+// RuntimeFunction::jitCode of the compiled functions, the library has to stay loaded while they run.
+AotLibrary loadAotModule(CompiledModule &compiled_module, const std::string &so_path);
+
+}
+#endif //OWASM_VM_AOT_HPP
@@ -0,0 +1,41 @@
+#ifndef OWASM_VM_ATOMICS_HPP
+#define OWASM_VM_ATOMICS_HPP
+#include "runtime_structs.hpp"
+#include <stdexcept>
+
+namespace omega::wass::atomics {
+
+enum class Rmw : u8 { Add, Sub, And, Or, Xor, Xchg };
+
+// Access width and value type of a 0xFE load, store or read-modify-write sub-opcode
+struct Access {
+    u8 size;
+    ValType type;
+};
+
+Access access(u32 sub_op);
+Rmw rmwOp(u32 sub_op);
+
+// Sequentially consistent accesses of size bytes at an aligned address, values zero-extended
+u64 load(const u8 *address, u32 size);
+void store(u8 *address, u32 size, u64 value);
+u64 rmw(u8 *address, u32 size, Rmw op, u64 value);   // returns the old value
+u64 cmpxchg(u8 *address, u32 size, u64 expected, u64 replacement);
+
+// Effective address of an atomic access, which traps unless it is naturally aligned.
+// Out of bounds addresses fault like plain loads and stores.
+inline u8 *address(u8 *memory, WasmVal addr, const AtomicOp &op) {
+    u64 effective = u64{static_cast<u32>(addr.i)} + op.offset;
+    if (effective & (op.size - 1)) {
+        throw std::runtime_error("unaligned atomic");
+    }
+    return memory + effective;
+}
+
+// i32 results are kept sign-extended in their slot
+inline i64 result(u64 value, const AtomicOp &op) {
+    return op.wide ? static_cast<i64>(value) : static_cast<i32>(value);
+}
+
+}
+#endif //OWASM_VM_ATOMICS_HPP
@@ -215,6 +215,137 @@ enum Bytecode : u8 {
     f64_reinterpret_i64 = 0xBF
 };
 
+// Internal opcodes of the pre-decoded instruction stream, placed after the single-byte Wasm opcode space
+enum InternalBytecode : u16 {
+    unsupported         = 0x100,  // imm holds the original Wasm opcode
+    // superinstructions of the stack tier
+    i32_add_local_const,          // local.get; i32.const; i32.add
+    br_if_i32_ne,                 // i32.ne; br_if
+    br_if_i32_lt_s_locals,        // local.get; local.get; i32.lt_s; br_if, branch target in the following slot
+    loop_header,                  // tier-up counter at the start of a loop, imm holds the loop index
+    // 0xFC bulk memory opcodes, resolved at load time and kept in the order of their sub-opcodes
+    memory_init,                  // imm holds the data segment
+    data_drop,                    // imm holds the data segment
+    memory_copy,
+    memory_fill,
+    // 0xFD opcodes by operand shape, imm.simd holds the sub-opcode picking the kernel.
+    // Upper halves of v128 values live in the shadow slots of the value stack.
+    v128_const,                   // imm holds the low half, the high half follows as a data slot
+    v128_load,
+    v128_load8,                   // narrower loads, widened by the kernel
+    v128_load16,
+    v128_load32,
+    v128_load64,
+    v128_store,
+    v128_load_lane,
+    v128_store_lane,
+    i8x16_shuffle,                // imm holds lane indices 0-7, indices 8-15 follow as a data slot
+    v128_unary,
+    v128_binary,
+    v128_ternary,
+    v128_test,
+    v128_shift,
+    v128_splat,
+    v128_extract_lane,
+    v128_replace_lane,
+    // local and select opcodes that also move the upper halves
+    v128_local_get,
+    v128_local_set,
+    v128_local_tee,
+    select_v128,                  // select in functions with v128 values, whatever the operand type
+    // 0xFE opcodes, imm.atomic holds the offset and access width
+    atomic_load,
+    atomic_store,
+    atomic_rmw,
+    atomic_cmpxchg,
+    memory_atomic_wait,
+    memory_atomic_notify,
+    atomic_fence,
+};
+
+// Opcodes of the register tier, operands are frame register indices
+namespace reg {
+enum RegBytecode : u16 {
+    unreachable,
+    unsupported,    // imm holds the original Wasm opcode
+    mov,            // dst = lhs
+    copy,           // dst[0..imm) = lhs[0..imm)
+    i32_const,      // dst = imm
+    i32_add,        // dst = lhs op rhs
+    i32_sub,
+    i32_and,
+    i32_ne,
+    i32_lt_s,
+    select,         // dst = imm ? lhs : rhs
+    // dst = load(memory + lhs + imm), in the order of the Wasm load opcodes
+    i32_load,
+    i64_load,
+    f32_load,
+    f64_load,
+    i32_load8_s,
+    i32_load8_u,
+    i32_load16_s,
+    i32_load16_u,
+    i64_load8_s,
+    i64_load8_u,
+    i64_load16_s,
+    i64_load16_u,
+    i64_load32_s,
+    i64_load32_u,
+    // store(memory + lhs + imm, rhs), in the order of the Wasm store opcodes
+    i32_store,
+    i64_store,
+    f32_store,
+    f64_store,
+    i32_store8,
+    i32_store16,
+    i64_store8,
+    i64_store16,
+    i64_store32,
+    memory_size,    // dst = pages of memory 0
+    memory_grow,    // dst = previous pages or -1, grown by lhs pages
+    // bulk memory with destination dst, source or value lhs, length rhs, in the order of the 0xFC sub-opcodes
+    memory_init,    // imm holds the data segment
+    data_drop,      // imm holds the data segment
+    memory_copy,
+    memory_fill,
+    br,             // ip = imm
+    br_if,          // if lhs: ip = imm
+    br_unless,      // if !lhs: ip = imm
+    br_table,       // label slots follow, default last
+    call,           // callee imm, arguments and results start at dst
+    return_,        // results start at lhs
+};
+}
+
+// Prefix bytes of multi-byte Wasm opcodes
+namespace prefix {
+constexpr u8 misc    = 0xFC;
+constexpr u8 simd    = 0xFD;
+constexpr u8 atomic  = 0xFE;
+}
+
+// Sub-opcodes of the 0xFC prefix
+namespace misc {
+constexpr u32 memory_init = 8;
+constexpr u32 data_drop   = 9;
+constexpr u32 memory_copy = 10;
+constexpr u32 memory_fill = 11;
+}
+
+// Sub-opcodes of the 0xFE prefix. Loads, stores and every read-modify-write operation come in
+// seven widths: i32, i64, i32 8u, i32 16u, i64 8u, i64 16u, i64 32u.
+namespace atomic {
+constexpr u32 memory_notify = 0x00;
+constexpr u32 memory_wait32 = 0x01;
+constexpr u32 memory_wait64 = 0x02;
+constexpr u32 fence         = 0x03;
+constexpr u32 load          = 0x10;
+constexpr u32 store         = 0x17;
+constexpr u32 rmw_add       = 0x1E;   // then sub, and, or, xor, xchg
+constexpr u32 rmw_cmpxchg   = 0x48;
+constexpr u32 last          = 0x4E;
+}
 
 
 
@@ -0,0 +1,78 @@
+#ifndef OWASM_VM_COMPILED_MODULE_HPP
+#define OWASM_VM_COMPILED_MODULE_HPP
+#include "runtime_structs.hpp"
+#include "options.hpp"
+#include <mutex>
+
+namespace omega::wass {
+class JitCompiler;
+struct ModuleTypes;
+
+// Everything derived from a module alone: the parsed module, translated function bodies with
+// their signatures and resolved imports, and compiled code. It does not change once built, so
+// any number of instances (Stores) share one and instantiating costs only their own memories,
+// globals and data segments. Tier-up counters and compiled entries of the functions are a code
+// cache, updated in place for all instances alike from whatever thread runs them, see
+// loadShared. So are the functions the lazy option leaves pending until their first call.
+class CompiledModule {
+public:
+    // Translates for the tier in options, falling back to the stack tier where the module needs
+    // it. handlers are the dispatch tables of the stack and register tiers.
+    CompiledModule(module::WasmModule module, const RuntimeOptions &options,
+                   HandlerTable stack_handlers, HandlerTable reg_handlers);
+    // Takes the functions defined by the module as translated before for the same options into
+    // code of tier, like from the module cache. Imports are resolved here.
+    CompiledModule(module::WasmModule module, const RuntimeOptions &options, ExecTier tier,
+                   FunctionsContainer defined);
+    CompiledModule(const CompiledModule &) = delete;
+    CompiledModule &operator=(const CompiledModule &) = delete;
+    ~CompiledModule();
+
+    // data segments and compiled code point into the module, it stays in place
+    const module::WasmModule &module() const { return module_; }
+    // options as adjusted to the module, with the tier the code was translated for
+    const RuntimeOptions &options() const { return options_; }
+    RuntimeFunction &getFunc(u32 f_ind) { return funcs_[f_ind]; }
+    const RuntimeFunction &getFunc(u32 f_ind) const { return funcs_[f_ind]; }
+    // Function f_ind ready to run, validated and translated first when it is still pending.
+    // Throws when its body is invalid, it stays pending then.
+    RuntimeFunction &readyFunc(u32 f_ind) {
+        RuntimeFunction &f = funcs_[f_ind];
+        if (loadShared(f.pending)) [[unlikely]] {
+            translate(f_ind);
+        }
+        return f;
+    }
+    u32 funcCount() const { return funcs_.size(); }
+    u32 funcIndex(const RuntimeFunction &f) const { return &f - funcs_.data(); }
+    u32 startFunc() const { return start_ind_; }
+    // exported wasi_thread_start, NO_FUNC without one
+    u32 threadStartFunc() const { return thread_start_ind_; }
+    // compiler of the jit and tier-up options, null without them
+    JitCompiler *jit() const { return jit_.get(); }
+
+    static constexpr u32 NO_FUNC = UINT32_MAX;
+private:
+    // Finds the entry points and settles the compilation options for the module, the tier as far
+    // as it does not depend on the function bodies
+    void initOptions();
+    // Compiled code of the jit and aot options, once the functions are translated
+    void initCompiledCode();
+    // Translates pending function f_ind, one function at a time
+    void translate(u32 f_ind);
+
+    module::WasmModule module_;
+    RuntimeOptions options_;
+    FunctionsContainer funcs_;
+    u32 start_ind_ = 0;
+    u32 thread_start_ind_ = NO_FUNC;
+    std::unique_ptr<JitCompiler> jit_;
+    // what pending functions are translated with
+    std::mutex translate_lock_;
+    std::unique_ptr<ModuleTypes> types_;
+    HandlerTable handlers_ = nullptr;
+    std::shared_ptr<void> aot_;   // ahead-of-time compiled library, some jitCode entries point into it
+};
+
+}
+#endif //OWASM_VM_COMPILED_MODULE_HPP
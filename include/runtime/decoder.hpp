@@ -0,0 +1,59 @@
+#ifndef OWASM_VM_DECODER_HPP
+#define OWASM_VM_DECODER_HPP
+#include "runtime_structs.hpp"
+
+namespace omega::wass {
+
+// Opcodes the interpreters have no handler for, but the decoder has to understand
+constexpr u8 CALL_INDIRECT = 0x11;
+constexpr u8 REF_NULL      = 0xD0;
+constexpr u8 REF_IS_NULL   = 0xD1;
+constexpr u8 REF_FUNC      = 0xD2;
+
+struct DecodedInstr {
+    u8 op;
+    u32 sub_op;     // opcode following a 0xFC, 0xFD or 0xFE prefix
+    WasmVal imm;    // first immediate (index, constant, memarg offset, block type, reference or select type)
+    u32 imm2;       // second immediate where present (table index of call_indirect, SIMD lane index,
+                    // alignment of atomic accesses)
+    u64 imm_hi;     // upper 8 bytes of the 16 byte immediates of v128.const and i8x16.shuffle
+};
+
+struct GlobalType {
+    ValType type;
+    bool mut;
+};
+
+// Module-level type information needed to reason about the operand stack of a function body
+struct ModuleTypes {
+    const std::vector<module::FuncSignature> *types;
+    std::vector<u32> func_types;          // type index of every function, imports first
+    std::vector<GlobalType> global_types; // imports first
+    std::vector<ValType> table_types;     // element type of every table, imports first
+    u32 memory_count;
+    u32 data_count;
+};
+
+struct BlockArity {
+    u32 params;
+    u32 results;
+};
+
+struct StackEffect {
+    u32 pops;
+    u32 pushes;
+};
+
+// Decodes the instruction at ptr and moves ptr past its immediates.
+// br_table label operands are left in the stream for the caller to read.
+DecodedInstr decodeInstr(const u8 *&ptr, const u8 *end);
+
+ModuleTypes collectModuleTypes(const module::WasmModule &module);
+
+BlockArity blockArity(i64 block_type, const ModuleTypes &types);
+
+// Operand stack effect of non-control instructions
+StackEffect stackEffect(const DecodedInstr &instr, const ModuleTypes &types);
+
+}
+#endif //OWASM_VM_DECODER_HPP
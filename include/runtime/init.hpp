@@ -2,21 +2,58 @@
 #ifndef OWASM_VM_INIT_HPP
 #define OWASM_VM_INIT_HPP
 #include "runtime_structs.hpp"
+#include "options.hpp"
 #include <gnu/lib-names.h>
+#include <optional>
 
 namespace omega::wass {
 
-LabelMap createLabelMap(const std::vector<u8> &code);
+struct ModuleTypes;
+
+// Translates a function body into pre-decoded stack code, fusing common sequences into
+// superinstructions when fuse is set. frame_size receives the number of value stack slots
+// the function needs: the locals plus the maximum operand stack height and one spill slot.
+// With loop_headers every loop starts with a loop_header instruction its back edges branch to.
+// loop_count receives the number of loops in the body. simd is set for bodies with v128 values,
+// whose locals and select operands need handlers that move the upper halves as well.
+std::vector<Instr> translateCode(std::span<const u8> code,
+                                 const module::FuncSignature &sig,
+                                 const std::vector<ValType> &local_types,
+                                 bool simd,
+                                 const ModuleTypes &types,
+                                 HandlerTable handlers,
+                                 bool fuse,
+                                 bool loop_headers,
+                                 u32 &frame_size,
+                                 u32 &loop_count);
+
+std::optional<u32> findExportedFunc(const module::WasmModule &module, std::string_view name);
 
 u32 findStartFuncInd(module::WasmModule &module);
 
-std::vector<RuntimeFunction> initRuntimeFunctions(module::WasmModule &module);
+// True when a signature, local or instruction of the module has v128 values, or the module
+// uses atomics. Neither has a register tier translation.
+bool needsStackTier(const module::WasmModule &module);
 
-GlobalsContainer initGlobals(module::WasmModule &module);
+// Imported and defined functions of the module. With the lazy option defined functions only get
+// their signatures and are left pending for readWasmFunction.
+std::vector<RuntimeFunction> initRuntimeFunctions(module::WasmModule &module, const RuntimeOptions &options, HandlerTable handlers);
 
-MemsContainer initMemory(module::WasmModule &module);
+// Validates and translates body index of the code section for the tier in options
+RuntimeFunction readWasmFunction(const module::WasmModule &module, u32 index, const ModuleTypes &types,
+                                 const RuntimeOptions &options, HandlerTable handlers);
 
-void initData(module::WasmModule &module, MemsContainer &mems);
+// Just the imported functions, resolved to host functions
+std::vector<RuntimeFunction> initImportFuncs(module::WasmModule &module);
+
+GlobalsContainer initGlobals(const module::WasmModule &module);
+
+MemsContainer initMemory(const module::WasmModule &module);
+
+void initData(const module::WasmModule &module, MemsContainer &mems);
+
+// Data segments as memory.init sees them: active segments are dropped by instantiation
+DataContainer initDataSegments(const module::WasmModule &module);
 
 }
 #endif //OWASM_VM_INIT_HPP
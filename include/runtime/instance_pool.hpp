@@ -0,0 +1,39 @@
+#ifndef OWASM_VM_INSTANCE_POOL_HPP
+#define OWASM_VM_INSTANCE_POOL_HPP
+#include "runtime/interpreter.hpp"
+#include <mutex>
+
+namespace omega::wass {
+
+// Instances of one compiled module for one guest invocation each. A released instance is
+// reset rather than destroyed: its globals are restored, its memory pages discarded and the
+// data segments written again, which keeps the memory reservations and value stack and is far
+// cheaper than instantiating. Acquiring and releasing may happen on any thread, and acquired
+// instances may run at the same time on different threads, one thread per instance: the code
+// cache they share in the compiled module (tier-up, lazy translation, compiled code) is
+// synchronized, see CompiledModule.
+// Instances of a pool with a snapshot start out in its state, and resetting them only discards
+// the pages they have written.
+class InstancePool {
+public:
+    // warm instances are created up front and kept idle at most
+    InstancePool(std::shared_ptr<CompiledModule> compiled, size_t warm,
+                 std::shared_ptr<const Snapshot> snapshot = nullptr);
+
+    // An instance ready to start, instantiated anew when none is idle
+    std::unique_ptr<Interpreter> acquire();
+    // Resets the instance for the next acquire, or drops it when warm instances are idle already
+    void release(std::unique_ptr<Interpreter> instance);
+    size_t idle() const;
+private:
+    std::unique_ptr<Interpreter> instantiate() const;
+
+    std::shared_ptr<CompiledModule> compiled_;
+    std::shared_ptr<const Snapshot> snapshot_;
+    size_t warm_;
+    mutable std::mutex lock_;
+    std::vector<std::unique_ptr<Interpreter>> idle_;
+};
+
+}
+#endif //OWASM_VM_INSTANCE_POOL_HPP
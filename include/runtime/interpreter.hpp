@@ -3,25 +3,100 @@
 #define OWASM_VM_INTERPRETER_HPP
 
 #include "runtime/store.hpp"
+#include "runtime/options.hpp"
+#include "runtime/jit.hpp"
+#include "runtime/aot.hpp"
+#include "runtime/threads.hpp"
 
 namespace omega::wass {
+struct TailCallEngine;
+
 class Interpreter {
+    friend struct TailCallEngine;
 public:
-    void init(module::WasmModule &module);
+    Interpreter() = default;
+    Interpreter(const Interpreter &) = delete;
+    Interpreter &operator=(const Interpreter &) = delete;
+    ~Interpreter();
+
+    // Translates and compiles a parsed module once, for any number of instances
+    static std::shared_ptr<CompiledModule> compile(module::WasmModule module, const RuntimeOptions &options);
+    // Parses and compiles the module file, or reads it from the module cache, see loadCompiledModule
+    static std::shared_ptr<CompiledModule> compile(std::string_view path, const RuntimeOptions &options);
+    // Instantiates the module into a store of its own, ready to start. From a snapshot the
+    // store starts out in its state, see Store::init.
+    void init(std::shared_ptr<CompiledModule> compiled, std::shared_ptr<const Snapshot> snapshot = nullptr);
+    // Runs function f_ind, which takes no arguments, ahead of start, like an initialization
+    // export before a snapshot is taken
+    void initialize(u32 f_ind);
+    // Captures the store, see Store::snapshot
+    std::shared_ptr<const Snapshot> snapshot(const std::string &path, u64 key) const;
+    // Runs the start function, then waits for every spawned thread
     void start();
+    // Makes an instance that has run, or trapped, ready to start again as if just instantiated
+    void reset();
+    // Calls function f_ind with args on a new thread over the same store, a trap there ends the
+    // process. Needs a shared memory 0. Returns the thread id.
+    u32 spawnThread(u32 f_ind, const std::vector<WasmVal> &args);
+    // wasi-threads entry, see wasiThreadSpawn
+    i32 spawnWasiThread(i32 start_arg);
+    // Interpreter executing on the calling thread
+    static Interpreter *running();
 private:
-    void threadedCode();
-    i64 readLEB128();
+    // Shares store, compiled code and threads of parent, with a value stack and frames of its own
+    void initThread(const Interpreter &parent);
+    // Sets up the frame of the start function
+    void enterStart();
+    void runOnThread(u32 f_ind, const std::vector<WasmVal> &args);
+    void run();
+    // Stack tier engines: computed goto dispatch, or tail calls when built with OWASM_TAIL_CALL_DISPATCH
+    void threadedCode(bool export_handlers = false);
+    void tailCallCode(bool export_handlers = false);
+    void stackCode(bool export_handlers = false);
+    void registerCode(bool export_handlers = false);
     void createFrame(u32 f_ind);
+    void createRegisterFrame(u32 f_ind, WasmVal *args);
     void popFrame();
+    void popRegisterFrame(u32 results_reg);
     void callFunc(u32 f_ind);
+    void callRegisterFunc(u32 f_ind, WasmVal *args);
     void callNative(RuntimeFunction &f);
+    WasmVal invokeNative(RuntimeFunction &f, const WasmVal *args);
+    // Entry from compiled code for host functions and functions left to the interpreter
+    static void callFromJit(JitRuntime *rt, u32 f_ind, WasmVal *args);
+    void callForJit(u32 f_ind, WasmVal *args);
+    static i32 memoryGrowFromJit(JitRuntime *rt, u32 delta);
+    static void bulkMemoryFromJit(JitRuntime *rt, u32 op, u32 data_ind, WasmVal *args);
+    [[noreturn]] static void trapFromJit(JitRuntime *rt, const char *message);
+    // Counts a call of an interpreted function, true once it is compiled
+    bool tierUp(u32 f_ind);
+    // Continues the top frame in compiled code at a hot loop header. Returns true when the
+    // function has completed there, with its results at the frame base and the value stack top after them.
+    bool osrEnter(u32 loop);
+
+    Frame &pushFrame(RuntimeFunction *f, WasmVal *base);
+
+    static constexpr size_t VALUE_STACK_SLOTS = 1 << 20;
+    static constexpr size_t MAX_CALL_DEPTH = 1 << 16;
+    // native stack kept free below the limit given to compiled code, for host and interpreter calls
+    static constexpr size_t NATIVE_STACK_RESERVE = 256 << 10;
 
-    std::stack<Frame> frame_stack_;
-    std::stack<Operand> operand_stack_;
+    ValueStack value_stack_{VALUE_STACK_SLOTS};
+    std::vector<Frame> frames_;   // reserved to MAX_CALL_DEPTH, never reallocates
     Frame *top_frame_ = nullptr;
+    HandlerTable handlers_ = nullptr;
+    HandlerTable reg_handlers_ = nullptr;
+    RuntimeOptions options_;
+    u8 *memory_ = nullptr;   // base of memory 0, stays in place for the lifetime of the store
+    LinearMemory *linear_memory_ = nullptr;   // memory 0, for memory.size and memory.grow
+    JitCompiler *jit_ = nullptr;   // of the compiled module, with the jit, tier-up and aot options
+    JitRuntime jit_runtime_{};
+    u32 start_ind_ = 0;
+    size_t entry_depth_ = 1;   // frame count at which the running stack tier loop returns
+    bool worker_ = false;      // spawned thread, the main interpreter joins it
 
-    Store store_;
+    std::shared_ptr<Store> store_ = std::make_shared<Store>();
+    std::shared_ptr<ThreadGroup> threads_ = std::make_shared<ThreadGroup>();
 
 };
 }
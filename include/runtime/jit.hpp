@@ -0,0 +1,77 @@
+#ifndef OWASM_VM_JIT_HPP
+#define OWASM_VM_JIT_HPP
+#include "runtime/compiled_module.hpp"
+#include "runtime/decoder.hpp"
+#include <mutex>
+
+namespace omega::wass {
+
+// State shared between compiled code and the runtime, its address stays in a callee-saved register
+struct JitRuntime {
+    void *owner;
+    void (*call)(JitRuntime *rt, u32 f_ind, WasmVal *args);   // host and interpreted callees
+    const JitFunc *entries;   // compiled entry of every function, null while it runs interpreted
+    const WasmVal *stack_end;
+    const char *native_stack_limit;
+    u8 *memory;   // base of memory 0
+    i32 (*memory_grow)(JitRuntime *rt, u32 delta);   // memory.grow of memory 0, memory.size with 0
+    // 0xFC bulk memory opcode with its data segment, args holds the operands in frame slots
+    void (*bulk_memory)(JitRuntime *rt, u32 op, u32 data_ind, WasmVal *args);
+    // frames of aot code on the native stack, which cannot tell a self call turned into a jump
+    u32 call_depth;
+    // raises message as a trap of the running instance, for conditions aot code checks itself
+    void (*trap)(JitRuntime *rt, const char *message);
+};
+
+// Executable memory holding compiled functions. Code is appended to page-aligned regions, each
+// mapped twice from a memfd: executable for running it and writable for copying new code in, so
+// installing never changes the protection of code other threads may be running.
+class JitCode {
+public:
+    JitCode() = default;
+    JitCode(JitCode &&other) noexcept;
+    JitCode &operator=(JitCode &&other) noexcept;
+    JitCode(const JitCode &) = delete;
+    JitCode &operator=(const JitCode &) = delete;
+    ~JitCode();
+
+    const u8 *install(const std::vector<u8> &code);
+private:
+    struct Region {
+        u8 *base;    // executable view
+        u8 *write;   // writable view of the same pages
+        size_t size;
+        size_t used;
+    };
+
+    static constexpr size_t REGION_SIZE = 64 << 10;
+
+    std::vector<Region> regions_;
+};
+
+// Baseline single pass x86-64 compiler. Only functions whose bodies use supported opcodes
+// are compiled, the others stay on the stack tier.
+// Compiled code keeps locals and operands in the frame slots of the value stack, so frame
+// layout and calling convention match the interpreter, and every loop header gets an entry
+// that continues an interpreted activation in compiled code.
+class JitCompiler {
+public:
+    explicit JitCompiler(CompiledModule &compiled);
+
+    void compileModule();
+    // Sets jitCode and osrEntries of the function, or marks it jitRejected and returns false.
+    // Any thread running the module may call it, compilations take turns.
+    bool compileFunction(u32 f_ind);
+    const JitFunc *entries() const { return entries_.data(); }
+private:
+    const module::WasmModule &module_;
+    CompiledModule &compiled_;
+    ModuleTypes types_;
+    u32 imports_;
+    std::mutex lock_;   // guards code_ and compilation
+    JitCode code_;
+    std::vector<JitFunc> entries_;   // indexed by function, read by compiled calls
+};
+
+}
+#endif //OWASM_VM_JIT_HPP
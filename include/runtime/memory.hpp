@@ -0,0 +1,89 @@
+#ifndef OWASM_VM_MEMORY_HPP
+#define OWASM_VM_MEMORY_HPP
+#include "data/types.hpp"
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <span>
+
+namespace omega::wass {
+
+// Linear memory inside a PROT_NONE reservation large enough for any u32 address plus u32
+// offset, so loads and stores need no bounds checks: an access past the accessible pages
+// faults, and runTrapping turns the fault into a trap. Growing commits pages in place, the
+// base never moves.
+// A shared memory is used by several threads at once: growing is serialized, the size is read
+// atomically, and memory.atomic.wait/notify park threads on addresses of it.
+class LinearMemory {
+public:
+    static constexpr size_t RESERVATION = size_t{8} << 30;
+    static constexpr u32 MAX_PAGES = 65536;   // 4 GiB, the whole u32 address space
+
+    LinearMemory(u32 pages, u32 max_pages, bool shared = false);
+    LinearMemory(LinearMemory &&other) noexcept;
+    LinearMemory &operator=(LinearMemory &&other) noexcept;
+    LinearMemory(const LinearMemory &) = delete;
+    LinearMemory &operator=(const LinearMemory &) = delete;
+    ~LinearMemory();
+
+    u8 *base() const { return base_; }
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+    u32 pages() const;
+    bool shared() const { return shared_ != nullptr; }
+
+    // memory.grow: previous size in pages, or -1 when the maximum is exceeded
+    i32 grow(u32 delta);
+
+    // Back to pages zero pages in the same reservation: touched pages are handed back to the
+    // kernel, pages grown since are made inaccessible again. Data segments have to be rewritten.
+    void reset(u32 pages);
+
+    // Writes data to offset. When fd is open and file_offset is congruent to offset modulo the
+    // system page size, the whole pages in between are mapped copy-on-write from the file
+    // instead, so they share the page cache until written. Only the edges are copied.
+    void writeSegment(u64 offset, const u8 *data, size_t size, int fd, u64 file_offset);
+
+    // Replaces the contents with pages pages mapped copy-on-write from fd at file_offset, a
+    // multiple of the system page size. reset to as many pages goes back to the image.
+    void mapImage(int fd, u64 file_offset, u32 pages);
+
+    // Bulk memory instructions. The whole range is checked first, so a trap leaves memory
+    // untouched, then the host memmove/memset kernels do the work.
+    void copy(u32 dst, u32 src, u32 n);
+    void fill(u32 dst, u8 value, u32 n);
+    void init(u32 dst, std::span<const u8> segment, u32 src, u32 n);
+
+    // memory.atomic.wait32/64 on an aligned address: 0 when woken, 1 when the value is not
+    // expected, 2 on timeout. A negative timeout waits forever. Traps on an unshared memory.
+    u32 wait(u64 address, u64 expected, u32 size, i64 timeout_ns);
+    // memory.atomic.notify: wakes up to count waiters of address in arrival order, returns how many
+    u32 notify(u64 address, u32 count);
+private:
+    struct SharedState;
+
+    void checkRange(u64 address, u64 n) const;
+
+    u8 *base_ = nullptr;
+    std::atomic<size_t> size_ = 0;   // accessible bytes
+    u32 max_pages_ = 0;
+    std::unique_ptr<SharedState> shared_;   // only shared memories have one
+};
+
+// Runs fn, a fault inside a linear memory reservation meanwhile is thrown from here as
+// std::runtime_error("out of bounds memory access"), and so is an error raised by trap. The
+// frames between fn and the faulting access are abandoned without unwinding.
+void runTrapping(const std::function<void()> &fn);
+
+// Raises the out of bounds trap of the innermost runTrapping like a fault would, so it works
+// from helpers called by compiled code too
+[[noreturn]] void trapOutOfBounds();
+
+// Leaves for the innermost runTrapping, which throws error. For errors of helpers called by
+// compiled code, whose frames have no unwind information. Throws error right away outside
+// runTrapping.
+[[noreturn]] void trap(std::exception_ptr error);
+
+}
+#endif //OWASM_VM_MEMORY_HPP
@@ -0,0 +1,21 @@
+#ifndef OWASM_VM_MODULE_CACHE_HPP
+#define OWASM_VM_MODULE_CACHE_HPP
+#include "runtime/compiled_module.hpp"
+#include <string>
+#include <string_view>
+
+namespace omega::wass {
+
+// Modules as CompiledModule translates them, kept on disk so later loads skip parsing, validation
+// and translation. A cache file is named after a hash of the module bytes and of the options the
+// translation depends on. Its contents are position independent: handlers are stored as opcodes
+// and looked up in the dispatch tables of the running process, imports are resolved again.
+// Files of another format version or from another module are translated anew and replaced.
+
+// Compiles the module at path, through the cache in options.cache_dir when set. handlers are the
+// dispatch tables of the stack and register tiers.
+std::shared_ptr<CompiledModule> loadCompiledModule(std::string_view path, const RuntimeOptions &options,
+                                                   HandlerTable stack_handlers, HandlerTable reg_handlers);
+
+}
+#endif //OWASM_VM_MODULE_CACHE_HPP
@@ -0,0 +1,50 @@
+#ifndef OWASM_VM_OPTIONS_HPP
+#define OWASM_VM_OPTIONS_HPP
+#include "data/types.hpp"
+#include <string>
+
+namespace omega::wass {
+
+enum class ExecTier : u8 {
+    Stack,     // pre-decoded Wasm operand stack code
+    Register   // stack slots and locals translated to virtual registers
+};
+
+struct RuntimeOptions {
+    ExecTier tier = ExecTier::Stack;
+    bool fuse = true;   // peephole superinstructions in the stack tier
+    bool jit = false;   // baseline compiled code, unsupported functions run on the stack tier
+
+    // Tier-up: code starts on the stack tier and hot functions get compiled on demand.
+    // An activation that keeps iterating a loop moves into compiled code at the loop header.
+    bool tier_up = false;
+    u32 call_threshold = 1000;    // calls before a function is compiled
+    u32 loop_threshold = 10000;   // loop iterations before a running activation is compiled
+
+    // Threads validating and translating function bodies at load, 0 for one per core.
+    // The result does not depend on it.
+    u32 load_threads = 0;
+    // Functions are validated and translated on their first call instead of at load, so loading
+    // costs about as much as parsing and bodies that never run cost nothing. An invalid body then
+    // fails its first call rather than the load. Lazy modules run on the stack tier, whether the
+    // register tier fits depends on every body. Not with the jit and aot options, which compile
+    // everything at load.
+    bool lazy = false;
+
+    // Shared object with the ahead-of-time compiled module, built on first use and rebuilt
+    // when the module changes. Functions it cannot hold run on the stack tier.
+    std::string aot_path;
+
+    // Directory of the module cache, which keeps translated modules so later loads of the same
+    // module with the same options skip parsing and translation. Off when empty.
+    std::string cache_dir;
+
+    // Snapshot of the instance once initialized, taken on first use and retaken when the module
+    // changes. Later runs map its memories copy-on-write instead of initializing again.
+    std::string snapshot_path;
+    // Export run as part of the initialization, before the start function
+    std::string init_export;
+};
+
+}
+#endif //OWASM_VM_OPTIONS_HPP
@@ -0,0 +1,17 @@
+#ifndef OWASM_VM_REGISTER_IR_HPP
+#define OWASM_VM_REGISTER_IR_HPP
+#include "runtime/decoder.hpp"
+
+namespace omega::wass {
+
+// Translates a function body into register-tier code. Locals occupy registers [0, locals_count),
+// operand stack slot k lives in register locals_count + k. frame_size receives the register file size.
+std::vector<RegInstr> translateRegisterCode(std::span<const u8> code,
+                                            const module::FuncSignature &sig,
+                                            u32 locals_count,
+                                            const ModuleTypes &types,
+                                            HandlerTable handlers,
+                                            u32 &frame_size);
+
+}
+#endif //OWASM_VM_REGISTER_IR_HPP
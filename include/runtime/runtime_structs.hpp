@@ -3,27 +3,89 @@
 
 #include "data/module_struct.hpp"
 #include "bytecode/bytecode.hpp"
+#include "memory.hpp"
+#include <atomic>
 #include <unordered_map>
 #include <stack>
+#include <memory>
+#include <span>
 #include <stdexcept>
 namespace omega::wass {
 constexpr u32 WASM_PAGE_SIZE = 1024 * 64;
 
-struct ControlBlock {
-    runtime::Bytecode type;
-    u32 start;
-    u32 end;
-};
-
 typedef int64_t (*NativeFuncType)(...);
-using LabelMap = std::unordered_map<u32, ControlBlock>;
-using MemsContainer = std::vector<std::vector<char>>;
+using MemsContainer = std::vector<LinearMemory>;
+using DataContainer = std::vector<std::span<const u8>>;   // bytes of the data segments, empty once dropped
 
 union WasmVal {
     i64 i;
     f64 f;
 };
 
+// Branch resolved at load time: target ip and the operand stack adjustment on the way there
+struct BranchTarget {
+    u32 ip;
+    u16 drop;   // values discarded below the kept ones
+    u16 keep;   // branch arity
+};
+
+// Operands of fused superinstructions
+struct LocalPair {
+    u32 lhs;
+    u32 rhs;
+};
+
+struct LocalConst {
+    u32 local;
+    i32 value;
+};
+
+// Operands of SIMD instructions
+struct SimdOp {
+    u32 offset;   // memarg offset
+    u16 kernel;   // sub-opcode
+    u8 lane;
+    u8 size;      // bytes accessed by lane loads and stores
+};
+
+// Operands of atomic instructions
+struct AtomicOp {
+    u32 offset;   // memarg offset
+    u8 size;      // bytes accessed, the effective address has to be a multiple
+    u8 rmw;       // atomics::Rmw of read-modify-write opcodes
+    bool wide;    // i64 operands, otherwise i32
+};
+
+union Immediate {
+    i64 i;
+    f64 f;
+    BranchTarget br;
+    LocalPair locals;
+    LocalConst local_const;
+    SimdOp simd;
+    AtomicOp atomic;
+};
+
+// Fixed-width pre-decoded instruction: handler address of the interpreter plus decoded immediate
+struct Instr {
+    const void *handler;
+    Immediate imm;
+};
+
+// Register-tier instruction: operands are indices into the frame register file
+struct RegInstr {
+    const void *handler;
+    WasmVal imm;
+    u32 dst;
+    u32 lhs;
+    u32 rhs;
+};
+
+using HandlerTable = const void *const *;
+
+struct JitRuntime;
+using JitFunc = void (*)(WasmVal *base, JitRuntime *rt);
+
 struct Operand {
     Operand() = default;
     Operand(ValType t, i64 i) : type(t), val(i) {};
@@ -43,39 +105,86 @@ using GlobalsContainer = std::vector<GlobalVar>;
 struct RuntimeFunction {
     bool isNative = false;
     module::FuncSignature signature;
-    std::vector<u8> code;
-    std::vector<Operand> locals;
-    LabelMap labelMap;
+    std::vector<Instr> code;
+    u32 localsCount = 0;           // parameters first, then declared locals
+
+    std::vector<RegInstr> regCode;
+    u32 frameSize = 0;             // value stack slots: locals plus the maximum operand stack height
+    JitFunc jitCode = nullptr;     // compiled body, called with the frame base
+    std::vector<JitFunc> osrEntries;   // compiled loop headers by loop index, entered with a live frame
+    bool jitRejected = false;      // body uses opcodes the compiler does not support
+    bool simd = false;             // body handles v128 values, which only the stack tier supports
+    bool pending = false;          // not validated and translated yet, see CompiledModule::readyFunc
+
+    // tier-up counters of the stack tier
+    u32 hotness = 0;               // calls
+    std::vector<u32> loopHotness;  // iterations of every loop, by loop index
 
     NativeFuncType native_ptr;
 };
 
 using FunctionsContainer = std::vector<RuntimeFunction>;
 
-struct Frame {
-
-    void pushLabel() {
-        control_stack.push_back(labels->find(ip)->second);
-    }
+// Compiled entries, rejection flags and tier-up counters of a function belong to the compiled
+// module and are shared by every thread running it. They are read with loadShared and written
+// with publish, so a thread that sees a compiled entry sees the code and loop entries too.
+template<typename T>
+T loadShared(T &field) {
+    return std::atomic_ref<T>(field).load(std::memory_order_acquire);
+}
 
-    void popBlocks(i64 n) {
-        for (i64 i = 0; i < n; ++i) {
-            control_stack.pop_back();
-        }
-    }
+template<typename T>
+void publish(T &field, T value) {
+    std::atomic_ref<T>(field).store(value, std::memory_order_release);
+}
 
-    void ret() {
-        control_stack.clear();
-        ip = code.size() - 1;
-    }
+// Returns the incremented counter. A lost update between threads only delays tier-up a little,
+// so counting takes no atomic read-modify-write.
+inline u32 countHot(u32 &counter) {
+    std::atomic_ref<u32> shared(counter);
+    u32 count = shared.load(std::memory_order_relaxed) + 1;
+    shared.store(count, std::memory_order_relaxed);
+    return count;
+}
 
+struct Frame {
     RuntimeFunction *func;
-    std::vector<u8> code;
-    LabelMap *labels;
-    std::vector<Operand> locals;
-    std::deque<ControlBlock> control_stack;
+    const Instr *code;
+    const RegInstr *reg_code;
+    WasmVal *locals;   // frame base on the value stack: parameters, locals, then operands
     u32 ip = 0;
 };
 
+// Contiguous value stack holding the locals and operands of every activation.
+// Slots are untagged: function bodies are validated at load time, so handlers know the types statically.
+// Frames reserve their maximum size on entry, so pushes need no bounds checks.
+// A v128 value keeps its upper half in the shadow slot at upperOffset() from its slot, so scalar
+// code keeps 8 byte slots. The shadow half is only touched by functions with v128 values.
+class ValueStack {
+public:
+    explicit ValueStack(size_t size) : slots_(new WasmVal[size * 2]), end_(slots_.get() + size), sp_(slots_.get()) {}
+
+    WasmVal &top() { return sp_[-1]; }
+    void pop() { --sp_; }
+    void push(WasmVal val) { *sp_++ = val; }
+
+    WasmVal *sp() const { return sp_; }
+    const WasmVal *end() const { return end_; }
+    void setSp(WasmVal *sp) { sp_ = sp; }
+    void clear() { sp_ = slots_.get(); }
+    size_t size() const { return sp_ - slots_.get(); }
+    ptrdiff_t upperOffset() const { return end_ - slots_.get(); }
+
+    void ensure(const WasmVal *base, u32 slots) const {
+        if (base + slots > end_) {
+            throw std::runtime_error("value stack exhausted");
+        }
+    }
+private:
+    std::unique_ptr<WasmVal[]> slots_;
+    WasmVal *end_;
+    WasmVal *sp_;
+};
+
 }
 #endif //OWASM_VM_RUNTIME_STRUCTS_HPP
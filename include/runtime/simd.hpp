@@ -0,0 +1,71 @@
+#ifndef OWASM_VM_SIMD_HPP
+#define OWASM_VM_SIMD_HPP
+#include "runtime_structs.hpp"
+#include <immintrin.h>
+
+namespace omega::wass::simd {
+
+using V128 = __m128i;
+
+// Operand shape of a 0xFD opcode, it decides immediates, stack effect and the interpreter handler
+enum class Shape : u8 {
+    None,          // reserved or unsupported sub-opcode
+    Load,          // i32 -> v128, size bytes widened by the kernel unless size is 16
+    Store,         // i32 v128 ->
+    LoadLane,      // i32 v128 -> v128
+    StoreLane,     // i32 v128 ->
+    Const,         // -> v128, 16 byte immediate
+    Shuffle,       // v128 v128 -> v128, 16 byte immediate
+    Unary,         // v128 -> v128
+    Binary,        // v128 v128 -> v128
+    Ternary,       // v128 v128 v128 -> v128
+    Test,          // v128 -> i32
+    Shift,         // v128 i32 -> v128
+    Splat,         // scalar -> v128
+    ExtractLane,   // v128 -> scalar
+    ReplaceLane,   // v128 scalar -> v128
+};
+
+struct OpInfo {
+    Shape shape;
+    ValType scalar;   // of splat and lane opcodes
+    u8 lanes;         // lane count of lane opcodes
+    u8 size;          // bytes accessed by memory opcodes
+};
+
+const OpInfo &opInfo(u32 sub_op);
+
+// i8x16.shuffle, its ternary kernel takes the lane indices as the third operand
+constexpr u32 SHUFFLE = 13;
+
+// Lane-wise kernels by sub-opcode. Scalars are passed as value stack slots, f32 widened to f64.
+using Unary = V128 (*)(V128);
+using Binary = V128 (*)(V128, V128);
+using Ternary = V128 (*)(V128, V128, V128);
+using Test = i32 (*)(V128);
+using Shift = V128 (*)(V128, u32);
+using Splat = V128 (*)(WasmVal);
+using ExtractLane = WasmVal (*)(V128, u32);
+using ReplaceLane = V128 (*)(V128, WasmVal, u32);
+
+union Kernel {
+    Unary unary;
+    Binary binary;
+    Ternary ternary;
+    Test test;
+    Shift shift;
+    Splat splat;
+    ExtractLane extract;
+    ReplaceLane replace;
+};
+
+// Kernels for the host CPU: SSE2 is the x86-64 baseline, SSE4.2 ones are picked when cpuid reports it
+const Kernel *kernels();
+
+// v128 values are split over two value stack slots of 8 bytes
+inline V128 join(i64 low, i64 high) { return _mm_set_epi64x(high, low); }
+inline i64 low(V128 v) { return _mm_cvtsi128_si64(v); }
+inline i64 high(V128 v) { return _mm_cvtsi128_si64(_mm_unpackhi_epi64(v, v)); }
+
+}
+#endif //OWASM_VM_SIMD_HPP
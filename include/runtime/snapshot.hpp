@@ -0,0 +1,52 @@
+#ifndef OWASM_VM_SNAPSHOT_HPP
+#define OWASM_VM_SNAPSHOT_HPP
+#include "runtime_structs.hpp"
+#include <string>
+#include <vector>
+
+namespace omega::wass {
+
+// State of an instance after initialization: global values, dropped data segments and the
+// contents of every memory. The memory images live in a file, or in an anonymous memfd, and
+// instances made from the snapshot map them copy-on-write, so they start without running the
+// initialization again and share every page neither of them has written.
+// The module has no tables yet, so there is no table state to keep.
+class Snapshot {
+public:
+    struct Memory {
+        u64 offset;   // of the image in the file, a multiple of WASM_PAGE_SIZE
+        u32 pages;
+    };
+
+    // Writes the state to path, through a temporary file renamed into place, or to a memfd when
+    // path is empty. key identifies what the state was made from, see snapshotKey.
+    Snapshot(const std::string &path, u64 key, const GlobalsContainer &globals, const DataContainer &data,
+             const MemsContainer &mems);
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+    ~Snapshot();
+
+    // The snapshot written to path for key, null when the file is missing, unreadable or made
+    // for something else
+    static std::shared_ptr<const Snapshot> open(const std::string &path, u64 key);
+
+    int fd() const { return fd_; }
+    const std::vector<WasmVal> &globals() const { return globals_; }
+    u32 dataCount() const { return dropped_.size(); }
+    bool dropped(u32 data_ind) const { return dropped_[data_ind]; }
+    const std::vector<Memory> &memories() const { return memories_; }
+private:
+    Snapshot() = default;
+
+    int fd_ = -1;
+    std::vector<WasmVal> globals_;
+    std::vector<bool> dropped_;
+    std::vector<Memory> memories_;
+};
+
+// Identifies the contents of the module file together with the export that initializes it.
+// Host state the initialization read, like the environment or the clock, is not part of it.
+u64 snapshotKey(const module::WasmModule &module, std::string_view init_export);
+
+}
+#endif //OWASM_VM_SNAPSHOT_HPP
@@ -2,17 +2,41 @@
 #ifndef OWASM_VM_STORE_HPP
 #define OWASM_VM_STORE_HPP
 #include "runtime_structs.hpp"
+#include "compiled_module.hpp"
+#include "snapshot.hpp"
 
 namespace omega::wass {
+// State of one instance of a compiled module: memories, globals and data segments.
+// Functions belong to the shared CompiledModule.
 class Store {
 public:
-    void init(module::WasmModule &module);
-    RuntimeFunction& getFunc(u32 f_ind);
+    // With a snapshot of the module, memories are mapped from its images and globals and dropped
+    // data segments are taken from it, instead of running the initialization
+    void init(std::shared_ptr<CompiledModule> compiled, std::shared_ptr<const Snapshot> snapshot = nullptr);
+    // Returns to the state right after init without giving up the memory reservations
+    void reset();
+    // Captures the current state to path, or to a memfd when path is empty
+    std::shared_ptr<const Snapshot> snapshot(const std::string &path, u64 key) const;
+    CompiledModule &compiled() { return *compiled_; }
+    RuntimeFunction& getFunc(u32 f_ind) { return compiled_->getFunc(f_ind); }
+    RuntimeFunction& readyFunc(u32 f_ind) { return compiled_->readyFunc(f_ind); }
+    u32 funcCount() const { return compiled_->funcCount(); }
+    u32 funcIndex(const RuntimeFunction &f) const { return compiled_->funcIndex(f); }
     char* getMem(u32 mem_ind, u32 ind);
+    u8 *memoryBase(u32 mem_ind) { return mem_ind < mems_.size() ? mems_[mem_ind].base() : nullptr; }
+    LinearMemory *memory(u32 mem_ind) { return mem_ind < mems_.size() ? &mems_[mem_ind] : nullptr; }
+    // segment bytes point into the module, which the compiled module keeps alive
+    std::span<const u8> dataSegment(u32 data_ind) const { return data_[data_ind]; }
+    void dropData(u32 data_ind) { data_[data_ind] = {}; }
 private:
+    // Globals and data segments as instantiated, or as in the snapshot
+    void initValues();
+
+    std::shared_ptr<CompiledModule> compiled_;
+    std::shared_ptr<const Snapshot> snapshot_;
     GlobalsContainer globals_;
     MemsContainer mems_;
-    FunctionsContainer funcs_;
+    DataContainer data_;
 };
 }
 
@@ -0,0 +1,28 @@
+#ifndef OWASM_VM_THREADS_HPP
+#define OWASM_VM_THREADS_HPP
+#include "data/types.hpp"
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace omega::wass {
+
+// Interpreter threads of one module instance. Ids start at 1, the main thread has none.
+class ThreadGroup {
+public:
+    u32 newId();
+    void add(std::thread thread);
+    // Returns once every thread has finished, including threads spawned meanwhile
+    void joinAll();
+private:
+    std::mutex lock_;
+    std::vector<std::thread> threads_;
+    u32 next_id_ = 1;
+};
+
+// wasi-threads thread-spawn import: runs the exported wasi_thread_start(tid, start_arg) on a new
+// thread of the calling interpreter and returns tid
+i64 wasiThreadSpawn(i64 start_arg);
+
+}
+#endif //OWASM_VM_THREADS_HPP
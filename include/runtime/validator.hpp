@@ -0,0 +1,16 @@
+#ifndef OWASM_VM_VALIDATOR_HPP
+#define OWASM_VM_VALIDATOR_HPP
+#include "runtime/decoder.hpp"
+
+namespace omega::wass {
+
+// Type checks a function body against its signature and local types.
+// Throws std::runtime_error on the first mismatch, so the interpreter can keep values untagged.
+// Returns whether the body handles v128 values.
+bool validateFunction(std::span<const u8> code,
+                      const module::FuncSignature &sig,
+                      const std::vector<ValType> &locals,
+                      const ModuleTypes &types);
+
+}
+#endif //OWASM_VM_VALIDATOR_HPP
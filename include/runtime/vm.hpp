@@ -7,10 +7,26 @@
 namespace omega::wass {
     class Vm {
     public:
+        explicit Vm(RuntimeOptions options = {}) : options_(options) {}
         void loadModule(std::string_view path);
+        // Another instance of the loaded module, sharing its code but no state with the others
+        std::unique_ptr<Interpreter> instantiate() const;
+        // For an InstancePool or further instances elsewhere
+        std::shared_ptr<CompiledModule> compiledModule() const { return compiled_; }
+        // Initializes a fresh instance, running init_export too unless empty, and captures it
+        // to path, or to a memfd when path is empty. Instances made from the snapshot start out
+        // initialized.
+        std::shared_ptr<const Snapshot> snapshot(std::string_view init_export, const std::string &path = {}) const;
+        std::unique_ptr<Interpreter> instantiate(std::shared_ptr<const Snapshot> snapshot) const;
         void start();
+        // Calls the exported function on a new thread, start() waits for it
+        u32 spawnThread(std::string_view export_name, const std::vector<WasmVal> &args);
     private:
-        module::WasmModule module_;
+        u32 exportedFunc(std::string_view name) const;
+
+        RuntimeOptions options_;
+        std::shared_ptr<CompiledModule> compiled_;
+        std::shared_ptr<const Snapshot> snapshot_;   // of the snapshot_path option
         Interpreter interpreter_;
     };
 }
@@ -1,23 +1,48 @@
 #ifndef OWASM_VM_BUF_READER_HPP
 #define OWASM_VM_BUF_READER_HPP
 
-#include <fstream>
 #include <cstring>
-#include <vector>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include "util/util.hpp"
 
 namespace omega::wass::util {
 constexpr size_t MODULE_OFFSET = 8; // 4 bytes magic + 4 bytes version
 
+// Whole file mapped read-only. Parsed modules point into it instead of copying, so it lives
+// as long as the module that holds it.
+class MappedFile {
+public:
+    // Throws when the file cannot be opened or mapped
+    explicit MappedFile(const std::string &path);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    std::span<const u8> bytes() const { return {data_, size_}; }
+private:
+    const u8 *data_ = nullptr;
+    size_t size_ = 0;
+};
+
 class BufReader {
 public:
-    explicit BufReader(std::ifstream stream);
+    explicit BufReader(const std::string &path);
 
     [[nodiscard]]
-    u8* get() const noexcept { return buf_ptr_ + offset_; }
+    const u8* get() const noexcept { return buf_ptr_ + offset_; }
+    [[nodiscard]]
+    size_t offset() const noexcept { return offset_; }   // position in the file
+    // the mapping that spans returned by readSpan point into
+    [[nodiscard]]
+    std::shared_ptr<const MappedFile> file() const noexcept { return file_; }
 
+    // Reads below throw "unexpected end of module" when the file ends before the value
     template<typename T>
     T read() {
+        checkAvailable(sizeof(T));
         T t;
         std::memcpy(&t, get(), sizeof(T));
         offset_ += sizeof(T);
@@ -27,6 +52,8 @@ public:
     i64 readLeb128();
     u64 readULeb128();
     std::string readStr();
+    // The next size bytes in place, throws when the file ends before
+    std::span<const u8> readSpan(u64 size);
 
     template<typename T>
     void next() {
@@ -37,11 +64,19 @@ public:
         offset_ += off;
     }
     bool isEnd() {
-        return offset_ >= buff_.size();
+        return offset_ >= size_;
     }
 private:
-    std::vector<u8> buff_;
-    uint8_t *buf_ptr_;
+    // the mapping ends exactly at the end of the file, nothing may be read past it
+    void checkAvailable(u64 size) const {
+        if (offset_ > size_ || size > size_ - offset_) {
+            throw std::runtime_error("unexpected end of module");
+        }
+    }
+
+    std::shared_ptr<const MappedFile> file_;
+    const u8 *buf_ptr_;
+    size_t size_;
     size_t offset_ = MODULE_OFFSET;
 };
 
@@ -24,6 +24,7 @@ private:
     Section parseOneSectionEntry();
     std::vector<module::CustomSection> parseCustomSection();
 private:
+    std::string path_;
     util::BufReader bufReader_;
 };
 
@@ -0,0 +1,46 @@
+#ifndef OWASM_VM_PARALLEL_HPP
+#define OWASM_VM_PARALLEL_HPP
+#include "data/types.hpp"
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace omega::wass::util {
+
+// Calls fn(i) for every i below count, spread over up to threads threads including the calling
+// one, one per core when threads is 0. Each thread takes min_per_thread items at least, so
+// small inputs stay on the calling thread. Items are claimed one by one in index order, fn must
+// not throw and must not depend on the order.
+template<typename Fn>
+void parallelFor(size_t count, u32 threads, size_t min_per_thread, Fn fn) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t useful = std::max<size_t>(1, count / std::max<size_t>(1, min_per_thread));
+    threads = static_cast<u32>(std::min<size_t>(threads, useful));
+
+    std::atomic<size_t> next = 0;
+    auto work = [&] {
+        for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+             i = next.fetch_add(1, std::memory_order_relaxed)) {
+            fn(i);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (u32 t = 1; t < threads; ++t) {
+        try {
+            workers.emplace_back(work);
+        } catch (const std::system_error &) {
+            break;   // the threads running already take over the rest
+        }
+    }
+    work();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+}
+#endif //OWASM_VM_PARALLEL_HPP
@@ -7,6 +7,7 @@
 
 #include <cstdint>
 #include <stdexcept>
+#include <string>
 #include "data/types.hpp"
 
 namespace omega::wass::util {
@@ -14,7 +15,15 @@ static constexpr u32 MAX_LEB128_BYTES = (64 + 6) / 7;  // = 10
 
 i64 readULEB128(const u8* ptr);
 i64 readLEB128(const u8* ptr);
+u64 readULEB128(const u8 *&ptr, const u8 *end);
+i64 readLEB128(const u8 *&ptr, const u8 *end);
 std::pair<std::string, std::string> parse_call(const std::string &input);
 void trim(std::string &s);
+
+// FNV-1a over 8 byte words, for cache keys rather than security
+constexpr u64 HASH_SEED = 0xcbf29ce484222325ULL;
+u64 hashBytes(const void *bytes, size_t size, u64 seed = HASH_SEED);
+// Hash of the contents of the file at path, throws when it cannot be read
+u64 hashFile(const std::string &path, u64 seed = HASH_SEED);
 }
 #endif //OWASM_VM_UTIL_HPP
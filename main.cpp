@@ -1,19 +1,77 @@
 #include <getopt.h>
 #include <filesystem>
 #include <iostream>
+#include <cstdlib>
 #include "runtime/vm.hpp"
 
 
 int main(int argc, char **argv) {
     std::string_view path;
+    omega::wass::RuntimeOptions options;
     int64_t opt = 0;
     while (opt != -1) {
-        opt = getopt(argc, argv, "m:");
+        opt = getopt(argc, argv, "m:t:Fjuc:l:a:s:i:C:p:z");
         switch (opt) {
             case 'm': {
                 path = optarg;
                 break;
             }
+            case 't': {
+                std::string_view tier = optarg;
+                if (tier == "stack") {
+                    options.tier = omega::wass::ExecTier::Stack;
+                } else if (tier == "register") {
+                    options.tier = omega::wass::ExecTier::Register;
+                } else {
+                    std::cerr << "Unknown execution tier: " << tier;
+                    return -1;
+                }
+                break;
+            }
+            case 'F': {
+                options.fuse = false;
+                break;
+            }
+            case 'j': {
+                options.jit = true;
+                break;
+            }
+            case 'u': {
+                options.tier_up = true;
+                break;
+            }
+            case 'c': {
+                options.call_threshold = std::strtoul(optarg, nullptr, 10);
+                break;
+            }
+            case 'l': {
+                options.loop_threshold = std::strtoul(optarg, nullptr, 10);
+                break;
+            }
+            case 'a': {
+                options.aot_path = optarg;
+                break;
+            }
+            case 's': {
+                options.snapshot_path = optarg;
+                break;
+            }
+            case 'i': {
+                options.init_export = optarg;
+                break;
+            }
+            case 'C': {
+                options.cache_dir = optarg;
+                break;
+            }
+            case 'p': {
+                options.load_threads = std::strtoul(optarg, nullptr, 10);
+                break;
+            }
+            case 'z': {
+                options.lazy = true;
+                break;
+            }
         }
     }
     if (!std::filesystem::exists(path)){
@@ -21,7 +79,7 @@ int main(int argc, char **argv) {
         return -1;
     }
 
-    omega::wass::Vm vm;
+    omega::wass::Vm vm(options);
     vm.loadModule(path);
     vm.start();
     return 0;
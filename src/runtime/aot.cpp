@@ -0,0 +1,755 @@
+#include "runtime/aot.hpp"
+#include "runtime/decoder.hpp"
+#include "util/util.hpp"
+#include <dlfcn.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace omega::wass {
+using namespace runtime;
+
+namespace {
+
+// Changes whenever the generated code or its interface changes, older libraries get rebuilt
+constexpr u64 AOT_FORMAT_VERSION = 6;
+
+// Same bound as the interpreter puts on its frames
+constexpr u32 AOT_MAX_CALL_DEPTH = 1 << 16;
+
+// Layouts match WasmVal and JitRuntime
+constexpr const char *C_PRELUDE = R"(#include <stdint.h>
+
+typedef union { int64_t i; double f; } WasmVal;
+typedef struct JitRuntime JitRuntime;
+struct JitRuntime {
+    void *owner;
+    void (*call)(JitRuntime *rt, uint32_t f_ind, WasmVal *args);
+    const void *entries;
+    const WasmVal *stack_end;
+    const char *native_stack_limit;
+    uint8_t *memory;
+    int32_t (*memory_grow)(JitRuntime *rt, uint32_t delta);
+    void (*bulk_memory)(JitRuntime *rt, uint32_t op, uint32_t data_ind, WasmVal *args);
+    uint32_t call_depth;
+    void (*trap)(JitRuntime *rt, const char *message);
+};
+
+__attribute__((noreturn)) static void owasm_trap(JitRuntime *rt, const char *message) {
+    rt->trap(rt, message);
+    __builtin_unreachable();
+}
+
+// A callee without parameters or operands below the call shares the frame base of its caller,
+// and a call in tail position may become a jump, so only the depth count bounds recursion there.
+// LEAVE after the call keeps it from being a tail call.
+#define ENTER(fp, frame_size)                                               \
+    if ((fp) + (frame_size) > rt->stack_end ||                              \
+        (const char *)__builtin_frame_address(0) < rt->native_stack_limit || \
+        rt->call_depth++ == OWASM_MAX_CALL_DEPTH)                           \
+        owasm_trap(rt, "call stack exhausted")
+#define LEAVE() --rt->call_depth
+
+static inline int64_t i32_div_s(JitRuntime *rt, int64_t a, int64_t b) {
+    int32_t x = a, y = b;
+    if (!y) owasm_trap(rt, "integer divide by zero");
+    if (x == INT32_MIN && y == -1) owasm_trap(rt, "integer overflow");
+    return x / y;
+}
+static inline int64_t i32_div_u(JitRuntime *rt, int64_t a, int64_t b) {
+    uint32_t x = a, y = b;
+    if (!y) owasm_trap(rt, "integer divide by zero");
+    return (int32_t)(x / y);
+}
+static inline int64_t i32_rem_s(JitRuntime *rt, int64_t a, int64_t b) {
+    int32_t x = a, y = b;
+    if (!y) owasm_trap(rt, "integer divide by zero");
+    return y == -1 ? 0 : x % y;
+}
+static inline int64_t i32_rem_u(JitRuntime *rt, int64_t a, int64_t b) {
+    uint32_t x = a, y = b;
+    if (!y) owasm_trap(rt, "integer divide by zero");
+    return (int32_t)(x % y);
+}
+static inline int64_t i64_div_s(JitRuntime *rt, int64_t x, int64_t y) {
+    if (!y) owasm_trap(rt, "integer divide by zero");
+    if (x == INT64_MIN && y == -1) owasm_trap(rt, "integer overflow");
+    return x / y;
+}
+static inline int64_t i64_div_u(JitRuntime *rt, int64_t x, int64_t y) {
+    if (!y) owasm_trap(rt, "integer divide by zero");
+    return (int64_t)((uint64_t)x / (uint64_t)y);
+}
+static inline int64_t i64_rem_s(JitRuntime *rt, int64_t x, int64_t y) {
+    if (!y) owasm_trap(rt, "integer divide by zero");
+    return y == -1 ? 0 : x % y;
+}
+static inline int64_t i64_rem_u(JitRuntime *rt, int64_t x, int64_t y) {
+    if (!y) owasm_trap(rt, "integer divide by zero");
+    return (int64_t)((uint64_t)x % (uint64_t)y);
+}
+static inline int64_t i32_rotl(int64_t a, int64_t b) {
+    uint32_t x = a, k = b & 31;
+    return (int32_t)((x << k) | (x >> ((32 - k) & 31)));
+}
+static inline int64_t i32_rotr(int64_t a, int64_t b) {
+    uint32_t x = a, k = b & 31;
+    return (int32_t)((x >> k) | (x << ((32 - k) & 31)));
+}
+static inline int64_t i64_rotl(int64_t a, int64_t b) {
+    uint64_t x = a, k = b & 63;
+    return (int64_t)((x << k) | (x >> ((64 - k) & 63)));
+}
+static inline int64_t i64_rotr(int64_t a, int64_t b) {
+    uint64_t x = a, k = b & 63;
+    return (int64_t)((x >> k) | (x << ((64 - k) & 63)));
+}
+static inline int64_t load_i32(const uint8_t *p) { int32_t v; __builtin_memcpy(&v, p, 4); return v; }
+static inline int64_t load_u32(const uint8_t *p) { uint32_t v; __builtin_memcpy(&v, p, 4); return v; }
+static inline int64_t load_i64(const uint8_t *p) { int64_t v; __builtin_memcpy(&v, p, 8); return v; }
+static inline int64_t load_i16(const uint8_t *p) { int16_t v; __builtin_memcpy(&v, p, 2); return v; }
+static inline int64_t load_u16(const uint8_t *p) { uint16_t v; __builtin_memcpy(&v, p, 2); return v; }
+static inline int64_t load_i8(const uint8_t *p) { return (int8_t)*p; }
+static inline int64_t load_u8(const uint8_t *p) { return *p; }
+static inline void store_64(uint8_t *p, int64_t v) { __builtin_memcpy(p, &v, 8); }
+static inline void store_32(uint8_t *p, int64_t v) { uint32_t x = v; __builtin_memcpy(p, &x, 4); }
+static inline void store_16(uint8_t *p, int64_t v) { uint16_t x = v; __builtin_memcpy(p, &x, 2); }
+static inline void store_8(uint8_t *p, int64_t v) { *p = (uint8_t)v; }
+
+static inline int64_t i32_clz(int64_t a) { return (uint32_t)a ? __builtin_clz((uint32_t)a) : 32; }
+static inline int64_t i32_ctz(int64_t a) { return (uint32_t)a ? __builtin_ctz((uint32_t)a) : 32; }
+static inline int64_t i32_popcnt(int64_t a) { return __builtin_popcount((uint32_t)a); }
+static inline int64_t i64_clz(int64_t a) { return a ? __builtin_clzll((uint64_t)a) : 64; }
+static inline int64_t i64_ctz(int64_t a) { return a ? __builtin_ctzll((uint64_t)a) : 64; }
+static inline int64_t i64_popcnt(int64_t a) { return __builtin_popcountll((uint64_t)a); }
+
+)";
+
+// C expression of a binary integer opcode over operands a and b, empty when unsupported
+std::string binaryExpr(u8 op, const std::string &a, const std::string &b) {
+    auto cmp = [&](const char *type, const char *rel) {
+        return std::string("(") + type + ")" + a + " " + rel + " (" + type + ")" + b;
+    };
+    auto wrap32 = [&](const char *rel) {
+        return "(int32_t)((uint32_t)" + a + " " + rel + " (uint32_t)" + b + ")";
+    };
+    auto wrap64 = [&](const char *rel) {
+        return "(int64_t)((uint64_t)" + a + " " + rel + " (uint64_t)" + b + ")";
+    };
+    auto helper = [&](const char *name) {
+        return std::string(name) + "(" + a + ", " + b + ")";
+    };
+    // division helpers trap through the runtime
+    auto trapping = [&](const char *name) {
+        return std::string(name) + "(rt, " + a + ", " + b + ")";
+    };
+    switch (op) {
+        case Bytecode::i32_eq:   return cmp("int32_t", "==");
+        case Bytecode::i32_ne:   return cmp("int32_t", "!=");
+        case Bytecode::i32_lt_s: return cmp("int32_t", "<");
+        case Bytecode::i32_lt_u: return cmp("uint32_t", "<");
+        case Bytecode::i32_gt_s: return cmp("int32_t", ">");
+        case Bytecode::i32_gt_u: return cmp("uint32_t", ">");
+        case Bytecode::i32_le_s: return cmp("int32_t", "<=");
+        case Bytecode::i32_le_u: return cmp("uint32_t", "<=");
+        case Bytecode::i32_ge_s: return cmp("int32_t", ">=");
+        case Bytecode::i32_ge_u: return cmp("uint32_t", ">=");
+        case Bytecode::i64_eq:   return cmp("int64_t", "==");
+        case Bytecode::i64_ne:   return cmp("int64_t", "!=");
+        case Bytecode::i64_lt_s: return cmp("int64_t", "<");
+        case Bytecode::i64_lt_u: return cmp("uint64_t", "<");
+        case Bytecode::i64_gt_s: return cmp("int64_t", ">");
+        case Bytecode::i64_gt_u: return cmp("uint64_t", ">");
+        case Bytecode::i64_le_s: return cmp("int64_t", "<=");
+        case Bytecode::i64_le_u: return cmp("uint64_t", "<=");
+        case Bytecode::i64_ge_s: return cmp("int64_t", ">=");
+        case Bytecode::i64_ge_u: return cmp("uint64_t", ">=");
+        case Bytecode::i32_add:   return wrap32("+");
+        case Bytecode::i32_sub:   return wrap32("-");
+        case Bytecode::i32_mul:   return wrap32("*");
+        case Bytecode::i32_and:   return wrap32("&");
+        case Bytecode::i32_or:    return wrap32("|");
+        case Bytecode::i32_xor:   return wrap32("^");
+        case Bytecode::i32_div_s: return trapping("i32_div_s");
+        case Bytecode::i32_div_u: return trapping("i32_div_u");
+        case Bytecode::i32_rem_s: return trapping("i32_rem_s");
+        case Bytecode::i32_rem_u: return trapping("i32_rem_u");
+        case Bytecode::i32_shl:   return "(int32_t)((uint32_t)" + a + " << (" + b + " & 31))";
+        case Bytecode::i32_shr_s: return "(int32_t)" + a + " >> (" + b + " & 31)";
+        case Bytecode::i32_shr_u: return "(int32_t)((uint32_t)" + a + " >> (" + b + " & 31))";
+        case Bytecode::i32_rotl:  return helper("i32_rotl");
+        case Bytecode::i32_rotr:  return helper("i32_rotr");
+        case Bytecode::i64_add:   return wrap64("+");
+        case Bytecode::i64_sub:   return wrap64("-");
+        case Bytecode::i64_mul:   return wrap64("*");
+        case Bytecode::i64_and:   return wrap64("&");
+        case Bytecode::i64_or:    return wrap64("|");
+        case Bytecode::i64_xor:   return wrap64("^");
+        case Bytecode::i64_div_s: return trapping("i64_div_s");
+        case Bytecode::i64_div_u: return trapping("i64_div_u");
+        case Bytecode::i64_rem_s: return trapping("i64_rem_s");
+        case Bytecode::i64_rem_u: return trapping("i64_rem_u");
+        case Bytecode::i64_shl:   return "(int64_t)((uint64_t)" + a + " << (" + b + " & 63))";
+        case Bytecode::i64_shr_s: return a + " >> (" + b + " & 63)";
+        case Bytecode::i64_shr_u: return "(int64_t)((uint64_t)" + a + " >> (" + b + " & 63))";
+        case Bytecode::i64_rotl:  return helper("i64_rotl");
+        case Bytecode::i64_rotr:  return helper("i64_rotr");
+        default:
+            return {};
+    }
+}
+
+// Accessor of an integer load or store opcode, empty for float accesses
+const char *memoryAccessor(u8 op) {
+    switch (op) {
+        case Bytecode::i32_load:     return "load_i32";
+        case Bytecode::i64_load:     return "load_i64";
+        case Bytecode::i32_load8_s:  return "load_i8";
+        case Bytecode::i32_load8_u:  return "load_u8";
+        case Bytecode::i32_load16_s: return "load_i16";
+        case Bytecode::i32_load16_u: return "load_u16";
+        case Bytecode::i64_load8_s:  return "load_i8";
+        case Bytecode::i64_load8_u:  return "load_u8";
+        case Bytecode::i64_load16_s: return "load_i16";
+        case Bytecode::i64_load16_u: return "load_u16";
+        case Bytecode::i64_load32_s: return "load_i32";
+        case Bytecode::i64_load32_u: return "load_u32";
+        case Bytecode::i32_store:    return "store_32";
+        case Bytecode::i64_store:    return "store_64";
+        case Bytecode::i32_store8:   return "store_8";
+        case Bytecode::i32_store16:  return "store_16";
+        case Bytecode::i64_store8:   return "store_8";
+        case Bytecode::i64_store16:  return "store_16";
+        case Bytecode::i64_store32:  return "store_32";
+        default:
+            return nullptr;
+    }
+}
+
+// C expression of a unary integer opcode, empty when unsupported
+std::string unaryExpr(u8 op, const std::string &a) {
+    switch (op) {
+        case Bytecode::i32_eqz:    return "(int32_t)" + a + " == 0";
+        case Bytecode::i64_eqz:    return a + " == 0";
+        case Bytecode::i32_clz:    return "i32_clz(" + a + ")";
+        case Bytecode::i32_ctz:    return "i32_ctz(" + a + ")";
+        case Bytecode::i32_popcnt: return "i32_popcnt(" + a + ")";
+        case Bytecode::i64_clz:    return "i64_clz(" + a + ")";
+        case Bytecode::i64_ctz:    return "i64_ctz(" + a + ")";
+        case Bytecode::i64_popcnt: return "i64_popcnt(" + a + ")";
+        case Bytecode::i32_wrap_i64:
+        case 0xC4:  // i64.extend32_s
+            return "(int32_t)" + a;
+        case Bytecode::i64_extend_s_i32:
+            // i32 values are kept sign-extended already
+            return a;
+        case Bytecode::i64_extend_u_i32:
+            return "(uint32_t)" + a;
+        case 0xC0:  // i32.extend8_s
+        case 0xC2:  // i64.extend8_s
+            return "(int8_t)" + a;
+        case 0xC1:  // i32.extend16_s
+        case 0xC3:  // i64.extend16_s
+            return "(int16_t)" + a;
+        default:
+            return {};
+    }
+}
+
+struct CControl {
+    u8 op;
+    u32 height;        // operand stack height below the block parameters, also where results go
+    BlockArity arity;
+    u32 label;         // loop start or block end
+    u32 else_label;
+};
+
+// Translates one function body. Locals and operand stack slots become C variables, so the
+// C compiler allocates registers across the whole function. Calls pass their arguments through
+// the value stack above the locals, at the slots the interpreter uses.
+class FunctionTranslator {
+public:
+    FunctionTranslator(const RuntimeFunction &func, const ModuleTypes &types, const std::vector<bool> &compiled)
+        : func_(func), types_(types), compiled_(compiled), locals_(func.localsCount) {}
+
+    // false when the body uses an opcode without translation
+    bool translate(u32 f_ind, std::span<const u8> code, std::ostream &out);
+private:
+    static std::string slot(u32 h) { return "s" + std::to_string(h); }
+    std::string top(u32 depth = 0) const { return slot(height_ - 1 - depth); }
+    std::string label(u32 id) const { return "L" + std::to_string(id); }
+
+    void push(const std::string &expr) {
+        body_ << "    " << slot(height_) << " = " << expr << ";\n";
+        ++height_;
+        max_height_ = std::max(max_height_, height_);
+    }
+
+    CControl &target(u64 depth) { return controls_[controls_.size() - 1 - depth]; }
+
+    void branchTo(u64 depth) {
+        CControl &ctrl = target(depth);
+        u32 arity = ctrl.op == Bytecode::loop ? ctrl.arity.params : ctrl.arity.results;
+        for (u32 i = 0; i < arity; ++i) {
+            if (ctrl.height + i != height_ - arity + i) {
+                body_ << "    " << slot(ctrl.height + i) << " = " << slot(height_ - arity + i) << ";\n";
+            }
+        }
+        body_ << "    goto " << label(ctrl.label) << ";\n";
+    }
+
+    void call(u32 f_ind);
+    void bulkMemory(const DecodedInstr &instr);
+
+    const RuntimeFunction &func_;
+    const ModuleTypes &types_;
+    const std::vector<bool> &compiled_;
+    u32 locals_;
+    u32 height_ = 0;
+    u32 max_height_ = 0;
+    u32 labels_ = 0;
+    std::vector<CControl> controls_;
+    std::ostringstream body_;
+};
+
+// Bulk memory goes through the runtime with its operands spilled to the frame like call arguments
+void FunctionTranslator::bulkMemory(const DecodedInstr &instr) {
+    u32 operands = instr.sub_op == misc::data_drop ? 0 : 3;
+    u32 base = height_ - operands;
+    for (u32 i = 0; i < operands; ++i) {
+        body_ << "    fp[" << locals_ + base + i << "].i = " << slot(base + i) << ";\n";
+    }
+    body_ << "    rt->bulk_memory(rt, " << instr.sub_op << ", " << static_cast<u32>(instr.imm.i)
+          << ", fp + " << locals_ + base << ");\n";
+    height_ = base;
+}
+
+void FunctionTranslator::call(u32 f_ind) {
+    auto &sig = types_.types->at(types_.func_types.at(f_ind));
+    u32 base = height_ - sig.params.size();
+    std::string args = "fp + " + std::to_string(locals_ + base);
+    for (u32 i = 0; i < sig.params.size(); ++i) {
+        body_ << "    fp[" << locals_ + base + i << "].i = " << slot(base + i) << ";\n";
+    }
+    if (compiled_[f_ind]) {
+        body_ << "    f" << f_ind << "(" << args << ", rt);\n";
+    } else {
+        body_ << "    rt->call(rt, " << f_ind << ", " << args << ");\n";
+    }
+    height_ = base;
+    for (u32 i = 0; i < sig.results.size(); ++i) {
+        push("fp[" + std::to_string(locals_ + base + i) + "].i");
+    }
+}
+
+bool FunctionTranslator::translate(u32 f_ind, std::span<const u8> code, std::ostream &out) {
+    controls_.push_back({
+        .op = Bytecode::block,
+        .height = 0,
+        .arity = {0, static_cast<u32>(func_.signature.results.size())},
+        .label = labels_++,
+        .else_label = 0
+    });
+
+    bool dead = false;
+    u32 dead_depth = 0;
+    const u8 *ptr = code.data();
+    const u8 *end = ptr + code.size();
+    while (ptr < end && !controls_.empty()) {
+        DecodedInstr instr = decodeInstr(ptr, end);
+        u8 op = instr.op;
+
+        if (dead) {
+            // unreachable code is not translated, only its nesting is tracked
+            if (op == Bytecode::block || op == Bytecode::loop || op == Bytecode::if_) {
+                ++dead_depth;
+                continue;
+            }
+            if (op == Bytecode::br_table) {
+                for (i64 i = 0; i <= instr.imm.i; ++i) {
+                    util::readULEB128(ptr, end);
+                }
+                continue;
+            }
+            if (op == Bytecode::end && dead_depth > 0) {
+                --dead_depth;
+                continue;
+            }
+            if ((op != Bytecode::end && op != Bytecode::else_) || dead_depth > 0) {
+                continue;
+            }
+        }
+
+        switch (op) {
+            case Bytecode::unreachable:
+                body_ << "    owasm_trap(rt, \"unreachable executed in compiled code\");\n";
+                dead = true;
+                break;
+            case Bytecode::nop:
+                break;
+            case Bytecode::block:
+            case Bytecode::loop:
+            case Bytecode::if_: {
+                u32 else_label = 0;
+                if (op == Bytecode::if_) {
+                    else_label = labels_++;
+                    --height_;
+                    body_ << "    if (!" << slot(height_) << ") goto " << label(else_label) << ";\n";
+                }
+                BlockArity arity = blockArity(instr.imm.i, types_);
+                u32 id = labels_++;
+                if (op == Bytecode::loop) {
+                    body_ << label(id) << ":;\n";
+                }
+                controls_.push_back({
+                    .op = op,
+                    .height = height_ - arity.params,
+                    .arity = arity,
+                    .label = id,
+                    .else_label = else_label
+                });
+                break;
+            }
+            case Bytecode::else_: {
+                CControl &ctrl = controls_.back();
+                if (!dead) {
+                    body_ << "    goto " << label(ctrl.label) << ";\n";
+                }
+                body_ << label(ctrl.else_label) << ":;\n";
+                ctrl.op = Bytecode::block;
+                height_ = ctrl.height + ctrl.arity.params;
+                dead = false;
+                break;
+            }
+            case Bytecode::end: {
+                CControl ctrl = controls_.back();
+                controls_.pop_back();
+                if (ctrl.op == Bytecode::if_) {
+                    body_ << label(ctrl.else_label) << ":;\n";
+                }
+                if (ctrl.op != Bytecode::loop) {
+                    body_ << label(ctrl.label) << ":;\n";
+                }
+                height_ = ctrl.height + ctrl.arity.results;
+                dead = false;
+                break;
+            }
+            case Bytecode::br:
+                branchTo(instr.imm.i);
+                dead = true;
+                break;
+            case Bytecode::br_if:
+                --height_;
+                body_ << "    if (" << slot(height_) << ") {\n";
+                branchTo(instr.imm.i);
+                body_ << "    }\n";
+                break;
+            case Bytecode::br_table: {
+                --height_;
+                body_ << "    switch ((uint32_t)" << slot(height_) << ") {\n";
+                for (i64 i = 0; i <= instr.imm.i; ++i) {
+                    u64 depth = util::readULEB128(ptr, end);
+                    if (i < instr.imm.i) {
+                        body_ << "    case " << i << ":\n";
+                    } else {
+                        body_ << "    default:\n";
+                    }
+                    branchTo(depth);
+                }
+                body_ << "    }\n";
+                dead = true;
+                break;
+            }
+            case Bytecode::return_:
+                branchTo(controls_.size() - 1);
+                dead = true;
+                break;
+            case Bytecode::call:
+                call(instr.imm.i);
+                break;
+            case Bytecode::memory_size:
+                push("rt->memory_grow(rt, 0)");
+                break;
+            case Bytecode::memory_grow:
+                body_ << "    " << top() << " = rt->memory_grow(rt, (uint32_t)" << top() << ");\n";
+                break;
+            case prefix::misc:
+                if (instr.sub_op < misc::memory_init || instr.sub_op > misc::memory_fill) {
+                    return false;
+                }
+                bulkMemory(instr);
+                break;
+            case Bytecode::drop:
+                --height_;
+                break;
+            case Bytecode::select:
+            case Bytecode::select_t:
+                if (op == Bytecode::select_t && instr.imm.i != I32 && instr.imm.i != I64) {
+                    return false;
+                }
+                body_ << "    " << top(2) << " = " << top() << " ? " << top(2) << " : " << top(1) << ";\n";
+                height_ -= 2;
+                break;
+            case Bytecode::local_get:
+                push("l" + std::to_string(instr.imm.i));
+                break;
+            case Bytecode::local_set:
+                --height_;
+                body_ << "    l" << instr.imm.i << " = " << slot(height_) << ";\n";
+                break;
+            case Bytecode::local_tee:
+                body_ << "    l" << instr.imm.i << " = " << top() << ";\n";
+                break;
+            case Bytecode::i32_const:
+            case Bytecode::i64_const:
+                push("(int64_t)" + std::to_string(static_cast<u64>(instr.imm.i)) + "ULL");
+                break;
+            default: {
+                if (op >= Bytecode::i32_load && op <= Bytecode::i64_store32) {
+                    // guard pages around the memory catch out of bounds addresses
+                    const char *accessor = memoryAccessor(op);
+                    if (!accessor) {
+                        return false;
+                    }
+                    std::string offset = std::to_string(static_cast<u64>(instr.imm.i)) + "ULL";
+                    if (op <= Bytecode::i64_load32_u) {
+                        body_ << "    " << top() << " = " << accessor << "(mem + (uint32_t)" << top() << " + " << offset << ");\n";
+                    } else {
+                        body_ << "    " << accessor << "(mem + (uint32_t)" << top(1) << " + " << offset << ", " << top() << ");\n";
+                        height_ -= 2;
+                    }
+                    break;
+                }
+                std::string expr = unaryExpr(op, top());
+                if (!expr.empty()) {
+                    body_ << "    " << top() << " = " << expr << ";\n";
+                    break;
+                }
+                if ((expr = binaryExpr(op, top(1), top())).empty()) {
+                    return false;
+                }
+                body_ << "    " << top(1) << " = " << expr << ";\n";
+                --height_;
+                break;
+            }
+        }
+    }
+
+    u32 params = func_.signature.params.size();
+    out << "static void f" << f_ind << "(WasmVal *fp, JitRuntime *rt) {\n";
+    out << "    ENTER(fp, " << func_.frameSize << ");\n";
+    out << "    uint8_t *const mem = rt->memory;\n";
+    for (u32 i = 0; i < locals_; ++i) {
+        out << "    int64_t l" << i << " = " << (i < params ? "fp[" + std::to_string(i) + "].i" : "0") << ";\n";
+    }
+    for (u32 h = 0; h < max_height_; ++h) {
+        out << "    int64_t " << slot(h) << " = 0;\n";
+    }
+    out << body_.str();
+    out << "    LEAVE();\n";
+    for (u32 i = 0; i < func_.signature.results.size(); ++i) {
+        out << "    fp[" << i << "].i = " << slot(i) << ";\n";
+    }
+    out << "}\n\n";
+    return true;
+}
+
+// FNV-1a over everything the generated code depends on
+class ModuleHash {
+public:
+    void add(const void *data, size_t size) {
+        auto bytes = static_cast<const u8 *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash_ = (hash_ ^ bytes[i]) * 0x100000001b3ULL;
+        }
+    }
+
+    void add(u64 value) { add(&value, sizeof(value)); }
+
+    void add(const std::string &str) {
+        add(str.size());
+        add(str.data(), str.size());
+    }
+
+    u64 value() const { return hash_; }
+private:
+    u64 hash_ = 0xcbf29ce484222325ULL;
+};
+
+u64 moduleHash(const module::WasmModule &module) {
+    ModuleHash hash;
+    hash.add(AOT_FORMAT_VERSION);
+    for (auto &type : module.typesSection) {
+        hash.add(type.params.size());
+        hash.add(type.params.data(), type.params.size() * sizeof(ValType));
+        hash.add(type.results.size());
+        hash.add(type.results.data(), type.results.size() * sizeof(ValType));
+    }
+    for (auto &import : module.importSection) {
+        hash.add(import.module);
+        hash.add(import.name);
+        hash.add(static_cast<u64>(import.kind));
+    }
+    for (auto &func : module.functionSection) {
+        hash.add(static_cast<u64>(func.ind));
+    }
+    for (auto &body : module.codeSection) {
+        for (auto &local : body.locals) {
+            hash.add(local.count);
+            hash.add(static_cast<u64>(local.type));
+        }
+        hash.add(body.code.size());
+        hash.add(body.code.data(), body.code.size());
+    }
+    return hash.value();
+}
+
+AotLibrary openAotLibrary(const std::string &so_path, u64 hash) {
+    AotLibrary lib(nullptr, dlclose);
+    if (!std::filesystem::exists(so_path)) {
+        return lib;
+    }
+    lib.reset(dlopen(std::filesystem::absolute(so_path).c_str(), RTLD_NOW | RTLD_LOCAL));
+    if (!lib) {
+        return lib;
+    }
+    auto built_from = static_cast<const u64 *>(dlsym(lib.get(), "owasm_aot_module_hash"));
+    if (!built_from || *built_from != hash) {
+        lib.reset();
+    }
+    return lib;
+}
+
+// Runs the compiler without a shell, so paths are passed as they are. True when it succeeded.
+bool runCompiler(const std::string &c_path, const std::string &out_path) {
+    const char *cc = std::getenv("OWASM_AOT_CC");
+    std::string compiler = cc ? cc : "clang";
+    std::vector<std::string> args = {compiler, "-O2", "-shared", "-fPIC", "-w", "-o", out_path, c_path};
+    std::vector<char *> argv;
+    for (auto &arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+    pid_t pid;
+    if (posix_spawnp(&pid, compiler.c_str(), nullptr, nullptr, argv.data(), environ) != 0) {
+        return false;
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void compileAotLibrary(const std::string &source, const std::string &so_path) {
+    std::string c_path = so_path + ".c";
+    std::string tmp_path = so_path + ".tmp";
+    auto cleanUp = [&] {
+        std::error_code ignored;
+        std::filesystem::remove(c_path, ignored);
+        std::filesystem::remove(tmp_path, ignored);
+    };
+    try {
+        {
+            std::ofstream c_file(c_path);
+            c_file << source;
+            if (!c_file) {
+                throw std::runtime_error("aot: cannot write " + c_path);
+            }
+        }
+        if (!runCompiler(c_path, tmp_path)) {
+            throw std::runtime_error("aot: compiling " + c_path + " failed");
+        }
+        // the library replaces an outdated one only once it is complete
+        std::filesystem::rename(tmp_path, so_path);
+    } catch (...) {
+        cleanUp();
+        throw;
+    }
+    cleanUp();
+}
+
+}
+
+std::string translateModuleToC(const CompiledModule &compiled_module) {
+    const module::WasmModule &module = compiled_module.module();
+    ModuleTypes types = collectModuleTypes(module);
+    u32 imports = compiled_module.funcCount() - module.codeSection.size();
+
+    // calls between translated functions are direct, so dropping a function retranslates its callers
+    std::vector<bool> compiled(compiled_module.funcCount(), false);
+    std::vector<std::string> bodies(compiled_module.funcCount());
+    for (u32 f_ind = imports; f_ind < compiled_module.funcCount(); ++f_ind) {
+        compiled[f_ind] = !compiled_module.getFunc(f_ind).simd;   // v128 values stay in the interpreter
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (u32 f_ind = imports; f_ind < compiled_module.funcCount(); ++f_ind) {
+            if (!compiled[f_ind]) {
+                continue;
+            }
+            std::ostringstream out;
+            FunctionTranslator translator(compiled_module.getFunc(f_ind), types, compiled);
+            if (translator.translate(f_ind, module.codeSection[f_ind - imports].code, out)) {
+                bodies[f_ind] = out.str();
+            } else {
+                compiled[f_ind] = false;
+                changed = true;
+            }
+        }
+    }
+
+    std::ostringstream out;
+    out << "#define OWASM_MAX_CALL_DEPTH " << AOT_MAX_CALL_DEPTH << "u\n";
+    out << C_PRELUDE;
+    for (u32 f_ind = imports; f_ind < compiled_module.funcCount(); ++f_ind) {
+        if (compiled[f_ind]) {
+            out << "static void f" << f_ind << "(WasmVal *fp, JitRuntime *rt);\n";
+        }
+    }
+    out << "\n";
+    for (u32 f_ind = imports; f_ind < compiled_module.funcCount(); ++f_ind) {
+        out << bodies[f_ind];
+    }
+    out << "const uint64_t owasm_aot_module_hash = " << moduleHash(module) << "ULL;\n";
+    out << "const uint32_t owasm_aot_func_count = " << compiled_module.funcCount() << ";\n";
+    out << "void (*const owasm_aot_funcs[])(WasmVal *, JitRuntime *) = {\n";
+    for (u32 f_ind = 0; f_ind < compiled_module.funcCount(); ++f_ind) {
+        out << "    " << (compiled[f_ind] ? "f" + std::to_string(f_ind) : "0") << ",\n";
+    }
+    out << "};\n";
+    return out.str();
+}
+
+AotLibrary loadAotModule(CompiledModule &compiled_module, const std::string &so_path) {
+    u64 hash = moduleHash(compiled_module.module());
+    AotLibrary lib = openAotLibrary(so_path, hash);
+    if (!lib) {
+        compileAotLibrary(translateModuleToC(compiled_module), so_path);
+        lib = openAotLibrary(so_path, hash);
+        if (!lib) {
+            throw std::runtime_error("aot: cannot load " + so_path);
+        }
+    }
+    auto count = static_cast<const u32 *>(dlsym(lib.get(), "owasm_aot_func_count"));
+    auto funcs = static_cast<const JitFunc *>(dlsym(lib.get(), "owasm_aot_funcs"));
+    if (!count || !funcs || *count != compiled_module.funcCount()) {
+        throw std::runtime_error("aot: " + so_path + " does not match the module");
+    }
+    for (u32 f_ind = 0; f_ind < compiled_module.funcCount(); ++f_ind) {
+        if (funcs[f_ind]) {
+            publish(compiled_module.getFunc(f_ind).jitCode, funcs[f_ind]);
+        }
+    }
+    return lib;
+}
+
+}
@@ -0,0 +1,86 @@
+#include "runtime/atomics.hpp"
+#include "runtime/bytecode/bytecode.hpp"
+#include <atomic>
+
+namespace omega::wass::atomics {
+
+namespace {
+
+constexpr Access WIDTHS[] = {{4, I32}, {8, I64}, {1, I32}, {2, I32}, {1, I64}, {2, I64}, {4, I64}};
+
+template <typename T>
+std::atomic_ref<T> at(const u8 *address) {
+    return std::atomic_ref(*reinterpret_cast<T *>(const_cast<u8 *>(address)));
+}
+
+template <typename T>
+u64 rmwAs(u8 *address, Rmw op, T value) {
+    switch (op) {
+        case Rmw::Add:  return at<T>(address).fetch_add(value);
+        case Rmw::Sub:  return at<T>(address).fetch_sub(value);
+        case Rmw::And:  return at<T>(address).fetch_and(value);
+        case Rmw::Or:   return at<T>(address).fetch_or(value);
+        case Rmw::Xor:  return at<T>(address).fetch_xor(value);
+        case Rmw::Xchg: return at<T>(address).exchange(value);
+    }
+    return 0;
+}
+
+template <typename T>
+u64 cmpxchgAs(u8 *address, T expected, T replacement) {
+    // on failure expected receives the current value, so it is the old value either way
+    at<T>(address).compare_exchange_strong(expected, replacement);
+    return expected;
+}
+
+}
+
+Access access(u32 sub_op) {
+    u32 first = sub_op < runtime::atomic::store ? runtime::atomic::load
+              : sub_op < runtime::atomic::rmw_add ? runtime::atomic::store
+              : runtime::atomic::rmw_add;
+    return WIDTHS[(sub_op - first) % 7];
+}
+
+Rmw rmwOp(u32 sub_op) {
+    return static_cast<Rmw>((sub_op - runtime::atomic::rmw_add) / 7);
+}
+
+u64 load(const u8 *address, u32 size) {
+    switch (size) {
+        case 1:  return at<u8>(address).load();
+        case 2:  return at<u16>(address).load();
+        case 4:  return at<u32>(address).load();
+        default: return at<u64>(address).load();
+    }
+}
+
+void store(u8 *address, u32 size, u64 value) {
+    switch (size) {
+        case 1:  at<u8>(address).store(static_cast<u8>(value)); break;
+        case 2:  at<u16>(address).store(static_cast<u16>(value)); break;
+        case 4:  at<u32>(address).store(static_cast<u32>(value)); break;
+        default: at<u64>(address).store(value); break;
+    }
+}
+
+u64 rmw(u8 *address, u32 size, Rmw op, u64 value) {
+    switch (size) {
+        case 1:  return rmwAs<u8>(address, op, static_cast<u8>(value));
+        case 2:  return rmwAs<u16>(address, op, static_cast<u16>(value));
+        case 4:  return rmwAs<u32>(address, op, static_cast<u32>(value));
+        default: return rmwAs<u64>(address, op, value);
+    }
+}
+
+u64 cmpxchg(u8 *address, u32 size, u64 expected, u64 replacement) {
+    // both operands wrap to the access width, as the proposal specifies
+    switch (size) {
+        case 1:  return cmpxchgAs<u8>(address, static_cast<u8>(expected), static_cast<u8>(replacement));
+        case 2:  return cmpxchgAs<u16>(address, static_cast<u16>(expected), static_cast<u16>(replacement));
+        case 4:  return cmpxchgAs<u32>(address, static_cast<u32>(expected), static_cast<u32>(replacement));
+        default: return cmpxchgAs<u64>(address, expected, replacement);
+    }
+}
+
+}
@@ -0,0 +1,87 @@
+#include "runtime/compiled_module.hpp"
+#include "runtime/aot.hpp"
+#include "runtime/decoder.hpp"
+#include "runtime/init.hpp"
+#include "runtime/jit.hpp"
+
+namespace omega::wass {
+
+CompiledModule::CompiledModule(module::WasmModule module, const RuntimeOptions &options,
+                               HandlerTable stack_handlers, HandlerTable reg_handlers)
+    : module_(std::move(module)), options_(options) {
+    initOptions();
+    if (options_.tier == ExecTier::Register && needsStackTier(module_)) {
+        // the register tier has no v128 registers and no atomics
+        options_.tier = ExecTier::Stack;
+    }
+    handlers_ = options_.tier == ExecTier::Register ? reg_handlers : stack_handlers;
+    funcs_ = initRuntimeFunctions(module_, options_, handlers_);
+    if (options_.lazy) {
+        types_ = std::make_unique<ModuleTypes>(collectModuleTypes(module_));
+    }
+    initCompiledCode();
+}
+
+CompiledModule::CompiledModule(module::WasmModule module, const RuntimeOptions &options, ExecTier tier,
+                               FunctionsContainer defined)
+    : module_(std::move(module)), options_(options) {
+    initOptions();
+    options_.tier = tier;
+    // translated already, nothing is left pending
+    options_.lazy = false;
+    funcs_ = initImportFuncs(module_);
+    std::move(defined.begin(), defined.end(), std::back_inserter(funcs_));
+    initCompiledCode();
+}
+
+CompiledModule::~CompiledModule() = default;
+
+void CompiledModule::initOptions() {
+    start_ind_ = findStartFuncInd(module_);
+    thread_start_ind_ = findExportedFunc(module_, "wasi_thread_start").value_or(NO_FUNC);
+    if (options_.jit || !options_.aot_path.empty()) {
+        // compiled up front, from translated functions
+        options_.lazy = false;
+    }
+    if (options_.jit || options_.tier_up || !options_.aot_path.empty()) {
+        // compiled code shares the frame layout of the stack tier
+        options_.tier = ExecTier::Stack;
+    }
+    if (options_.lazy) {
+        // whether the register tier can run the module depends on every body, which lazy
+        // loading does not look at
+        options_.tier = ExecTier::Stack;
+    }
+}
+
+void CompiledModule::initCompiledCode() {
+    if (options_.jit || options_.tier_up || !options_.aot_path.empty()) {
+        jit_ = std::make_unique<JitCompiler>(*this);
+    }
+    if (!options_.aot_path.empty()) {
+        aot_ = loadAotModule(*this, options_.aot_path);
+    }
+    if (options_.jit) {
+        jit_->compileModule();
+    }
+}
+
+void CompiledModule::translate(u32 f_ind) {
+    std::lock_guard lock(translate_lock_);
+    RuntimeFunction &f = funcs_[f_ind];
+    if (!f.pending) {
+        return;   // another thread got to it first
+    }
+    u32 index = f_ind - (funcs_.size() - module_.codeSection.size());
+    RuntimeFunction translated = readWasmFunction(module_, index, *types_, options_, handlers_);
+    // callers on other threads may read the signature meanwhile, only the translation is filled in
+    f.code = std::move(translated.code);
+    f.regCode = std::move(translated.regCode);
+    f.localsCount = translated.localsCount;
+    f.frameSize = translated.frameSize;
+    f.simd = translated.simd;
+    f.loopHotness = std::move(translated.loopHotness);
+    publish(f.pending, false);
+}
+
+}
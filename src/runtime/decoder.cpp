@@ -0,0 +1,351 @@
+#include "runtime/decoder.hpp"
+#include "runtime/simd.hpp"
+#include "util/util.hpp"
+#include <cstring>
+#include <string>
+
+namespace omega::wass {
+using namespace runtime;
+
+namespace {
+
+// Bodies may end right at the end of a mapped file, fixed size immediates are checked before
+// they are read
+void checkAvailable(const u8 *ptr, const u8 *end, size_t size) {
+    if (end - ptr < static_cast<ptrdiff_t>(size)) {
+        throw std::runtime_error("truncated instruction in function body");
+    }
+}
+
+}
+
+void decodeMiscImmediates(DecodedInstr &instr, const u8 *&ptr, const u8 *end) {
+    instr.sub_op = util::readULEB128(ptr, end);
+    switch (instr.sub_op) {
+        case 8:  // memory.init
+            instr.imm.i = util::readULEB128(ptr, end);
+            ++ptr;
+            break;
+        case 9:  // data.drop
+        case 13: // elem.drop
+        case 15: // table.grow
+        case 16: // table.size
+        case 17: // table.fill
+            instr.imm.i = util::readULEB128(ptr, end);
+            break;
+        case 10: // memory.copy
+            ptr += 2;
+            break;
+        case 11: // memory.fill
+            ++ptr;
+            break;
+        case 12: // table.init
+        case 14: // table.copy
+            instr.imm.i = util::readULEB128(ptr, end);
+            instr.imm2 = util::readULEB128(ptr, end);
+            break;
+        default:
+            if (instr.sub_op > 7) {
+                throw std::runtime_error("unknown 0xFC opcode: " + std::to_string(instr.sub_op));
+            }
+    }
+}
+
+void decodeSimdImmediates(DecodedInstr &instr, const u8 *&ptr, const u8 *end) {
+    instr.sub_op = util::readULEB128(ptr, end);
+    switch (simd::opInfo(instr.sub_op).shape) {
+        case simd::Shape::None:
+            throw std::runtime_error("unknown 0xFD opcode: " + std::to_string(instr.sub_op));
+        case simd::Shape::Load:
+        case simd::Shape::Store:
+            util::readULEB128(ptr, end);
+            instr.imm.i = util::readULEB128(ptr, end);
+            break;
+        case simd::Shape::LoadLane:
+        case simd::Shape::StoreLane:
+            util::readULEB128(ptr, end);
+            instr.imm.i = util::readULEB128(ptr, end);
+            checkAvailable(ptr, end, 1);
+            instr.imm2 = *ptr++;
+            break;
+        case simd::Shape::Const:
+        case simd::Shape::Shuffle:
+            checkAvailable(ptr, end, 2 * sizeof(u64));
+            std::memcpy(&instr.imm.i, ptr, sizeof(u64));
+            std::memcpy(&instr.imm_hi, ptr + sizeof(u64), sizeof(u64));
+            ptr += 2 * sizeof(u64);
+            break;
+        case simd::Shape::ExtractLane:
+        case simd::Shape::ReplaceLane:
+            checkAvailable(ptr, end, 1);
+            instr.imm2 = *ptr++;
+            break;
+        default:
+            break;
+    }
+}
+
+void decodeAtomicImmediates(DecodedInstr &instr, const u8 *&ptr, const u8 *end) {
+    instr.sub_op = util::readULEB128(ptr, end);
+    if (instr.sub_op == atomic::fence) {
+        ++ptr;
+        return;
+    }
+    if (instr.sub_op > atomic::last || (instr.sub_op > atomic::fence && instr.sub_op < atomic::load)) {
+        throw std::runtime_error("unknown 0xFE opcode: " + std::to_string(instr.sub_op));
+    }
+    // the alignment has to match the access width exactly, keep it for the validator
+    instr.imm2 = util::readULEB128(ptr, end);
+    instr.imm.i = util::readULEB128(ptr, end);
+}
+
+DecodedInstr decodeInstr(const u8 *&ptr, const u8 *end) {
+    checkAvailable(ptr, end, 1);
+    DecodedInstr instr{.op = *ptr++, .sub_op = 0, .imm = {.i = 0}, .imm2 = 0, .imm_hi = 0};
+
+    switch (instr.op) {
+        case Bytecode::block:
+        case Bytecode::loop:
+        case Bytecode::if_:
+            // s33: negative values are the single byte forms (empty or value type), others are type indices
+            instr.imm.i = util::readLEB128(ptr, end);
+            break;
+        case Bytecode::br_table:
+            instr.imm.i = util::readULEB128(ptr, end);
+            break;
+        case Bytecode::br:
+        case Bytecode::br_if:
+        case Bytecode::call:
+        case Bytecode::return_call:
+        case Bytecode::call_ref:
+        case Bytecode::local_get:
+        case Bytecode::local_set:
+        case Bytecode::local_tee:
+        case Bytecode::global_get:
+        case Bytecode::global_set:
+        case Bytecode::table_get:
+        case Bytecode::table_set:
+        case REF_FUNC:
+            instr.imm.i = util::readULEB128(ptr, end);
+            break;
+        case CALL_INDIRECT:
+        case Bytecode::return_call_indirect:
+            instr.imm.i = util::readULEB128(ptr, end);
+            instr.imm2 = util::readULEB128(ptr, end);
+            break;
+        case Bytecode::select_t: {
+            // keep the first operand type, the MVP allows exactly one
+            u64 count = util::readULEB128(ptr, end);
+            checkAvailable(ptr, end, count);
+            instr.imm.i = count ? *ptr : 0;
+            ptr += count;
+            break;
+        }
+        case REF_NULL:
+            checkAvailable(ptr, end, 1);
+            instr.imm.i = *ptr++;
+            break;
+        case Bytecode::memory_size:
+        case Bytecode::memory_grow:
+            ++ptr;
+            break;
+        case Bytecode::i32_const:
+        case Bytecode::i64_const:
+            instr.imm.i = util::readLEB128(ptr, end);
+            break;
+        case Bytecode::f32_const: {
+            f32 val;
+            checkAvailable(ptr, end, sizeof(f32));
+            std::memcpy(&val, ptr, sizeof(f32));
+            ptr += sizeof(f32);
+            instr.imm.f = val;
+            break;
+        }
+        case Bytecode::f64_const:
+            checkAvailable(ptr, end, sizeof(f64));
+            std::memcpy(&instr.imm.f, ptr, sizeof(f64));
+            ptr += sizeof(f64);
+            break;
+        case prefix::misc:
+            decodeMiscImmediates(instr, ptr, end);
+            break;
+        case prefix::simd:
+            decodeSimdImmediates(instr, ptr, end);
+            break;
+        case prefix::atomic:
+            decodeAtomicImmediates(instr, ptr, end);
+            break;
+        default:
+            if (instr.op >= Bytecode::i32_load && instr.op <= Bytecode::i64_store32) {
+                // memarg: alignment hint is not needed at runtime, keep the offset
+                util::readULEB128(ptr, end);
+                instr.imm.i = util::readULEB128(ptr, end);
+            }
+            break;
+    }
+    if (ptr > end) {
+        throw std::runtime_error("truncated instruction in function body");
+    }
+    return instr;
+}
+
+ModuleTypes collectModuleTypes(const module::WasmModule &module) {
+    ModuleTypes types{.types = &module.typesSection, .func_types = {}, .global_types = {}, .table_types = {},
+                      .memory_count = static_cast<u32>(module.memorySection.size()),
+                      .data_count = static_cast<u32>(module.dataSection.size())};
+    for (auto &imp : module.importSection) {
+        if (imp.kind == module::ImportKind::FUNC) {
+            types.func_types.push_back(imp.typeIndex);
+        }
+    }
+    for (auto f : module.functionSection) {
+        types.func_types.push_back(f.ind);
+    }
+    for (auto &imp : module.importSection) {
+        if (imp.kind == module::ImportKind::GLOBAL) {
+            types.global_types.push_back({imp.globalType.valType, imp.globalType.mutable_ == mutability::var});
+        } else if (imp.kind == module::ImportKind::TABLE) {
+            types.table_types.push_back(static_cast<ValType>(reftype::funcref));
+        } else if (imp.kind == module::ImportKind::MEMORY) {
+            ++types.memory_count;
+        }
+    }
+    for (auto &g : module.globalSection) {
+        types.global_types.push_back({g.valType, g.mutable_ == MutableType::MUT});
+    }
+    for (auto &t : module.tableSection) {
+        types.table_types.push_back(static_cast<ValType>(t.elemType));
+    }
+    return types;
+}
+
+BlockArity blockArity(i64 block_type, const ModuleTypes &types) {
+    if (block_type >= 0) {
+        auto &sig = types.types->at(block_type);
+        return {static_cast<u32>(sig.params.size()), static_cast<u32>(sig.results.size())};
+    }
+    if ((block_type & 0x7F) == blocktype::empty) {
+        return {0, 0};
+    }
+    return {0, 1};
+}
+
+StackEffect stackEffect(const DecodedInstr &instr, const ModuleTypes &types) {
+    u8 op = instr.op;
+    switch (op) {
+        case Bytecode::call: {
+            auto &sig = types.types->at(types.func_types.at(instr.imm.i));
+            return {static_cast<u32>(sig.params.size()), static_cast<u32>(sig.results.size())};
+        }
+        case CALL_INDIRECT: {
+            auto &sig = types.types->at(instr.imm.i);
+            return {static_cast<u32>(sig.params.size()) + 1, static_cast<u32>(sig.results.size())};
+        }
+        case Bytecode::drop:
+        case Bytecode::local_set:
+        case Bytecode::global_set:
+            return {1, 0};
+        case Bytecode::select:
+        case Bytecode::select_t:
+            return {3, 1};
+        case Bytecode::local_get:
+        case Bytecode::global_get:
+        case Bytecode::memory_size:
+        case Bytecode::i32_const:
+        case Bytecode::i64_const:
+        case Bytecode::f32_const:
+        case Bytecode::f64_const:
+        case REF_NULL:
+        case REF_FUNC:
+            return {0, 1};
+        case Bytecode::local_tee:
+        case Bytecode::table_get:
+        case Bytecode::memory_grow:
+        case REF_IS_NULL:
+            return {1, 1};
+        case Bytecode::table_set:
+            return {2, 0};
+        case prefix::misc:
+            switch (instr.sub_op) {
+                case 8:  // memory.init
+                case 10: // memory.copy
+                case 11: // memory.fill
+                case 12: // table.init
+                case 14: // table.copy
+                case 17: // table.fill
+                    return {3, 0};
+                case 9:  // data.drop
+                case 13: // elem.drop
+                    return {0, 0};
+                case 15: // table.grow
+                    return {2, 1};
+                case 16: // table.size
+                    return {0, 1};
+                default: // saturating truncations
+                    return {1, 1};
+            }
+        case prefix::simd:
+            switch (simd::opInfo(instr.sub_op).shape) {
+                case simd::Shape::Const:
+                    return {0, 1};
+                case simd::Shape::Store:
+                case simd::Shape::StoreLane:
+                    return {2, 0};
+                case simd::Shape::LoadLane:
+                case simd::Shape::Shuffle:
+                case simd::Shape::Binary:
+                case simd::Shape::Shift:
+                case simd::Shape::ReplaceLane:
+                    return {2, 1};
+                case simd::Shape::Ternary:
+                    return {3, 1};
+                default:
+                    return {1, 1};
+            }
+        case prefix::atomic:
+            switch (instr.sub_op) {
+                case atomic::memory_notify:
+                    return {2, 1};
+                case atomic::memory_wait32:
+                case atomic::memory_wait64:
+                    return {3, 1};
+                case atomic::fence:
+                    return {0, 0};
+                default:
+                    if (instr.sub_op < atomic::store) {
+                        return {1, 1};
+                    }
+                    if (instr.sub_op < atomic::rmw_add) {
+                        return {2, 0};
+                    }
+                    return instr.sub_op < atomic::rmw_cmpxchg ? StackEffect{2, 1} : StackEffect{3, 1};
+            }
+        default:
+            break;
+    }
+    if (op >= Bytecode::i32_load && op <= Bytecode::i64_load32_u) {
+        return {1, 1};
+    }
+    if (op >= Bytecode::i32_store && op <= Bytecode::i64_store32) {
+        return {2, 0};
+    }
+    if (op == Bytecode::i32_eqz || op == Bytecode::i64_eqz) {
+        return {1, 1};
+    }
+    if (op >= Bytecode::i32_eq && op <= Bytecode::f64_ge) {
+        return {2, 1};
+    }
+    if ((op >= Bytecode::i32_clz && op <= Bytecode::i32_popcnt) ||
+        (op >= Bytecode::i64_clz && op <= Bytecode::i64_popcnt) ||
+        (op >= Bytecode::f32_abs && op <= Bytecode::f32_sqrt) ||
+        (op >= Bytecode::f64_abs && op <= Bytecode::f64_sqrt) ||
+        (op >= Bytecode::i32_wrap_i64 && op <= 0xC4)) {
+        return {1, 1};
+    }
+    if (op >= Bytecode::i32_add && op <= Bytecode::f64_copysign) {
+        return {2, 1};
+    }
+    return {0, 0};
+}
+
+}
@@ -1,8 +1,19 @@
 #include "runtime/init.hpp"
+#include "runtime/atomics.hpp"
+#include "runtime/decoder.hpp"
+#include "runtime/register_ir.hpp"
+#include "runtime/simd.hpp"
+#include "runtime/threads.hpp"
+#include "runtime/validator.hpp"
+#include "util/parallel.hpp"
 #include "util/util.hpp"
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <memory>
 #include <cstring>
+#include <algorithm>
+#include <exception>
 
 namespace omega::wass {
 
@@ -10,6 +21,8 @@ auto closeDl = [](void *ptr) { dlclose(ptr);};
 using DlHandlePtr = std::unique_ptr<void, decltype(closeDl)>;
 
 constexpr std::string_view START_FUNC_NAME = "_start";
+// fewer bodies than this are not worth starting another thread for
+constexpr size_t MIN_BODIES_PER_THREAD = 64;
 
 inline static const std::unordered_map<std::string, const char*> lib_alias = {
         { "ld-linux",       LD_SO },
@@ -73,7 +86,15 @@ std::vector<ValType> createNativeFuncParams(std::string_view signature) {
 template <typename BackInserter>
 void readImportFuncs(module::WasmModule &module, BackInserter inserter) {
     for (auto &imp : module.importSection) {
-        if (imp.kind == module::ImportKind::FUNC) {
+        if (imp.kind == module::ImportKind::FUNC && imp.module == "wasi" && imp.name == "thread-spawn") {
+            // provided by the runtime itself, not by a native library
+            RuntimeFunction runtimeFunction;
+            runtimeFunction.isNative = true;
+            runtimeFunction.native_ptr = reinterpret_cast<NativeFuncType>(&wasiThreadSpawn);
+            runtimeFunction.signature = module.typesSection.at(imp.typeIndex);
+            *inserter = runtimeFunction;
+            ++inserter;
+        } else if (imp.kind == module::ImportKind::FUNC) {
             auto native_func_sig  = util::parse_call(imp.name);
             std::string_view libname;
             auto it = lib_alias.find(imp.module);
@@ -96,88 +117,475 @@ void readImportFuncs(module::WasmModule &module, BackInserter inserter) {
     }
 }
 
-template <typename BackInserter>
-void readWasmFunction(module::WasmModule &module, BackInserter inserter) {
-    auto func_ind_section = module.functionSection;
-    i32 index = 0;
-    for (auto &body : module.codeSection) {
-        RuntimeFunction runtimeFunction;
-        for (auto localVar : body.locals) {
-            std::fill_n(std::back_inserter(runtimeFunction.locals), localVar.count, Operand(localVar.type, 0L));
+// Reads nothing but the module, so bodies are processed in parallel
+RuntimeFunction readWasmFunction(const module::WasmModule &module, u32 index, const ModuleTypes &types,
+                                 const RuntimeOptions &options, HandlerTable handlers) {
+    const module::FunctionBody &body = module.codeSection[index];
+    RuntimeFunction runtimeFunction;
+    runtimeFunction.signature = module.typesSection.at(module.functionSection.at(index).ind);
+    std::vector<ValType> local_types = runtimeFunction.signature.params;
+    for (auto localVar : body.locals) {
+        std::fill_n(std::back_inserter(local_types), localVar.count, localVar.type);
+    }
+    runtimeFunction.simd = validateFunction(body.code, runtimeFunction.signature, local_types, types);
+    runtimeFunction.localsCount = local_types.size();
+
+    if (options.tier == ExecTier::Register) {
+        if (runtimeFunction.simd) {
+            throw std::runtime_error("v128 values are only supported by the stack tier");
+        }
+        runtimeFunction.regCode = translateRegisterCode(body.code, runtimeFunction.signature,
+                                                        runtimeFunction.localsCount, types, handlers,
+                                                        runtimeFunction.frameSize);
+    } else {
+        u32 loop_count = 0;
+        runtimeFunction.code = translateCode(body.code, runtimeFunction.signature,
+                                             local_types, runtimeFunction.simd, types, handlers,
+                                             options.fuse, options.tier_up,
+                                             runtimeFunction.frameSize, loop_count);
+        if (options.tier_up) {
+            runtimeFunction.loopHotness.assign(loop_count, 0);
         }
-        runtimeFunction.signature = module.typesSection.at(func_ind_section.at(index).ind);
-        runtimeFunction.labelMap = createLabelMap(body.code);
-        runtimeFunction.code = std::move(body.code);
+    }
+    return runtimeFunction;
+}
 
-        *inserter = std::move(runtimeFunction);
-        ++inserter;
-        ++index;
+template <typename BackInserter>
+void readWasmFunctions(module::WasmModule &module, const RuntimeOptions &options, HandlerTable handlers, BackInserter inserter) {
+    ModuleTypes types = collectModuleTypes(module);
+    std::vector<RuntimeFunction> funcs(module.codeSection.size());
+    std::vector<std::exception_ptr> errors(funcs.size());
+    util::parallelFor(funcs.size(), options.load_threads, MIN_BODIES_PER_THREAD, [&](size_t index) {
+        try {
+            funcs[index] = readWasmFunction(module, index, types, options, handlers);
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+    });
+    // the first invalid body fails the load, whatever thread got to it first
+    for (auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
     }
+    std::move(funcs.begin(), funcs.end(), inserter);
 }
 
-u32 findStartFuncInd(module::WasmModule &module) {
+std::optional<u32> findExportedFunc(const module::WasmModule &module, std::string_view name) {
     for (auto &exp : module.exportSection) {
         if (exp.kind == module::ExportKind::FUNC_EXP) {
-            if (exp.name == START_FUNC_NAME) {
+            if (exp.name == name) {
                 return exp.index;
             }
         }
     }
-    throw std::runtime_error("_start function not found");
+    return std::nullopt;
 }
 
-LabelMap createLabelMap(const std::vector<u8> &code) {
-    LabelMap map;
-    std::stack<ControlBlock*> control_stack;
+u32 findStartFuncInd(module::WasmModule &module) {
+    std::optional<u32> ind = findExportedFunc(module, START_FUNC_NAME);
+    if (!ind) {
+        throw std::runtime_error("_start function not found");
+    }
+    return *ind;
+}
+
+bool needsStackTier(const module::WasmModule &module) {
+    for (auto &type : module.typesSection) {
+        if (std::ranges::count(type.params, V128) || std::ranges::count(type.results, V128)) {
+            return true;
+        }
+    }
+    for (auto &body : module.codeSection) {
+        for (auto &local : body.locals) {
+            if (local.type == V128) {
+                return true;
+            }
+        }
+        const u8 *ptr = body.code.data();
+        const u8 *end = ptr + body.code.size();
+        while (ptr < end) {
+            DecodedInstr instr = decodeInstr(ptr, end);
+            if (instr.op == runtime::prefix::simd || instr.op == runtime::prefix::atomic) {
+                return true;
+            }
+            if (instr.op == runtime::Bytecode::br_table) {
+                for (i64 i = 0; i <= instr.imm.i; ++i) {
+                    util::readULEB128(ptr, end);
+                }
+            }
+        }
+    }
+    return false;
+}
+
+struct StackControl {
+    u8 op;
+    u32 height;               // operand stack height below the block parameters
+    BlockArity arity;
+    u32 start;                // first instruction of a loop body
+    u32 else_patch;           // if_ instruction, patched to the else branch
+    std::vector<u32> patches; // forward branches patched to the end of the block
+};
+
+constexpr u32 NO_PATCH = UINT32_MAX;
+
+// Checks whether the translated code ends with the given handlers, none of them before fence
+bool endsWith(const std::vector<Instr> &instrs, u32 fence, HandlerTable handlers, std::initializer_list<u16> ops) {
+    if (instrs.size() < fence + ops.size()) {
+        return false;
+    }
+    auto it = instrs.end() - ops.size();
+    for (u16 op : ops) {
+        if ((it++)->handler != handlers[op]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Handler and immediate of a 0xFD instruction, picked by its operand shape
+Instr translateSimd(const DecodedInstr &decoded, HandlerTable handlers) {
+    using namespace runtime;
+    const simd::OpInfo &info = simd::opInfo(decoded.sub_op);
+    Instr instr{.handler = nullptr, .imm = {.simd = {.offset = static_cast<u32>(decoded.imm.i),
+                                                     .kernel = static_cast<u16>(decoded.sub_op),
+                                                     .lane = static_cast<u8>(decoded.imm2),
+                                                     .size = info.size}}};
+    switch (info.shape) {
+        case simd::Shape::Load:
+            switch (info.size) {
+                case 1:  instr.handler = handlers[InternalBytecode::v128_load8]; break;
+                case 2:  instr.handler = handlers[InternalBytecode::v128_load16]; break;
+                case 4:  instr.handler = handlers[InternalBytecode::v128_load32]; break;
+                case 8:  instr.handler = handlers[InternalBytecode::v128_load64]; break;
+                default: instr.handler = handlers[InternalBytecode::v128_load]; break;
+            }
+            break;
+        case simd::Shape::Store:       instr.handler = handlers[InternalBytecode::v128_store]; break;
+        case simd::Shape::LoadLane:    instr.handler = handlers[InternalBytecode::v128_load_lane]; break;
+        case simd::Shape::StoreLane:   instr.handler = handlers[InternalBytecode::v128_store_lane]; break;
+        case simd::Shape::Const:
+            instr = {.handler = handlers[InternalBytecode::v128_const], .imm = {.i = decoded.imm.i}};
+            break;
+        case simd::Shape::Shuffle:
+            instr = {.handler = handlers[InternalBytecode::i8x16_shuffle], .imm = {.i = decoded.imm.i}};
+            break;
+        case simd::Shape::Unary:       instr.handler = handlers[InternalBytecode::v128_unary]; break;
+        case simd::Shape::Binary:      instr.handler = handlers[InternalBytecode::v128_binary]; break;
+        case simd::Shape::Ternary:     instr.handler = handlers[InternalBytecode::v128_ternary]; break;
+        case simd::Shape::Test:        instr.handler = handlers[InternalBytecode::v128_test]; break;
+        case simd::Shape::Shift:       instr.handler = handlers[InternalBytecode::v128_shift]; break;
+        case simd::Shape::Splat:       instr.handler = handlers[InternalBytecode::v128_splat]; break;
+        case simd::Shape::ExtractLane: instr.handler = handlers[InternalBytecode::v128_extract_lane]; break;
+        case simd::Shape::ReplaceLane: instr.handler = handlers[InternalBytecode::v128_replace_lane]; break;
+        case simd::Shape::None:        break;
+    }
+    return instr;
+}
+
+// Handler and immediate of a 0xFE instruction
+Instr translateAtomic(const DecodedInstr &decoded, HandlerTable handlers) {
+    using namespace runtime;
+    u32 sub_op = decoded.sub_op;
+    Instr instr{.handler = nullptr, .imm = {.atomic = {.offset = static_cast<u32>(decoded.imm.i),
+                                                       .size = 4, .rmw = 0, .wide = false}}};
+    switch (sub_op) {
+        case atomic::memory_notify:
+            instr.handler = handlers[InternalBytecode::memory_atomic_notify];
+            return instr;
+        case atomic::memory_wait32:
+        case atomic::memory_wait64:
+            instr.handler = handlers[InternalBytecode::memory_atomic_wait];
+            instr.imm.atomic.size = sub_op == atomic::memory_wait64 ? 8 : 4;
+            return instr;
+        case atomic::fence:
+            instr.handler = handlers[InternalBytecode::atomic_fence];
+            return instr;
+        default:
+            break;
+    }
+    atomics::Access access = atomics::access(sub_op);
+    instr.imm.atomic.size = access.size;
+    instr.imm.atomic.wide = access.type == I64;
+    if (sub_op < atomic::store) {
+        instr.handler = handlers[InternalBytecode::atomic_load];
+    } else if (sub_op < atomic::rmw_add) {
+        instr.handler = handlers[InternalBytecode::atomic_store];
+    } else if (sub_op < atomic::rmw_cmpxchg) {
+        instr.handler = handlers[InternalBytecode::atomic_rmw];
+        instr.imm.atomic.rmw = static_cast<u8>(atomics::rmwOp(sub_op));
+    } else {
+        instr.handler = handlers[InternalBytecode::atomic_cmpxchg];
+    }
+    return instr;
+}
+
+std::vector<Instr> translateCode(std::span<const u8> code,
+                                 const module::FuncSignature &sig,
+                                 const std::vector<ValType> &local_types,
+                                 bool simd,
+                                 const ModuleTypes &types,
+                                 HandlerTable handlers,
+                                 bool fuse,
+                                 bool loop_headers,
+                                 u32 &frame_size,
+                                 u32 &loop_count) {
+    std::vector<Instr> instrs;
+    std::vector<StackControl> controls;
+    u32 height = 0;
+    u32 max_height = 0;
+    bool dead = false;
+    u32 dead_depth = 0;
+    u32 fence = 0;  // instructions below may be branch targets and are not fused
+    loop_count = 0;
+    instrs.reserve(code.size());
+
+    // function body acts as the outermost block, its end is the return point
+    controls.push_back({
+        .op = runtime::Bytecode::block,
+        .height = 0,
+        .arity = {0, static_cast<u32>(sig.results.size())},
+        .start = 0,
+        .else_patch = NO_PATCH,
+        .patches = {}
+    });
+
+    // resolves the label at depth for a branch taken at the current height
+    auto branchTo = [&](u64 depth, Instr &instr) {
+        if (depth >= controls.size()) {
+            throw std::runtime_error("branch depth out of range");
+        }
+        StackControl &target = controls[controls.size() - 1 - depth];
+        u32 arity = target.op == runtime::Bytecode::loop ? target.arity.params : target.arity.results;
+        instr.imm.br = {
+            .ip = target.start,
+            .drop = static_cast<u16>(height - arity - target.height),
+            .keep = static_cast<u16>(arity)
+        };
+        if (target.op != runtime::Bytecode::loop) {
+            target.patches.push_back(instrs.size());
+        }
+    };
+
+    const u8 *ptr = code.data();
+    const u8 *end = ptr + code.size();
+    while (ptr < end && !controls.empty()) {
+        DecodedInstr decoded = decodeInstr(ptr, end);
+        u8 op = decoded.op;
+        Instr instr{.handler = handlers[op], .imm = {.i = decoded.imm.i}};
+        u32 loop_index = loop_count;
+        if (op == runtime::Bytecode::loop) {
+            ++loop_count;
+        }
+
+        if (dead) {
+            // unreachable code is dropped, only its nesting is tracked
+            if (op == runtime::Bytecode::block || op == runtime::Bytecode::loop || op == runtime::Bytecode::if_) {
+                ++dead_depth;
+                continue;
+            }
+            if (op == runtime::Bytecode::br_table) {
+                for (i64 i = 0; i <= decoded.imm.i; ++i) {
+                    util::readULEB128(ptr, end);
+                }
+                continue;
+            }
+            if (op == runtime::Bytecode::end && dead_depth > 0) {
+                --dead_depth;
+                continue;
+            }
+            if ((op != runtime::Bytecode::end && op != runtime::Bytecode::else_) || dead_depth > 0) {
+                continue;
+            }
+        }
 
-    u32 size = code.size();
-    for (u32 i = 0; i < size; ++i) {
-        u8 op = code[i];
         switch (op) {
+            case runtime::Bytecode::nop:
+                continue;
             case runtime::Bytecode::block:
             case runtime::Bytecode::loop:
             case runtime::Bytecode::if_: {
-                u32 label_ind = i + 1;
-                u8 block_type = code.at(label_ind);
-                if (
-                        block_type != ValType::BLOCK &&
-                        block_type != ValType::F32 &&
-                        block_type != ValType::F64 &&
-                        block_type != ValType::I32 &&
-                        block_type != ValType::I32
-                        ) {
+                // block and loop only shape the branch targets and need no instruction,
+                // unless loops count their iterations for tier-up
+                u32 start = instrs.size();
+                u32 else_patch = NO_PATCH;
+                if (op == runtime::Bytecode::if_) {
+                    --height;
+                    else_patch = instrs.size();
+                    instrs.push_back(instr);
+                } else if (op == runtime::Bytecode::loop && loop_headers) {
+                    instrs.push_back({.handler = handlers[runtime::InternalBytecode::loop_header],
+                                      .imm = {.i = loop_index}});
+                }
+                fence = instrs.size();
+                BlockArity arity = blockArity(decoded.imm.i, types);
+                controls.push_back({
+                    .op = op,
+                    .height = height - arity.params,
+                    .arity = arity,
+                    .start = op == runtime::Bytecode::loop ? start : static_cast<u32>(instrs.size()),
+                    .else_patch = else_patch,
+                    .patches = {}
+                });
+                continue;
+            }
+            case runtime::Bytecode::else_: {
+                StackControl &ctrl = controls.back();
+                if (!dead) {
+                    ctrl.patches.push_back(instrs.size());
+                    instrs.push_back(instr);
+                }
+                instrs[ctrl.else_patch].imm.br = {.ip = static_cast<u32>(instrs.size()), .drop = 0, .keep = 0};
+                ctrl.else_patch = NO_PATCH;
+                fence = instrs.size();
+                height = ctrl.height + ctrl.arity.params;
+                dead = false;
+                continue;
+            }
+            case runtime::Bytecode::end: {
+                StackControl ctrl = std::move(controls.back());
+                controls.pop_back();
+                if (!controls.empty()) {
+                    u32 target = instrs.size();
+                    fence = target;
+                    for (u32 pc : ctrl.patches) {
+                        instrs[pc].imm.br.ip = target;
+                    }
+                    if (ctrl.else_patch != NO_PATCH) {
+                        instrs[ctrl.else_patch].imm.br = {.ip = target, .drop = 0, .keep = 0};
+                    }
+                    height = ctrl.height + ctrl.arity.results;
+                    dead = false;
+                    continue;
+                }
+                // function end: branches to the function body return through it
+                for (u32 pc : ctrl.patches) {
+                    instrs[pc].imm.br.ip = instrs.size();
+                }
+                break;
+            }
+            case runtime::Bytecode::br:
+                branchTo(decoded.imm.i, instr);
+                dead = true;
+                break;
+            case runtime::Bytecode::return_:
+                branchTo(controls.size() - 1, instr);
+                dead = true;
+                break;
+            case runtime::Bytecode::br_if:
+                --height;
+                if (fuse && endsWith(instrs, fence, handlers, {runtime::Bytecode::local_get,
+                                                               runtime::Bytecode::local_get,
+                                                               runtime::Bytecode::i32_lt_s})) {
+                    // loop back edge compare on two locals, the branch target goes into a data slot
+                    Instr fused{.handler = handlers[runtime::InternalBytecode::br_if_i32_lt_s_locals],
+                                .imm = {.locals = {.lhs = static_cast<u32>(instrs.end()[-3].imm.i),
+                                                   .rhs = static_cast<u32>(instrs.end()[-2].imm.i)}}};
+                    instrs.resize(instrs.size() - 3);
+                    instrs.push_back(fused);
+                    Instr target{.handler = nullptr, .imm = {.i = 0}};
+                    branchTo(decoded.imm.i, target);
+                    instrs.push_back(target);
                     continue;
                 }
-                ControlBlock block{.type = static_cast<runtime::Bytecode>(op), .start = (i + 2), .end = 0};
-                map.insert({label_ind, block});
-                control_stack.push(&map.find(label_ind)->second);
+                if (fuse && endsWith(instrs, fence, handlers, {runtime::Bytecode::i32_ne})) {
+                    instrs.pop_back();
+                    instr.handler = handlers[runtime::InternalBytecode::br_if_i32_ne];
+                }
+                branchTo(decoded.imm.i, instr);
                 break;
+            case runtime::Bytecode::br_table: {
+                --height;
+                instrs.push_back(instr);
+                // label operands follow as data slots, default label last
+                for (i64 i = 0; i <= decoded.imm.i; ++i) {
+                    Instr label{.handler = nullptr, .imm = {.i = 0}};
+                    branchTo(util::readULEB128(ptr, end), label);
+                    instrs.push_back(label);
+                }
+                dead = true;
+                continue;
             }
-            case runtime::Bytecode::end:
-            case runtime::Bytecode::else_:{
-                if (control_stack.empty()) {
-                    if (i != size - 1) {
+            case runtime::Bytecode::unreachable:
+                dead = true;
+                break;
+            default: {
+                StackEffect effect = stackEffect(decoded, types);
+                height = height - effect.pops + effect.pushes;
+                max_height = std::max(max_height, height);
+                if (simd && op >= runtime::Bytecode::local_get && op <= runtime::Bytecode::local_tee &&
+                    local_types[decoded.imm.i] == V128) {
+                    instr.handler = handlers[runtime::InternalBytecode::v128_local_get + op - runtime::Bytecode::local_get];
+                }
+                if (simd && op == runtime::Bytecode::select) {
+                    // operand types are not tracked here, so every select carries the upper halves
+                    instr.handler = handlers[runtime::InternalBytecode::select_v128];
+                }
+                if (op == runtime::prefix::simd) {
+                    instr = translateSimd(decoded, handlers);
+                    simd::Shape shape = simd::opInfo(decoded.sub_op).shape;
+                    if (instr.handler && (shape == simd::Shape::Const || shape == simd::Shape::Shuffle)) {
+                        // the upper 8 bytes of the immediate go into a data slot
+                        instrs.push_back(instr);
+                        instrs.push_back({.handler = nullptr, .imm = {.i = static_cast<i64>(decoded.imm_hi)}});
                         continue;
                     }
-                } else {
-                    auto block = control_stack.top();
-                    block->end = i;
-                    control_stack.pop();
                 }
+                if (op == runtime::prefix::atomic) {
+                    instr = translateAtomic(decoded, handlers);
+                }
+                if (op == runtime::prefix::misc) {
+                    // the sub-opcode picks the handler here, so there is no second dispatch at run time
+                    bool bulk = decoded.sub_op >= runtime::misc::memory_init && decoded.sub_op <= runtime::misc::memory_fill;
+                    instr.handler = bulk ? handlers[runtime::InternalBytecode::memory_init + decoded.sub_op - runtime::misc::memory_init]
+                                         : nullptr;
+                }
+                if (fuse && op == runtime::Bytecode::i32_add &&
+                    endsWith(instrs, fence, handlers, {runtime::Bytecode::local_get, runtime::Bytecode::i32_const})) {
+                    instr.handler = handlers[runtime::InternalBytecode::i32_add_local_const];
+                    instr.imm.local_const = {.local = static_cast<u32>(instrs.end()[-2].imm.i),
+                                             .value = static_cast<i32>(instrs.end()[-1].imm.i)};
+                    instrs.resize(instrs.size() - 2);
+                }
+                break;
             }
         }
+
+        if (!instr.handler) {
+            instr.handler = handlers[runtime::InternalBytecode::unsupported];
+            instr.imm.i = op;
+        }
+        instrs.push_back(instr);
     }
-    return map;
+    // one more slot for the stale value below the cached top of stack
+    frame_size = local_types.size() + max_height + 1;
+    return instrs;
 }
 
-std::vector<RuntimeFunction> initRuntimeFunctions(module::WasmModule &module) {
+std::vector<RuntimeFunction> initRuntimeFunctions(module::WasmModule &module, const RuntimeOptions &options, HandlerTable handlers) {
     std::vector<RuntimeFunction> funcs;
     readImportFuncs(module, std::back_inserter(funcs));
-    readWasmFunction(module, std::back_inserter(funcs));
+    if (!options.lazy) {
+        readWasmFunctions(module, options, handlers, std::back_inserter(funcs));
+        return funcs;
+    }
+    for (auto &func : module.functionSection) {
+        RuntimeFunction pending;
+        pending.signature = module.typesSection.at(func.ind);
+        pending.pending = true;
+        funcs.push_back(std::move(pending));
+    }
     return funcs;
 }
 
-GlobalsContainer initGlobals(module::WasmModule &module) {
+std::vector<RuntimeFunction> initImportFuncs(module::WasmModule &module) {
+    std::vector<RuntimeFunction> funcs;
+    readImportFuncs(module, std::back_inserter(funcs));
+    return funcs;
+}
+
+GlobalsContainer initGlobals(const module::WasmModule &module) {
     GlobalsContainer globals;
     for (auto &g : module.globalSection) {
         GlobalVar globalVar;
@@ -195,19 +603,42 @@ GlobalsContainer initGlobals(module::WasmModule &module) {
     return globals;
 }
 
-MemsContainer initMemory(module::WasmModule &module) {
+MemsContainer initMemory(const module::WasmModule &module) {
     MemsContainer mems;
     for (auto lim : module.memorySection) {
-        mems.emplace_back(lim.min * WASM_PAGE_SIZE);
+        mems.emplace_back(lim.min, lim.hasMax ? lim.max : LinearMemory::MAX_PAGES, lim.shared);
     }
     return mems;
 }
 
-void initData(module::WasmModule &module, MemsContainer &mems) {
+void initData(const module::WasmModule &module, MemsContainer &mems) {
+    if (module.dataSection.empty()) {
+        return;
+    }
+    // large segments are mapped from the module file rather than copied
+    struct ModuleFile {
+        int fd;
+        ~ModuleFile() { if (fd >= 0) close(fd); }
+    } file{module.path.empty() ? -1 : open(module.path.c_str(), O_RDONLY | O_CLOEXEC)};
+
     for (auto &d : module.dataSection) {
+        if (d.passive) {
+            continue;
+        }
         u32 ind = d.memIndex;
         u32 off = util::readLEB128(d.offsetExpr.data() + 1);
-        std::memcpy(mems.at(ind).data() + off, d.data.data(), d.data.size());
+        if (u64{off} + d.data.size() > mems.at(ind).size()) {
+            throw std::runtime_error("data segment does not fit into memory");
+        }
+        mems.at(ind).writeSegment(off, d.data.data(), d.data.size(), file.fd, d.fileOffset);
+    }
+}
+
+DataContainer initDataSegments(const module::WasmModule &module) {
+    DataContainer data;
+    for (auto &d : module.dataSection) {
+        data.emplace_back(d.passive ? std::span<const u8>(d.data) : std::span<const u8>());
     }
+    return data;
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "runtime/instance_pool.hpp"
+
+namespace omega::wass {
+
+InstancePool::InstancePool(std::shared_ptr<CompiledModule> compiled, size_t warm,
+                           std::shared_ptr<const Snapshot> snapshot)
+    : compiled_(std::move(compiled)), snapshot_(std::move(snapshot)), warm_(warm) {
+    idle_.reserve(warm_);
+    for (size_t i = 0; i < warm_; ++i) {
+        idle_.push_back(instantiate());
+    }
+}
+
+std::unique_ptr<Interpreter> InstancePool::acquire() {
+    {
+        std::lock_guard lock(lock_);
+        if (!idle_.empty()) {
+            std::unique_ptr<Interpreter> instance = std::move(idle_.back());
+            idle_.pop_back();
+            return instance;
+        }
+    }
+    return instantiate();
+}
+
+void InstancePool::release(std::unique_ptr<Interpreter> instance) {
+    {
+        std::lock_guard lock(lock_);
+        if (idle_.size() >= warm_) {
+            return;
+        }
+    }
+    // outside the lock, other requests go on meanwhile
+    instance->reset();
+    std::lock_guard lock(lock_);
+    if (idle_.size() < warm_) {
+        idle_.push_back(std::move(instance));
+    }
+}
+
+size_t InstancePool::idle() const {
+    std::lock_guard lock(lock_);
+    return idle_.size();
+}
+
+std::unique_ptr<Interpreter> InstancePool::instantiate() const {
+    auto instance = std::make_unique<Interpreter>();
+    instance->init(compiled_, snapshot_);
+    return instance;
+}
+
+}
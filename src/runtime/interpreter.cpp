@@ -1,8 +1,15 @@
 #include "runtime/interpreter.hpp"
 #include "runtime/init.hpp"
+#include "runtime/simd.hpp"
+#include "runtime/atomics.hpp"
+#include "runtime/module_cache.hpp"
 #include <iostream>
 #include "util/util.hpp"
 #include <array>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <sys/resource.h>
 
 using namespace omega::wass;
 
@@ -22,6 +29,20 @@ i64 callNativeImp(NativeFuncType fn, std::vector<T>& args)
 
 static constexpr std::size_t MAX_NATIVE_ARGS = 10;
 
+// Linear memory accesses may be unaligned, memcpy still compiles to a single load or store
+template <typename T>
+static T loadMemory(const u8 *addr) {
+    T value;
+    std::memcpy(&value, addr, sizeof(T));
+    return value;
+}
+
+template <typename T, typename V>
+static void storeMemory(u8 *addr, V value) {
+    T narrowed = static_cast<T>(value);
+    std::memcpy(addr, &narrowed, sizeof(T));
+}
+
 template <std::size_t... Ns>
 constexpr auto make_callers(std::index_sequence<Ns...>) {
     using Fn = i64(*)(NativeFuncType, std::vector<void*>&);
@@ -39,68 +60,392 @@ static constexpr auto callers =
 
 namespace omega::wass {
 
-void Interpreter::init(module::WasmModule &module) {
-    store_.init(module);
-    u32 start_ind = findStartFuncInd(module);
-    createFrame(start_ind);
+namespace {
+thread_local Interpreter *running_interpreter = nullptr;
+}
+
+Interpreter::~Interpreter() {
+    if (!worker_) {
+        // workers use the store and compiled code of this interpreter until they end
+        threads_->joinAll();
+    }
+}
+
+std::shared_ptr<CompiledModule> Interpreter::compile(module::WasmModule module, const RuntimeOptions &options) {
+    // the dispatch tables are static, any interpreter hands them out
+    Interpreter exporter;
+    exporter.stackCode(true);
+    exporter.registerCode(true);
+    return std::make_shared<CompiledModule>(std::move(module), options, exporter.handlers_, exporter.reg_handlers_);
+}
+
+std::shared_ptr<CompiledModule> Interpreter::compile(std::string_view path, const RuntimeOptions &options) {
+    Interpreter exporter;
+    exporter.stackCode(true);
+    exporter.registerCode(true);
+    return loadCompiledModule(path, options, exporter.handlers_, exporter.reg_handlers_);
+}
+
+void Interpreter::init(std::shared_ptr<CompiledModule> compiled, std::shared_ptr<const Snapshot> snapshot) {
+    options_ = compiled->options();
+    frames_.clear();
+    frames_.reserve(MAX_CALL_DEPTH);
+    stackCode(true);
+    registerCode(true);
+    start_ind_ = compiled->startFunc();
+    jit_ = compiled->jit();
+    store_->init(std::move(compiled), std::move(snapshot));
+    memory_ = store_->memoryBase(0);
+    linear_memory_ = store_->memory(0);
+    if (jit_) {
+        jit_runtime_ = {this, &Interpreter::callFromJit, jit_->entries(), value_stack_.end(), nullptr, memory_,
+                        &Interpreter::memoryGrowFromJit, &Interpreter::bulkMemoryFromJit, 0,
+                        &Interpreter::trapFromJit};
+    }
+    enterStart();
+}
+
+void Interpreter::reset() {
+    threads_->joinAll();
+    // memories keep their reservations, so memory_ and the compiled code runtime stay valid
+    store_->reset();
+    frames_.clear();
+    top_frame_ = nullptr;
+    value_stack_.clear();
+    entry_depth_ = 1;
+    enterStart();
+}
+
+void Interpreter::initialize(u32 f_ind) {
+    RuntimeFunction &f = store_->getFunc(f_ind);
+    if (f.isNative || !f.signature.params.empty()) {
+        throw std::runtime_error("initialization function must not take arguments");
+    }
+    // the start frame set up by init gives way to f_ind and is set up again afterwards,
+    // results of f_ind are dropped
+    u32 start_ind = std::exchange(start_ind_, f_ind);
+    frames_.clear();
+    top_frame_ = nullptr;
+    value_stack_.clear();
+    enterStart();
+    try {
+        start();
+    } catch (...) {
+        // reset makes the instance usable again
+        start_ind_ = start_ind;
+        throw;
+    }
+    start_ind_ = start_ind;
+    frames_.clear();
+    top_frame_ = nullptr;
+    value_stack_.clear();
+    entry_depth_ = 1;
+    enterStart();
+}
+
+std::shared_ptr<const Snapshot> Interpreter::snapshot(const std::string &path, u64 key) const {
+    return store_->snapshot(path, key);
+}
+
+void Interpreter::enterStart() {
+    if (options_.tier == ExecTier::Register) {
+        createRegisterFrame(start_ind_, value_stack_.sp());
+    } else if (!loadShared(store_->getFunc(start_ind_).jitCode)) {
+        createFrame(start_ind_);
+    }
+}
+
+Frame &Interpreter::pushFrame(RuntimeFunction *f, WasmVal *base) {
+    if (frames_.size() == MAX_CALL_DEPTH) {
+        throw std::runtime_error("call stack exhausted");
+    }
+    value_stack_.ensure(base, f->frameSize);
+    frames_.push_back({f, f->code.data(), f->regCode.data(), base, 0});
+    top_frame_ = &frames_.back();
+    return *top_frame_;
 }
 
 void Interpreter::createFrame(u32 f_ind) {
-    auto f_ptr = &store_.getFunc(f_ind);
-    frame_stack_.push({});
-
-    top_frame_ = &frame_stack_.top();
-    top_frame_->func = f_ptr;
-    top_frame_->code = f_ptr->code;
-    top_frame_->labels = &f_ptr->labelMap;
-    top_frame_->locals =  f_ptr->locals;
-}
-
-i64 Interpreter::readLEB128() {
-    int64_t result = 0;
-    unsigned shift = 0;
-    uint8_t byte = 0;
-
-    for (unsigned i = 0; i < util::MAX_LEB128_BYTES; i++) {
-        byte = top_frame_->code[top_frame_->ip++];
-        result |= int64_t(byte & 0x7F) << shift;
-        shift += 7;
-        if ((byte & 0x80) == 0) {
-            // Last byte—perform sign extension if needed
-            if ((byte & 0x40) && shift < 64) {
-                result |= - (int64_t(1) << shift);
-            }
-            return result;
-        }
+    auto f_ptr = &store_->readyFunc(f_ind);
+    size_t params = f_ptr->signature.params.size();
+
+    // arguments already on the value stack become the first locals
+    WasmVal *base = value_stack_.sp() - params;
+    pushFrame(f_ptr, base);
+    std::fill(base + params, base + f_ptr->localsCount, WasmVal{.i = 0});
+    if (f_ptr->simd) {
+        ptrdiff_t upper = value_stack_.upperOffset();
+        std::fill(base + upper + params, base + upper + f_ptr->localsCount, WasmVal{.i = 0});
+    }
+    value_stack_.setSp(base + f_ptr->localsCount);
+}
+
+void Interpreter::createRegisterFrame(u32 f_ind, WasmVal *args) {
+    auto f_ptr = &store_->readyFunc(f_ind);
+    size_t params = f_ptr->signature.params.size();
+
+    // the callee register file starts at the caller's argument registers
+    pushFrame(f_ptr, args);
+    std::fill(args + params, args + f_ptr->localsCount, WasmVal{.i = 0});
+}
+
+void Interpreter::initThread(const Interpreter &parent) {
+    options_ = parent.options_;
+    frames_.reserve(MAX_CALL_DEPTH);
+    handlers_ = parent.handlers_;
+    reg_handlers_ = parent.reg_handlers_;
+    memory_ = parent.memory_;
+    linear_memory_ = parent.linear_memory_;
+    worker_ = true;
+    store_ = parent.store_;
+    threads_ = parent.threads_;
+    jit_ = parent.jit_;
+    if (jit_) {
+        jit_runtime_ = {this, &Interpreter::callFromJit, jit_->entries(), value_stack_.end(), nullptr, memory_,
+                        &Interpreter::memoryGrowFromJit, &Interpreter::bulkMemoryFromJit, 0,
+                        &Interpreter::trapFromJit};
     }
-    throw std::overflow_error("SLEB128 exceeds maximum length for int64_t");
 }
 
 void Interpreter::start() {
-    threadedCode();
+    running_interpreter = this;
+    // out of bounds accesses fault on the guard region of the linear memory and trap here
+    runTrapping([this] { run(); });
+    if (!worker_) {
+        threads_->joinAll();
+    }
+}
+
+Interpreter *Interpreter::running() {
+    return running_interpreter;
+}
+
+u32 Interpreter::spawnThread(u32 f_ind, const std::vector<WasmVal> &args) {
+    u32 id = threads_->newId();
+    runOnThread(f_ind, args);
+    return id;
+}
+
+void Interpreter::runOnThread(u32 f_ind, const std::vector<WasmVal> &args) {
+    if (!linear_memory_ || !linear_memory_->shared()) {
+        throw std::runtime_error("threads need a shared linear memory");
+    }
+    RuntimeFunction &f = store_->getFunc(f_ind);
+    if (f.isNative || f.signature.params.size() != args.size()) {
+        throw std::runtime_error("thread entry does not take the given arguments");
+    }
+    // set up here, so nothing but the run itself happens on the new thread
+    auto worker = std::make_unique<Interpreter>();
+    worker->initThread(*this);
+    worker->start_ind_ = f_ind;
+    for (WasmVal arg : args) {
+        worker->value_stack_.push(arg);
+    }
+    if (options_.tier == ExecTier::Register) {
+        worker->createRegisterFrame(f_ind, worker->value_stack_.sp() - args.size());
+    } else if (!loadShared(f.jitCode)) {
+        worker->createFrame(f_ind);
+    }
+    threads_->add(std::thread([worker = std::move(worker)] { worker->start(); }));
+}
+
+i32 Interpreter::spawnWasiThread(i32 start_arg) {
+    u32 thread_start = store_->compiled().threadStartFunc();
+    if (thread_start == CompiledModule::NO_FUNC) {
+        throw std::runtime_error("thread-spawn without an exported wasi_thread_start");
+    }
+    u32 id = threads_->newId();
+    runOnThread(thread_start, {WasmVal{.i = static_cast<i32>(id)}, WasmVal{.i = start_arg}});
+    return static_cast<i32>(id);
+}
+
+void Interpreter::run() {
+    if (options_.tier == ExecTier::Register) {
+        registerCode();
+        return;
+    }
+    if (jit_) {
+        // compiled code checks the native stack itself instead of counting frames
+        rlimit limit{};
+        size_t stack_size = 8 << 20;
+        if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+            stack_size = limit.rlim_cur;
+        }
+        char marker;
+        jit_runtime_.native_stack_limit = &marker - (stack_size - std::min(stack_size, NATIVE_STACK_RESERVE * 2));
+        // a trap leaves without unwinding the compiled frames it counted
+        jit_runtime_.call_depth = 0;
+    }
+    RuntimeFunction &f = store_->getFunc(start_ind_);
+    if (JitFunc code = loadShared(f.jitCode)) {
+        code(value_stack_.sp() - f.signature.params.size(), &jit_runtime_);
+    } else {
+        stackCode();
+    }
+}
+
+void Interpreter::stackCode(bool export_handlers) {
+#ifdef OWASM_TAIL_CALL_DISPATCH
+    tailCallCode(export_handlers);
+#else
+    threadedCode(export_handlers);
+#endif
 }
 
 void Interpreter::popFrame() {
-    frame_stack_.pop();
-    top_frame_ = &frame_stack_.top();
+    frames_.pop_back();
+    top_frame_ = frames_.empty() ? nullptr : &frames_.back();
 }
 
+void Interpreter::popRegisterFrame(u32 results_reg) {
+    u32 results = top_frame_->func->signature.results.size();
+    WasmVal *base = top_frame_->locals;
+    std::copy_n(base + results_reg, results, base);
+    popFrame();
+}
 
 void Interpreter::callFunc(u32 f_ind) {
-    RuntimeFunction &f = store_.getFunc(f_ind);
+    RuntimeFunction &f = store_->getFunc(f_ind);
     if (f.isNative) {
         callNative(f);
+    } else if (loadShared(f.jitCode) || tierUp(f_ind)) {
+        WasmVal *args = value_stack_.sp() - f.signature.params.size();
+        f.jitCode(args, &jit_runtime_);
+        value_stack_.setSp(args + f.signature.results.size());
     } else {
         createFrame(f_ind);
     }
 }
 
+void Interpreter::callFromJit(JitRuntime *rt, u32 f_ind, WasmVal *args) {
+    // errors cannot unwind through the compiled caller, they leave through trap
+    std::exception_ptr error;
+    try {
+        static_cast<Interpreter *>(rt->owner)->callForJit(f_ind, args);
+        return;
+    } catch (...) {
+        error = std::current_exception();
+    }
+    trap(std::move(error));
+}
+
+void Interpreter::callForJit(u32 f_ind, WasmVal *args) {
+    RuntimeFunction &f = store_->getFunc(f_ind);
+    if (f.isNative) {
+        WasmVal ret = invokeNative(f, args);
+        if (!f.signature.results.empty()) {
+            args[0] = ret;
+        }
+        return;
+    }
+    if (loadShared(f.jitCode) || tierUp(f_ind)) {
+        f.jitCode(args, &jit_runtime_);
+        return;
+    }
+    // run the callee in a nested stack tier loop that returns at its function end
+    value_stack_.setSp(args + f.signature.params.size());
+    createFrame(f_ind);
+    size_t entry_depth = entry_depth_;
+    entry_depth_ = frames_.size();
+    stackCode();
+    entry_depth_ = entry_depth;
+
+    u32 results = f.signature.results.size();
+    std::copy_n(value_stack_.sp() - results, results, args);
+    value_stack_.setSp(args + results);
+    popFrame();
+}
+
+i32 Interpreter::memoryGrowFromJit(JitRuntime *rt, u32 delta) {
+    // the base does not move, so compiled code keeps using rt->memory
+    return static_cast<Interpreter *>(rt->owner)->linear_memory_->grow(delta);
+}
+
+void Interpreter::bulkMemoryFromJit(JitRuntime *rt, u32 op, u32 data_ind, WasmVal *args) {
+    auto *vm = static_cast<Interpreter *>(rt->owner);
+    // traps leave through trapOutOfBounds, compiled frames cannot be unwound
+    switch (op) {
+        case runtime::misc::memory_init:
+            vm->linear_memory_->init(static_cast<u32>(args[0].i), vm->store_->dataSegment(data_ind),
+                                     static_cast<u32>(args[1].i), static_cast<u32>(args[2].i));
+            break;
+        case runtime::misc::data_drop:
+            vm->store_->dropData(data_ind);
+            break;
+        case runtime::misc::memory_copy:
+            vm->linear_memory_->copy(static_cast<u32>(args[0].i), static_cast<u32>(args[1].i),
+                                     static_cast<u32>(args[2].i));
+            break;
+        case runtime::misc::memory_fill:
+            vm->linear_memory_->fill(static_cast<u32>(args[0].i), static_cast<u8>(args[1].i),
+                                     static_cast<u32>(args[2].i));
+            break;
+        default:
+            break;
+    }
+}
+
+void Interpreter::trapFromJit(JitRuntime *, const char *message) {
+    trap(std::make_exception_ptr(std::runtime_error(message)));
+}
+
+bool Interpreter::tierUp(u32 f_ind) {
+    RuntimeFunction &f = store_->getFunc(f_ind);
+    if (!options_.tier_up || loadShared(f.jitRejected) || countHot(f.hotness) < options_.call_threshold) {
+        return false;
+    }
+    // the compiler takes locals and v128 use from the translation
+    store_->readyFunc(f_ind);
+    return jit_->compileFunction(f_ind);
+}
+
+bool Interpreter::osrEnter(u32 loop) {
+    Frame &frame = *top_frame_;
+    RuntimeFunction &f = *frame.func;
+    // a loop that cannot move stays interpreted and counts from zero again
+    publish(f.loopHotness[loop], 0u);
+    if (!loadShared(f.jitCode) && !jit_->compileFunction(store_->funcIndex(f))) {
+        return false;
+    }
+    JitFunc entry = f.osrEntries[loop];
+    if (!entry) {
+        return false;
+    }
+    // compiled code keeps operands right after the locals, without the stale slot of the stack tier
+    WasmVal *operands = frame.locals + f.localsCount;
+    std::copy(operands + 1, value_stack_.sp(), operands);
+    entry(frame.locals, &jit_runtime_);
+    value_stack_.setSp(frame.locals + f.signature.results.size());
+    return true;
+}
+
+void Interpreter::callRegisterFunc(u32 f_ind, WasmVal *args) {
+    RuntimeFunction &f = store_->getFunc(f_ind);
+    if (f.isNative) {
+        WasmVal ret = invokeNative(f, args);
+        if (!f.signature.results.empty()) {
+            args[0] = ret;
+        }
+    } else {
+        createRegisterFrame(f_ind, args);
+    }
+}
+
 void Interpreter::callNative(RuntimeFunction &f) {
+    WasmVal *args = value_stack_.sp() - f.signature.params.size();
+    WasmVal ret = invokeNative(f, args);
+
+    value_stack_.setSp(args);
+    if (!f.signature.results.empty()) {
+        value_stack_.push(ret);
+    }
+}
+
+WasmVal Interpreter::invokeNative(RuntimeFunction &f, const WasmVal *args) {
     auto &sig = f.signature;
     size_t p_count = sig.params.size();
-    std::vector<void*> args(p_count);
-    Operand ret(REF, 0L);
-
+    std::vector<void*> native_args(p_count);
+    WasmVal ret{.i = 0};
 
     if (p_count > MAX_NATIVE_ARGS)
         throw std::runtime_error("unsupported native arg count");
@@ -110,43 +455,66 @@ void Interpreter::callNative(RuntimeFunction &f) {
         if (!caller)
             throw std::runtime_error("no caller for this arg count");
 
-        for (i64 i = p_count - 1; i >= 0; --i) {
-            auto op = operand_stack_.top();
-            operand_stack_.pop();
-
+        for (size_t i = 0; i < p_count; ++i) {
             if (sig.params[i] == REF) {
-                args[i] = store_.getMem(0, op.val.i);
+                native_args[i] = store_->getMem(0, args[i].i);
             } else {
-                args[i] = reinterpret_cast<void *>(op.val.i);
+                native_args[i] = reinterpret_cast<void *>(args[i].i);
             }
         }
-        ret.val.i = caller(f.native_ptr, args);
+        ret.i = caller(f.native_ptr, native_args);
     } else {
-        ret.val.i = f.native_ptr();
+        ret.i = f.native_ptr();
     }
 
-
-    if (!sig.results.empty()) {
-        ret.type = sig.results[0];
-        operand_stack_.push(ret);
-    }
+    return ret;
 }
 
 
 #define UNIMPLEMENTED(op)                                            \
     std::cerr << "Unimplemented opcode: " << (op)                    \
-              << " at IP=" << top_frame_->ip - 1                     \
+              << " at IP=" << CURRENT_IP()                           \
               << std::endl;                                          \
     std::abort()                                                     \
 
-#define DISPATCH() goto *dispatch_table[top_frame_->code[top_frame_->ip++]]
-
-void Interpreter::threadedCode() {
+// The stack tier keeps ip, sp, the locals base and the top of stack value in locals of
+// threadedCode, so they can live in machine registers. Below the cached top of stack the
+// operand area holds one stale slot, which is why frames reserve an extra slot.
+// State is written back to the frame and the value stack only around calls.
+#define CURRENT_IP() (ip - code - 1)
+#define DISPATCH() goto *(instr = ip++)->handler
+#define SPILL_TOS() (*sp++ = tos)
+#define FILL_TOS() (tos = *--sp)
+// A v128 value keeps its low half where a scalar would be, in tos on top of the stack, and its
+// upper half in the shadow slot of that position, which the top of stack cache never moves.
+#define UPPER(p) ((p) + upper)
+#define V128_AT(p) simd::join((p)->i, UPPER(p)->i)
+#define TOS_V128() simd::join(tos.i, UPPER(sp)->i)
+#define SET_TOS_V128(v) (vec = (v), tos.i = simd::low(vec), UPPER(sp)->i = simd::high(vec))
+#define SYNC_FRAME()                                                 \
+    top_frame_->ip = ip - code;                                      \
+    value_stack_.setSp(sp)
+#define LOAD_FRAME()                                                 \
+    code = top_frame_->code;                                         \
+    ip = code + top_frame_->ip;                                      \
+    locals = top_frame_->locals;                                     \
+    sp = value_stack_.sp()
+
+void Interpreter::threadedCode(bool export_handlers) {
+    const Instr *instr;
+    const Instr *code;
+    const Instr *ip;
+    WasmVal *locals;
+    WasmVal *sp;
+    WasmVal tos{.i = 0};
+    Frame *caller;
     i64 arg_int = 0;
-    f64 arg_f   = 0;
-    Operand op1, op2, op3;
-    ControlBlock curr_block;
-    Operand *cur_local;
+    WasmVal op1;
+    u8 *memory = memory_;   // memory 0, addresses need no bounds checks
+    u8 *address;
+    const ptrdiff_t upper = value_stack_.upperOffset();
+    const simd::Kernel *kernels = simd::kernels();
+    simd::V128 vec;
 //    runtime::Bytecode instr = static_cast<runtime::Bytecode>(top_frame_->code[top_frame_->ip++]);
     // Direct-threading dispatch table
     static void* dispatch_table[] = {
@@ -327,8 +695,52 @@ void Interpreter::threadedCode() {
             [runtime::Bytecode::i64_reinterpret_f64] = &&i64_reinterpret_f64,
             [runtime::Bytecode::f32_reinterpret_i32] = &&f32_reinterpret_i32,
             [runtime::Bytecode::f64_reinterpret_i64] = &&f64_reinterpret_i64,
+            [runtime::InternalBytecode::unsupported] = &&unsupported,
+            [runtime::InternalBytecode::i32_add_local_const] = &&i32_add_local_const,
+            [runtime::InternalBytecode::br_if_i32_ne] = &&br_if_i32_ne,
+            [runtime::InternalBytecode::br_if_i32_lt_s_locals] = &&br_if_i32_lt_s_locals,
+            [runtime::InternalBytecode::loop_header] = &&loop_header,
+            [runtime::InternalBytecode::memory_init] = &&memory_init,
+            [runtime::InternalBytecode::data_drop] = &&data_drop,
+            [runtime::InternalBytecode::memory_copy] = &&memory_copy,
+            [runtime::InternalBytecode::memory_fill] = &&memory_fill,
+            [runtime::InternalBytecode::v128_const] = &&v128_const,
+            [runtime::InternalBytecode::v128_load] = &&v128_load,
+            [runtime::InternalBytecode::v128_load8] = &&v128_load8,
+            [runtime::InternalBytecode::v128_load16] = &&v128_load16,
+            [runtime::InternalBytecode::v128_load32] = &&v128_load32,
+            [runtime::InternalBytecode::v128_load64] = &&v128_load64,
+            [runtime::InternalBytecode::v128_store] = &&v128_store,
+            [runtime::InternalBytecode::v128_load_lane] = &&v128_load_lane,
+            [runtime::InternalBytecode::v128_store_lane] = &&v128_store_lane,
+            [runtime::InternalBytecode::i8x16_shuffle] = &&i8x16_shuffle,
+            [runtime::InternalBytecode::v128_unary] = &&v128_unary,
+            [runtime::InternalBytecode::v128_binary] = &&v128_binary,
+            [runtime::InternalBytecode::v128_ternary] = &&v128_ternary,
+            [runtime::InternalBytecode::v128_test] = &&v128_test,
+            [runtime::InternalBytecode::v128_shift] = &&v128_shift,
+            [runtime::InternalBytecode::v128_splat] = &&v128_splat,
+            [runtime::InternalBytecode::v128_extract_lane] = &&v128_extract_lane,
+            [runtime::InternalBytecode::v128_replace_lane] = &&v128_replace_lane,
+            [runtime::InternalBytecode::v128_local_get] = &&v128_local_get,
+            [runtime::InternalBytecode::v128_local_set] = &&v128_local_set,
+            [runtime::InternalBytecode::v128_local_tee] = &&v128_local_tee,
+            [runtime::InternalBytecode::select_v128] = &&select_v128,
+            [runtime::InternalBytecode::atomic_load] = &&atomic_load,
+            [runtime::InternalBytecode::atomic_store] = &&atomic_store,
+            [runtime::InternalBytecode::atomic_rmw] = &&atomic_rmw,
+            [runtime::InternalBytecode::atomic_cmpxchg] = &&atomic_cmpxchg,
+            [runtime::InternalBytecode::memory_atomic_wait] = &&memory_atomic_wait,
+            [runtime::InternalBytecode::memory_atomic_notify] = &&memory_atomic_notify,
+            [runtime::InternalBytecode::atomic_fence] = &&atomic_fence,
     };
 
+    if (export_handlers) {
+        handlers_ = dispatch_table;
+        return;
+    }
+
+    LOAD_FRAME();
     DISPATCH();
 
 unreachable:
@@ -338,65 +750,83 @@ nop:
     DISPATCH();
 
 block:
-    top_frame_->pushLabel();
-    ++top_frame_->ip;
     DISPATCH();
 
 loop:
-    top_frame_->pushLabel();
-    ++top_frame_->ip;
     DISPATCH();
 
 if_:
-    UNIMPLEMENTED("if_");
+    arg_int = tos.i;
+    FILL_TOS();
+
+    if (!arg_int) {
+        ip = code + instr->imm.br.ip;
+    }
+    DISPATCH();
 
 else_:
-    UNIMPLEMENTED("else_");
+    ip = code + instr->imm.br.ip;
+    DISPATCH();
 
 end:
-    if (top_frame_->control_stack.empty()) {
-        if (frame_stack_.size() == 1) {
-            return;
-        }
-        popFrame();
-    } else {
-        top_frame_->control_stack.pop_back();
+    // only the function end is left in the pre-decoded code: move the results down to the frame base
+    SPILL_TOS();
+frame_exit:
+    if (frames_.size() == entry_depth_) {
+        SYNC_FRAME();
+        return;
     }
+    arg_int = top_frame_->func->signature.results.size();
+    std::copy_n(sp - arg_int, arg_int, locals);
+    if (top_frame_->func->simd) {
+        std::copy_n(UPPER(sp) - arg_int, arg_int, UPPER(locals));
+    }
+    value_stack_.setSp(locals + arg_int);
+    popFrame();
+    LOAD_FRAME();
+    FILL_TOS();
     DISPATCH();
 
 br:
-    arg_int = readLEB128();
-    top_frame_->popBlocks(arg_int);
-
-    curr_block = top_frame_->control_stack.back();
-
-    if (curr_block.type == runtime::loop) {
-        top_frame_->ip = curr_block.start;
-    } else {
-        top_frame_->ip = curr_block.end;
+    if (instr->imm.br.drop) {
+        SPILL_TOS();
+        std::copy(sp - instr->imm.br.keep, sp, sp - instr->imm.br.keep - instr->imm.br.drop);
+        std::copy(UPPER(sp) - instr->imm.br.keep, UPPER(sp), UPPER(sp) - instr->imm.br.keep - instr->imm.br.drop);
+        sp -= instr->imm.br.drop;
+        FILL_TOS();
     }
+    ip = code + instr->imm.br.ip;
     DISPATCH();
 
 br_if:
-    op1 = operand_stack_.top();
-    operand_stack_.pop();
+    arg_int = tos.i;
+    FILL_TOS();
 
-    if (op1.val.i) {
+    if (arg_int) {
         goto br;
     }
-    arg_int = readLEB128();
     DISPATCH();
 
 br_table:
-    UNIMPLEMENTED("br_table");
+    // label slots follow the instruction, an out of range index takes the default label
+    arg_int = static_cast<u32>(tos.i);
+    FILL_TOS();
+    instr = ip + std::min(arg_int, instr->imm.i);
+    goto br;
 
 return_:
-    top_frame_->ret();
-    DISPATCH();
+    goto br;
 
 call:
-    arg_int = readLEB128();
-    callFunc(arg_int);
+    // a Wasm callee gets a new frame, a host function returns into the current one
+    SPILL_TOS();
+    SYNC_FRAME();
+    caller = top_frame_;
+    callFunc(instr->imm.i);
+    LOAD_FRAME();
+    if (top_frame_ == caller) {
+        FILL_TOS();
+    }
     DISPATCH();
 
 return_call:
@@ -409,52 +839,30 @@ call_ref:
     UNIMPLEMENTED("call_ref");
 
 drop:
-    operand_stack_.pop();
+    FILL_TOS();
     DISPATCH();
 
 select:
-    op3 = operand_stack_.top();
-    operand_stack_.pop();
-    op2 = operand_stack_.top();
-    operand_stack_.pop();
-    op1 = operand_stack_.top();
-    operand_stack_.pop();
-    if (op3.val.i) {
-        operand_stack_.push(op1);
-    } else {
-        operand_stack_.push(op2);
-    }
+    arg_int = tos.i;
+    sp -= 2;
+    tos = arg_int ? sp[0] : sp[1];
     DISPATCH();
 
 select_t:
     UNIMPLEMENTED("select_t");
 
 local_get:
-    arg_int = readLEB128();
-    operand_stack_.push(top_frame_->locals[arg_int]);
+    SPILL_TOS();
+    tos = locals[instr->imm.i];
     DISPATCH();
 
 local_set:
-    arg_int = readLEB128();
-    op1 = operand_stack_.top();
-    operand_stack_.pop();
-    cur_local = &top_frame_->locals[arg_int];
-    if (cur_local->type > ValType::F64) {
-        cur_local->val.i = op1.val.i;
-    } else {
-        UNIMPLEMENTED("local_set with float type");
-    }
+    locals[instr->imm.i] = tos;
+    FILL_TOS();
     DISPATCH();
 
 local_tee:
-    arg_int = readLEB128();
-    op1 = operand_stack_.top();
-    cur_local = &top_frame_->locals[arg_int];
-    if (cur_local->type > ValType::F64) {
-        cur_local->val.i = op1.val.i;
-    } else {
-        UNIMPLEMENTED("local_set with float type");
-    }
+    locals[instr->imm.i] = tos;
     DISPATCH();
 
 global_get:
@@ -470,83 +878,128 @@ table_set:
     UNIMPLEMENTED("table_set");
 
 i32_load:
-    UNIMPLEMENTED("i32_load");
+    tos.i = loadMemory<i32>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 i64_load:
-    UNIMPLEMENTED("i64_load");
+    tos.i = loadMemory<i64>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 f32_load:
-    UNIMPLEMENTED("f32_load");
+    tos.f = loadMemory<f32>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 f64_load:
-    UNIMPLEMENTED("f64_load");
+    tos.f = loadMemory<f64>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 i32_load8_s:
-    UNIMPLEMENTED("i32_load8_s");
+    tos.i = loadMemory<int8_t>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 i32_load8_u:
-    UNIMPLEMENTED("i32_load8_u");
+    tos.i = loadMemory<u8>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 i32_load16_s:
-    UNIMPLEMENTED("i32_load16_s");
+    tos.i = loadMemory<int16_t>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 i32_load16_u:
-    UNIMPLEMENTED("i32_load16_u");
+    tos.i = loadMemory<u16>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 i64_load8_s:
-    UNIMPLEMENTED("i64_load8_s");
+    tos.i = loadMemory<int8_t>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 i64_load8_u:
-    UNIMPLEMENTED("i64_load8_u");
+    tos.i = loadMemory<u8>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 i64_load16_s:
-    UNIMPLEMENTED("i64_load16_s");
+    tos.i = loadMemory<int16_t>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 i64_load16_u:
-    UNIMPLEMENTED("i64_load16_u");
+    tos.i = loadMemory<u16>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 i64_load32_s:
-    UNIMPLEMENTED("i64_load32_s");
+    tos.i = loadMemory<i32>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 i64_load32_u:
-    UNIMPLEMENTED("i64_load32_u");
+    tos.i = loadMemory<u32>(memory + static_cast<u32>(tos.i) + instr->imm.i);
+    DISPATCH();
 
 i32_store:
-    UNIMPLEMENTED("i32_store");
+    op1 = *--sp;
+    storeMemory<i32>(memory + static_cast<u32>(op1.i) + instr->imm.i, tos.i);
+    FILL_TOS();
+    DISPATCH();
 
 i64_store:
-    UNIMPLEMENTED("i64_store");
+    op1 = *--sp;
+    storeMemory<i64>(memory + static_cast<u32>(op1.i) + instr->imm.i, tos.i);
+    FILL_TOS();
+    DISPATCH();
 
 f32_store:
-    UNIMPLEMENTED("f32_store");
+    op1 = *--sp;
+    storeMemory<f32>(memory + static_cast<u32>(op1.i) + instr->imm.i, tos.f);
+    FILL_TOS();
+    DISPATCH();
 
 f64_store:
-    UNIMPLEMENTED("f64_store");
+    op1 = *--sp;
+    storeMemory<f64>(memory + static_cast<u32>(op1.i) + instr->imm.i, tos.f);
+    FILL_TOS();
+    DISPATCH();
 
 i32_store8:
-    UNIMPLEMENTED("i32_store8");
+    op1 = *--sp;
+    storeMemory<u8>(memory + static_cast<u32>(op1.i) + instr->imm.i, tos.i);
+    FILL_TOS();
+    DISPATCH();
 
 i32_store16:
-    UNIMPLEMENTED("i32_store16");
+    op1 = *--sp;
+    storeMemory<u16>(memory + static_cast<u32>(op1.i) + instr->imm.i, tos.i);
+    FILL_TOS();
+    DISPATCH();
 
 i64_store8:
-    UNIMPLEMENTED("i64_store8");
+    op1 = *--sp;
+    storeMemory<u8>(memory + static_cast<u32>(op1.i) + instr->imm.i, tos.i);
+    FILL_TOS();
+    DISPATCH();
 
 i64_store16:
-    UNIMPLEMENTED("i64_store16");
+    op1 = *--sp;
+    storeMemory<u16>(memory + static_cast<u32>(op1.i) + instr->imm.i, tos.i);
+    FILL_TOS();
+    DISPATCH();
 
 i64_store32:
-    UNIMPLEMENTED("i64_store32");
+    op1 = *--sp;
+    storeMemory<u32>(memory + static_cast<u32>(op1.i) + instr->imm.i, tos.i);
+    FILL_TOS();
+    DISPATCH();
 
 memory_size:
-    UNIMPLEMENTED("memory_size");
+    SPILL_TOS();
+    tos.i = linear_memory_->pages();
+    DISPATCH();
 
 memory_grow:
-    UNIMPLEMENTED("memory_grow");
+    // committed in place, the cached memory base stays valid
+    tos.i = linear_memory_->grow(static_cast<u32>(tos.i));
+    DISPATCH();
 
 i32_const:
-    arg_int = readLEB128();
-    operand_stack_.emplace(I32, arg_int);
+    SPILL_TOS();
+    tos.i = instr->imm.i;
     DISPATCH();
 
 i64_const:
@@ -565,16 +1018,14 @@ i32_eq:
     UNIMPLEMENTED("i32_eq");
 
 i32_ne:
-    op1 = operand_stack_.top();
-    operand_stack_.pop();
-    op2 = operand_stack_.top();
-    operand_stack_.pop();
-    arg_int = op1.val.i != op2.val.i;
-    operand_stack_.emplace(I32, arg_int);
+    op1 = *--sp;
+    tos.i = static_cast<i32>(op1.i) != static_cast<i32>(tos.i);
     DISPATCH();
 
 i32_lt_s:
-    UNIMPLEMENTED("i32_lt_s");
+    op1 = *--sp;
+    tos.i = static_cast<i32>(op1.i) < static_cast<i32>(tos.i);
+    DISPATCH();
 
 i32_lt_u:
     UNIMPLEMENTED("i32_lt_u");
@@ -676,21 +1127,13 @@ i32_popcnt:
     UNIMPLEMENTED("i32_popcnt");
 
 i32_add:
-    op1 = operand_stack_.top();
-    operand_stack_.pop();
-    op2 = operand_stack_.top();
-    operand_stack_.pop();
-    arg_int = (op1.val.i + op2.val.i) & 0xFFFFFFFFu;
-    operand_stack_.emplace(I32, arg_int);
+    op1 = *--sp;
+    tos.i = static_cast<i32>(op1.i + tos.i);
     DISPATCH();
 
 i32_sub:
-    op1 = operand_stack_.top();
-    operand_stack_.pop();
-    op2 = operand_stack_.top();
-    operand_stack_.pop();
-    arg_int = (op2.val.i - op1.val.i);
-    operand_stack_.emplace(I32, arg_int);
+    op1 = *--sp;
+    tos.i = static_cast<i32>(op1.i - tos.i);
     DISPATCH();
 
 i32_mul:
@@ -709,12 +1152,8 @@ i32_rem_u:
     UNIMPLEMENTED("i32_rem_u");
 
 i32_and:
-    op1 = operand_stack_.top();
-    operand_stack_.pop();
-    op2 = operand_stack_.top();
-    operand_stack_.pop();
-    arg_int = op1.val.i & op2.val.i;
-    operand_stack_.emplace(I32, arg_int);
+    op1 = *--sp;
+    tos.i &= op1.i;
     DISPATCH();
 
 i32_or:
@@ -950,8 +1389,513 @@ f32_reinterpret_i32:
 
 f64_reinterpret_i64:
     UNIMPLEMENTED("f64_reinterpret_i64");
+
+unsupported:
+    UNIMPLEMENTED(instr->imm.i);
+
+i32_add_local_const:
+    SPILL_TOS();
+    tos.i = static_cast<i32>(locals[instr->imm.local_const.local].i + instr->imm.local_const.value);
+    DISPATCH();
+
+br_if_i32_ne:
+    op1 = *--sp;
+    arg_int = static_cast<i32>(op1.i) != static_cast<i32>(tos.i);
+    FILL_TOS();
+
+    if (arg_int) {
+        goto br;
+    }
+    DISPATCH();
+
+br_if_i32_lt_s_locals:
+    // the branch target is kept in the following slot
+    if (static_cast<i32>(locals[instr->imm.locals.lhs].i) < static_cast<i32>(locals[instr->imm.locals.rhs].i)) {
+        instr = ip;
+        goto br;
+    }
+    ++ip;
+    DISPATCH();
+
+loop_header:
+    // back edges branch here too, so the counter sees every iteration
+    if (countHot(top_frame_->func->loopHotness[instr->imm.i]) < options_.loop_threshold) {
+        DISPATCH();
+    }
+    SPILL_TOS();
+    SYNC_FRAME();
+    if (!osrEnter(instr->imm.i)) {
+        FILL_TOS();
+        DISPATCH();
+    }
+    sp = value_stack_.sp();
+    goto frame_exit;
+
+// bulk memory operands: destination, source or value, then the length in tos
+memory_init:
+    linear_memory_->init(static_cast<u32>(sp[-2].i), store_->dataSegment(instr->imm.i),
+                         static_cast<u32>(sp[-1].i), static_cast<u32>(tos.i));
+    sp -= 2;
+    FILL_TOS();
+    DISPATCH();
+
+data_drop:
+    store_->dropData(instr->imm.i);
+    DISPATCH();
+
+memory_copy:
+    linear_memory_->copy(static_cast<u32>(sp[-2].i), static_cast<u32>(sp[-1].i), static_cast<u32>(tos.i));
+    sp -= 2;
+    FILL_TOS();
+    DISPATCH();
+
+memory_fill:
+    linear_memory_->fill(static_cast<u32>(sp[-2].i), static_cast<u8>(sp[-1].i), static_cast<u32>(tos.i));
+    sp -= 2;
+    FILL_TOS();
+    DISPATCH();
+
+v128_const:
+    SPILL_TOS();
+    tos.i = instr->imm.i;
+    UPPER(sp)->i = (ip++)->imm.i;
+    DISPATCH();
+
+v128_load:
+    address = memory + static_cast<u32>(tos.i) + instr->imm.simd.offset;
+    tos.i = loadMemory<i64>(address);
+    UPPER(sp)->i = loadMemory<i64>(address + 8);
+    DISPATCH();
+
+v128_load8:
+    address = memory + static_cast<u32>(tos.i) + instr->imm.simd.offset;
+    SET_TOS_V128(kernels[instr->imm.simd.kernel].unary(simd::join(loadMemory<u8>(address), 0)));
+    DISPATCH();
+
+v128_load16:
+    address = memory + static_cast<u32>(tos.i) + instr->imm.simd.offset;
+    SET_TOS_V128(kernels[instr->imm.simd.kernel].unary(simd::join(loadMemory<u16>(address), 0)));
+    DISPATCH();
+
+v128_load32:
+    address = memory + static_cast<u32>(tos.i) + instr->imm.simd.offset;
+    SET_TOS_V128(kernels[instr->imm.simd.kernel].unary(simd::join(loadMemory<u32>(address), 0)));
+    DISPATCH();
+
+v128_load64:
+    address = memory + static_cast<u32>(tos.i) + instr->imm.simd.offset;
+    SET_TOS_V128(kernels[instr->imm.simd.kernel].unary(simd::join(loadMemory<i64>(address), 0)));
+    DISPATCH();
+
+v128_store:
+    address = memory + static_cast<u32>(sp[-1].i) + instr->imm.simd.offset;
+    storeMemory<i64>(address, tos.i);
+    storeMemory<i64>(address + 8, UPPER(sp)->i);
+    --sp;
+    FILL_TOS();
+    DISPATCH();
+
+v128_load_lane:
+    vec = TOS_V128();
+    address = memory + static_cast<u32>(sp[-1].i) + instr->imm.simd.offset;
+    std::memcpy(reinterpret_cast<u8 *>(&vec) + instr->imm.simd.lane * instr->imm.simd.size, address,
+                instr->imm.simd.size);
+    --sp;
+    SET_TOS_V128(vec);
+    DISPATCH();
+
+v128_store_lane:
+    vec = TOS_V128();
+    address = memory + static_cast<u32>(sp[-1].i) + instr->imm.simd.offset;
+    std::memcpy(address, reinterpret_cast<u8 *>(&vec) + instr->imm.simd.lane * instr->imm.simd.size,
+                instr->imm.simd.size);
+    --sp;
+    FILL_TOS();
+    DISPATCH();
+
+i8x16_shuffle:
+    vec = kernels[simd::SHUFFLE].ternary(V128_AT(sp - 1), TOS_V128(), simd::join(instr->imm.i, ip->imm.i));
+    ++ip;
+    --sp;
+    SET_TOS_V128(vec);
+    DISPATCH();
+
+v128_unary:
+    SET_TOS_V128(kernels[instr->imm.simd.kernel].unary(TOS_V128()));
+    DISPATCH();
+
+v128_binary:
+    vec = kernels[instr->imm.simd.kernel].binary(V128_AT(sp - 1), TOS_V128());
+    --sp;
+    SET_TOS_V128(vec);
+    DISPATCH();
+
+v128_ternary:
+    vec = kernels[instr->imm.simd.kernel].ternary(V128_AT(sp - 2), V128_AT(sp - 1), TOS_V128());
+    sp -= 2;
+    SET_TOS_V128(vec);
+    DISPATCH();
+
+v128_test:
+    tos.i = kernels[instr->imm.simd.kernel].test(TOS_V128());
+    DISPATCH();
+
+v128_shift:
+    vec = kernels[instr->imm.simd.kernel].shift(V128_AT(sp - 1), static_cast<u32>(tos.i));
+    --sp;
+    SET_TOS_V128(vec);
+    DISPATCH();
+
+v128_splat:
+    SET_TOS_V128(kernels[instr->imm.simd.kernel].splat(tos));
+    DISPATCH();
+
+v128_extract_lane:
+    tos = kernels[instr->imm.simd.kernel].extract(TOS_V128(), instr->imm.simd.lane);
+    DISPATCH();
+
+v128_replace_lane:
+    vec = kernels[instr->imm.simd.kernel].replace(V128_AT(sp - 1), tos, instr->imm.simd.lane);
+    --sp;
+    SET_TOS_V128(vec);
+    DISPATCH();
+
+v128_local_get:
+    SPILL_TOS();
+    tos = locals[instr->imm.i];
+    *UPPER(sp) = *UPPER(locals + instr->imm.i);
+    DISPATCH();
+
+v128_local_set:
+    locals[instr->imm.i] = tos;
+    *UPPER(locals + instr->imm.i) = *UPPER(sp);
+    FILL_TOS();
+    DISPATCH();
+
+v128_local_tee:
+    locals[instr->imm.i] = tos;
+    *UPPER(locals + instr->imm.i) = *UPPER(sp);
+    DISPATCH();
+
+select_v128:
+    arg_int = tos.i;
+    sp -= 2;
+    tos = arg_int ? sp[0] : sp[1];
+    if (!arg_int) {
+        *UPPER(sp) = UPPER(sp)[1];
+    }
+    DISPATCH();
+
+// atomic operands: address, then expected and replacement values, the last one in tos
+atomic_load:
+    address = atomics::address(memory, tos, instr->imm.atomic);
+    tos.i = atomics::result(atomics::load(address, instr->imm.atomic.size), instr->imm.atomic);
+    DISPATCH();
+
+atomic_store:
+    address = atomics::address(memory, sp[-1], instr->imm.atomic);
+    atomics::store(address, instr->imm.atomic.size, tos.i);
+    --sp;
+    FILL_TOS();
+    DISPATCH();
+
+atomic_rmw:
+    address = atomics::address(memory, *--sp, instr->imm.atomic);
+    tos.i = atomics::result(atomics::rmw(address, instr->imm.atomic.size,
+                                         static_cast<atomics::Rmw>(instr->imm.atomic.rmw), tos.i),
+                            instr->imm.atomic);
+    DISPATCH();
+
+atomic_cmpxchg:
+    sp -= 2;
+    address = atomics::address(memory, sp[0], instr->imm.atomic);
+    tos.i = atomics::result(atomics::cmpxchg(address, instr->imm.atomic.size, sp[1].i, tos.i), instr->imm.atomic);
+    DISPATCH();
+
+memory_atomic_wait:
+    sp -= 2;
+    address = atomics::address(memory, sp[0], instr->imm.atomic);
+    tos.i = linear_memory_->wait(address - memory, sp[1].i, instr->imm.atomic.size, tos.i);
+    DISPATCH();
+
+memory_atomic_notify:
+    address = atomics::address(memory, *--sp, instr->imm.atomic);
+    tos.i = linear_memory_->notify(address - memory, static_cast<u32>(tos.i));
+    DISPATCH();
+
+atomic_fence:
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    DISPATCH();
 }
 
+#undef CURRENT_IP
+#define CURRENT_IP() (top_frame_->ip - 1)
+
+#define REG_DISPATCH() goto *(instr = &top_frame_->reg_code[top_frame_->ip++])->handler
+
+void Interpreter::registerCode(bool export_handlers) {
+    const RegInstr *instr;
+    WasmVal *regs;
+    i64 arg_int = 0;
+    u8 *memory = memory_;
+    // Direct-threading dispatch table of the register tier
+    static void* dispatch_table[] = {
+            [runtime::reg::unreachable] = &&unreachable,
+            [runtime::reg::unsupported] = &&unsupported,
+            [runtime::reg::mov] = &&mov,
+            [runtime::reg::copy] = &&copy,
+            [runtime::reg::i32_const] = &&i32_const,
+            [runtime::reg::i32_add] = &&i32_add,
+            [runtime::reg::i32_sub] = &&i32_sub,
+            [runtime::reg::i32_and] = &&i32_and,
+            [runtime::reg::i32_ne] = &&i32_ne,
+            [runtime::reg::i32_lt_s] = &&i32_lt_s,
+            [runtime::reg::select] = &&select,
+            [runtime::reg::i32_load] = &&i32_load,
+            [runtime::reg::i64_load] = &&i64_load,
+            [runtime::reg::f32_load] = &&f32_load,
+            [runtime::reg::f64_load] = &&f64_load,
+            [runtime::reg::i32_load8_s] = &&i32_load8_s,
+            [runtime::reg::i32_load8_u] = &&i32_load8_u,
+            [runtime::reg::i32_load16_s] = &&i32_load16_s,
+            [runtime::reg::i32_load16_u] = &&i32_load16_u,
+            [runtime::reg::i64_load8_s] = &&i64_load8_s,
+            [runtime::reg::i64_load8_u] = &&i64_load8_u,
+            [runtime::reg::i64_load16_s] = &&i64_load16_s,
+            [runtime::reg::i64_load16_u] = &&i64_load16_u,
+            [runtime::reg::i64_load32_s] = &&i64_load32_s,
+            [runtime::reg::i64_load32_u] = &&i64_load32_u,
+            [runtime::reg::i32_store] = &&i32_store,
+            [runtime::reg::i64_store] = &&i64_store,
+            [runtime::reg::f32_store] = &&f32_store,
+            [runtime::reg::f64_store] = &&f64_store,
+            [runtime::reg::i32_store8] = &&i32_store8,
+            [runtime::reg::i32_store16] = &&i32_store16,
+            [runtime::reg::i64_store8] = &&i64_store8,
+            [runtime::reg::i64_store16] = &&i64_store16,
+            [runtime::reg::i64_store32] = &&i64_store32,
+            [runtime::reg::memory_size] = &&memory_size,
+            [runtime::reg::memory_grow] = &&memory_grow,
+            [runtime::reg::memory_init] = &&memory_init,
+            [runtime::reg::data_drop] = &&data_drop,
+            [runtime::reg::memory_copy] = &&memory_copy,
+            [runtime::reg::memory_fill] = &&memory_fill,
+            [runtime::reg::br] = &&br,
+            [runtime::reg::br_if] = &&br_if,
+            [runtime::reg::br_unless] = &&br_unless,
+            [runtime::reg::br_table] = &&br_table,
+            [runtime::reg::call] = &&call,
+            [runtime::reg::return_] = &&return_,
+    };
+
+    if (export_handlers) {
+        reg_handlers_ = dispatch_table;
+        return;
+    }
+
+    regs = top_frame_->locals;
+    REG_DISPATCH();
+
+unreachable:
+    UNIMPLEMENTED("unreachable");
+
+unsupported:
+    UNIMPLEMENTED(instr->imm.i);
 
+mov:
+    regs[instr->dst] = regs[instr->lhs];
+    REG_DISPATCH();
+
+copy:
+    std::copy_n(regs + instr->lhs, instr->imm.i, regs + instr->dst);
+    REG_DISPATCH();
+
+i32_const:
+    regs[instr->dst] = WasmVal{.i = instr->imm.i};
+    REG_DISPATCH();
+
+i32_add:
+    arg_int = static_cast<i32>(regs[instr->lhs].i + regs[instr->rhs].i);
+    regs[instr->dst] = WasmVal{.i = arg_int};
+    REG_DISPATCH();
 
-}
\ No newline at end of file
+i32_sub:
+    arg_int = static_cast<i32>(regs[instr->lhs].i - regs[instr->rhs].i);
+    regs[instr->dst] = WasmVal{.i = arg_int};
+    REG_DISPATCH();
+
+i32_and:
+    arg_int = regs[instr->lhs].i & regs[instr->rhs].i;
+    regs[instr->dst] = WasmVal{.i = arg_int};
+    REG_DISPATCH();
+
+i32_ne:
+    arg_int = static_cast<i32>(regs[instr->lhs].i) != static_cast<i32>(regs[instr->rhs].i);
+    regs[instr->dst] = WasmVal{.i = arg_int};
+    REG_DISPATCH();
+
+i32_lt_s:
+    arg_int = static_cast<i32>(regs[instr->lhs].i) < static_cast<i32>(regs[instr->rhs].i);
+    regs[instr->dst] = WasmVal{.i = arg_int};
+    REG_DISPATCH();
+
+select:
+    regs[instr->dst] = regs[instr->imm.i].i ? regs[instr->lhs] : regs[instr->rhs];
+    REG_DISPATCH();
+
+i32_load:
+    regs[instr->dst].i = loadMemory<i32>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+i64_load:
+    regs[instr->dst].i = loadMemory<i64>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+f32_load:
+    regs[instr->dst].f = loadMemory<f32>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+f64_load:
+    regs[instr->dst].f = loadMemory<f64>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+i32_load8_s:
+    regs[instr->dst].i = loadMemory<int8_t>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+i32_load8_u:
+    regs[instr->dst].i = loadMemory<u8>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+i32_load16_s:
+    regs[instr->dst].i = loadMemory<int16_t>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+i32_load16_u:
+    regs[instr->dst].i = loadMemory<u16>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+i64_load8_s:
+    regs[instr->dst].i = loadMemory<int8_t>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+i64_load8_u:
+    regs[instr->dst].i = loadMemory<u8>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+i64_load16_s:
+    regs[instr->dst].i = loadMemory<int16_t>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+i64_load16_u:
+    regs[instr->dst].i = loadMemory<u16>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+i64_load32_s:
+    regs[instr->dst].i = loadMemory<i32>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+i64_load32_u:
+    regs[instr->dst].i = loadMemory<u32>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i);
+    REG_DISPATCH();
+
+i32_store:
+    storeMemory<i32>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i, regs[instr->rhs].i);
+    REG_DISPATCH();
+
+i64_store:
+    storeMemory<i64>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i, regs[instr->rhs].i);
+    REG_DISPATCH();
+
+f32_store:
+    storeMemory<f32>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i, regs[instr->rhs].f);
+    REG_DISPATCH();
+
+f64_store:
+    storeMemory<f64>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i, regs[instr->rhs].f);
+    REG_DISPATCH();
+
+i32_store8:
+    storeMemory<u8>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i, regs[instr->rhs].i);
+    REG_DISPATCH();
+
+i32_store16:
+    storeMemory<u16>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i, regs[instr->rhs].i);
+    REG_DISPATCH();
+
+i64_store8:
+    storeMemory<u8>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i, regs[instr->rhs].i);
+    REG_DISPATCH();
+
+i64_store16:
+    storeMemory<u16>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i, regs[instr->rhs].i);
+    REG_DISPATCH();
+
+i64_store32:
+    storeMemory<u32>(memory + static_cast<u32>(regs[instr->lhs].i) + instr->imm.i, regs[instr->rhs].i);
+    REG_DISPATCH();
+
+memory_size:
+    regs[instr->dst].i = linear_memory_->pages();
+    REG_DISPATCH();
+
+memory_grow:
+    regs[instr->dst].i = linear_memory_->grow(static_cast<u32>(regs[instr->lhs].i));
+    REG_DISPATCH();
+
+memory_init:
+    linear_memory_->init(static_cast<u32>(regs[instr->dst].i), store_->dataSegment(instr->imm.i),
+                         static_cast<u32>(regs[instr->lhs].i), static_cast<u32>(regs[instr->rhs].i));
+    REG_DISPATCH();
+
+data_drop:
+    store_->dropData(instr->imm.i);
+    REG_DISPATCH();
+
+memory_copy:
+    linear_memory_->copy(static_cast<u32>(regs[instr->dst].i), static_cast<u32>(regs[instr->lhs].i),
+                         static_cast<u32>(regs[instr->rhs].i));
+    REG_DISPATCH();
+
+memory_fill:
+    linear_memory_->fill(static_cast<u32>(regs[instr->dst].i), static_cast<u8>(regs[instr->lhs].i),
+                         static_cast<u32>(regs[instr->rhs].i));
+    REG_DISPATCH();
+
+br:
+    top_frame_->ip = instr->imm.i;
+    REG_DISPATCH();
+
+br_if:
+    if (regs[instr->lhs].i) {
+        top_frame_->ip = instr->imm.i;
+    }
+    REG_DISPATCH();
+
+br_unless:
+    if (!regs[instr->lhs].i) {
+        top_frame_->ip = instr->imm.i;
+    }
+    REG_DISPATCH();
+
+br_table:
+    // label slots follow the instruction, an out of range index takes the default label
+    arg_int = static_cast<u32>(regs[instr->lhs].i);
+    top_frame_->ip += std::min(arg_int, instr->imm.i);
+    REG_DISPATCH();
+
+call:
+    callRegisterFunc(instr->imm.i, regs + instr->dst);
+    regs = top_frame_->locals;
+    REG_DISPATCH();
+
+return_:
+    if (frames_.size() == 1) {
+        return;
+    }
+    popRegisterFrame(instr->lhs);
+    regs = top_frame_->locals;
+    REG_DISPATCH();
+}
+
+}
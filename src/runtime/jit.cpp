@@ -0,0 +1,903 @@
+#include "runtime/jit.hpp"
+#include "runtime/decoder.hpp"
+#include "runtime/memory.hpp"
+#include "util/util.hpp"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstddef>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace omega::wass {
+using namespace runtime;
+
+namespace {
+
+enum Reg : u8 {
+    RAX = 0,
+    RCX = 1,
+    RDX = 2,
+    RBX = 3,   // frame base
+    RSP = 4,
+    RBP = 5,   // JitRuntime
+    RSI = 6,
+    RDI = 7
+};
+
+// Condition codes of setcc and jcc
+enum Cond : u8 {
+    CC_B  = 0x2,
+    CC_AE = 0x3,
+    CC_E  = 0x4,
+    CC_NE = 0x5,
+    CC_BE = 0x6,
+    CC_A  = 0x7,
+    CC_L  = 0xC,
+    CC_GE = 0xD,
+    CC_LE = 0xE,
+    CC_G  = 0xF
+};
+
+constexpr u8 REX_W = 0x48;
+constexpr u8 NO_REX = 0;
+
+// compiled frames cannot be unwound, errors leave through trap
+[[noreturn]] void jitStackOverflow() {
+    trap(std::make_exception_ptr(std::runtime_error("call stack exhausted")));
+}
+
+[[noreturn]] void jitUnreachable() {
+    trap(std::make_exception_ptr(std::runtime_error("unreachable executed in compiled code")));
+}
+
+class Assembler {
+public:
+    size_t pos() const { return code_.size(); }
+    const std::vector<u8> &code() const { return code_; }
+
+    void bytes(std::initializer_list<u8> bs) { code_.insert(code_.end(), bs); }
+
+    void imm32(u32 value) {
+        for (int i = 0; i < 4; ++i) {
+            code_.push_back(value >> (8 * i));
+        }
+    }
+
+    void imm64(u64 value) {
+        imm32(value);
+        imm32(value >> 32);
+    }
+
+    void patch32(size_t at, u32 value) { std::memcpy(&code_[at], &value, sizeof(value)); }
+
+    // opcode reg, [base + disp32]
+    void mem(u8 rex, std::initializer_list<u8> opcode, u8 reg, Reg base, i32 disp) {
+        if (rex) {
+            code_.push_back(rex);
+        }
+        bytes(opcode);
+        code_.push_back(0x80 | (reg << 3) | base);
+        imm32(disp);
+    }
+
+    // opcode reg, [base + index + disp32]
+    void memIndexed(u8 rex, std::initializer_list<u8> opcode, u8 reg, Reg base, Reg index, i32 disp) {
+        if (rex) {
+            code_.push_back(rex);
+        }
+        bytes(opcode);
+        code_.push_back(0x84 | (reg << 3));
+        code_.push_back((index << 3) | base);
+        imm32(disp);
+    }
+
+    void callAbsolute(const void *target) {
+        bytes({REX_W, 0xB8});   // mov rax, imm64
+        imm64(reinterpret_cast<u64>(target));
+        bytes({0xFF, 0xD0});    // call rax
+    }
+private:
+    std::vector<u8> code_;
+};
+
+struct Label {
+    i64 pos = -1;
+    std::vector<size_t> fixups;
+};
+
+struct JitControl {
+    u8 op;
+    u32 height;        // operand stack height below the block parameters
+    BlockArity arity;
+    u32 label;         // loop start or block end
+    u32 else_label;    // false branch of an if
+    u32 result_slot;   // where branches leave their values
+};
+
+// Entry at a loop header for on-stack replacement, pos is relative to the function start
+struct OsrEntry {
+    u32 loop;
+    size_t pos;
+};
+
+bool isSupported(const DecodedInstr &instr) {
+    u8 op = instr.op;
+    switch (op) {
+        case Bytecode::unreachable:
+        case Bytecode::nop:
+        case Bytecode::block:
+        case Bytecode::loop:
+        case Bytecode::if_:
+        case Bytecode::else_:
+        case Bytecode::end:
+        case Bytecode::br:
+        case Bytecode::br_if:
+        case Bytecode::br_table:
+        case Bytecode::return_:
+        case Bytecode::call:
+        case Bytecode::drop:
+        case Bytecode::select:
+        case Bytecode::local_get:
+        case Bytecode::local_set:
+        case Bytecode::local_tee:
+        case Bytecode::i32_const:
+        case Bytecode::i64_const:
+        case Bytecode::memory_size:
+        case Bytecode::memory_grow:
+            return true;
+        case Bytecode::select_t:
+            return instr.imm.i == I32 || instr.imm.i == I64;
+        case prefix::misc:
+            return instr.sub_op >= misc::memory_init && instr.sub_op <= misc::memory_fill;
+        case Bytecode::f32_load:
+        case Bytecode::f64_load:
+        case Bytecode::f32_store:
+        case Bytecode::f64_store:
+            return false;
+        default:
+            break;
+    }
+    if (op >= Bytecode::i32_load && op <= Bytecode::i64_store32) {
+        // the offset has to fit the displacement of the access
+        return instr.imm.i <= INT32_MAX;
+    }
+    return (op >= Bytecode::i32_eqz && op <= Bytecode::i64_ge_u) ||
+           (op >= Bytecode::i32_add && op <= Bytecode::i32_mul) ||
+           (op >= Bytecode::i32_and && op <= Bytecode::i32_rotr) ||
+           (op >= Bytecode::i64_add && op <= Bytecode::i64_mul) ||
+           (op >= Bytecode::i64_and && op <= Bytecode::i64_rotr) ||
+           op == Bytecode::i32_wrap_i64 || op == Bytecode::i64_extend_s_i32 || op == Bytecode::i64_extend_u_i32 ||
+           (op >= 0xC0 && op <= 0xC4);
+}
+
+bool isCompilable(std::span<const u8> code) {
+    const u8 *ptr = code.data();
+    const u8 *end = ptr + code.size();
+    while (ptr < end) {
+        DecodedInstr instr = decodeInstr(ptr, end);
+        if (!isSupported(instr)) {
+            return false;
+        }
+        if (instr.op == Bytecode::br_table) {
+            for (i64 i = 0; i <= instr.imm.i; ++i) {
+                util::readULEB128(ptr, end);
+            }
+        }
+    }
+    return true;
+}
+
+// Compiles one function body. Locals and operands stay in the frame slots: operand stack
+// height h lives in slot locals + h, so every template addresses [rbx + 8 * slot] directly.
+class FunctionCompiler {
+public:
+    FunctionCompiler(Assembler &as, const RuntimeFunction &func, const ModuleTypes &types, const CompiledModule &compiled)
+        : as_(as), func_(func), types_(types), compiled_(compiled), locals_(func.localsCount) {}
+
+    void compile(std::span<const u8> code);
+    const std::vector<OsrEntry> &osrEntries() const { return osr_entries_; }
+    u32 loopCount() const { return loop_count_; }
+private:
+    i32 disp(u32 slot) const { return static_cast<i32>(slot * sizeof(WasmVal)); }
+    u32 top(u32 depth = 0) const { return locals_ + height_ - 1 - depth; }
+
+    void load(Reg reg, u32 slot) { as_.mem(REX_W, {0x8B}, reg, RBX, disp(slot)); }
+    void load32(Reg reg, u32 slot) { as_.mem(NO_REX, {0x8B}, reg, RBX, disp(slot)); }
+    void store(u32 slot, Reg reg) { as_.mem(REX_W, {0x89}, reg, RBX, disp(slot)); }
+    void signExtendEax() { as_.bytes({REX_W, 0x63, 0xC0}); }   // movsxd rax, eax
+
+    void storeConst(u32 slot, i64 value) {
+        if (value == static_cast<i32>(value)) {
+            as_.mem(REX_W, {0xC7}, 0, RBX, disp(slot));
+            as_.imm32(value);
+        } else {
+            as_.bytes({REX_W, 0xB8});
+            as_.imm64(value);
+            store(slot, RAX);
+        }
+    }
+
+    u32 newLabel() {
+        labels_.emplace_back();
+        return labels_.size() - 1;
+    }
+
+    void bind(u32 id) {
+        Label &label = labels_[id];
+        label.pos = as_.pos();
+        for (size_t at : label.fixups) {
+            as_.patch32(at, label.pos - (at + 4));
+        }
+        label.fixups.clear();
+    }
+
+    void ref(u32 id) {
+        Label &label = labels_[id];
+        if (label.pos >= 0) {
+            as_.imm32(label.pos - (as_.pos() + 4));
+        } else {
+            label.fixups.push_back(as_.pos());
+            as_.imm32(0);
+        }
+    }
+
+    void jmp(u32 label) {
+        as_.bytes({0xE9});
+        ref(label);
+    }
+
+    void jcc(Cond cond, u32 label) {
+        as_.bytes({0x0F, static_cast<u8>(0x80 | cond)});
+        ref(label);
+    }
+
+    void setcc(Cond cond) {
+        as_.bytes({0x0F, static_cast<u8>(0x90 | cond), 0xC0});   // setcc al
+        as_.bytes({0x0F, 0xB6, 0xC0});                           // movzx eax, al
+    }
+
+    void moveValues(u32 from, u32 to, u32 count) {
+        if (from == to) {
+            return;
+        }
+        for (u32 i = 0; i < count; ++i) {
+            load(RAX, from + i);
+            store(to + i, RAX);
+        }
+    }
+
+    JitControl &target(u64 depth) { return controls_[controls_.size() - 1 - depth]; }
+
+    u32 branchArity(const JitControl &ctrl) const {
+        return ctrl.op == Bytecode::loop ? ctrl.arity.params : ctrl.arity.results;
+    }
+
+    bool needsMoves(const JitControl &ctrl) const {
+        u32 arity = branchArity(ctrl);
+        return arity && locals_ + height_ - arity != ctrl.result_slot;
+    }
+
+    // values of the label arity move to the target slots, then jump
+    void branchTo(u64 depth) {
+        JitControl &ctrl = target(depth);
+        u32 arity = branchArity(ctrl);
+        moveValues(locals_ + height_ - arity, ctrl.result_slot, arity);
+        jmp(ctrl.label);
+    }
+
+    void conditionalBranch(u64 depth) {
+        as_.mem(REX_W, {0x83}, 7, RBX, disp(top()));   // cmp qword [cond], 0
+        as_.bytes({0x00});
+        --height_;
+        JitControl &ctrl = target(depth);
+        if (!needsMoves(ctrl)) {
+            jcc(CC_NE, ctrl.label);
+            return;
+        }
+        u32 skip = newLabel();
+        jcc(CC_E, skip);
+        branchTo(depth);
+        bind(skip);
+    }
+
+    void enter();
+    void prologue();
+    void epilogue();
+    void compileCall(u32 f_ind);
+    void compileBrTable(const DecodedInstr &instr, const u8 *&ptr, const u8 *end);
+    void compileNumeric(u8 op);
+    void compileMemoryGrow();
+    void compileBulkMemory(const DecodedInstr &instr);
+    void compileLoad(u8 op, i32 offset);
+    void compileStore(u8 op, i32 offset);
+    void binary32(std::initializer_list<u8> opcode);
+    void binary64(std::initializer_list<u8> opcode);
+    void compare(u8 rex, Cond cond);
+    void shift(u8 rex, u8 modrm);
+
+    Assembler &as_;
+    const RuntimeFunction &func_;
+    const ModuleTypes &types_;
+    const CompiledModule &compiled_;
+    u32 locals_;
+    u32 height_ = 0;
+    std::vector<JitControl> controls_;
+    std::vector<Label> labels_;
+    u32 overflow_label_ = 0;
+    std::vector<std::pair<u32, u32>> loop_labels_;   // loop index and label of every compiled loop header
+    std::vector<OsrEntry> osr_entries_;
+    u32 loop_count_ = 0;
+};
+
+void FunctionCompiler::enter() {
+    as_.bytes({0x53});                     // push rbx
+    as_.bytes({0x55});                     // push rbp
+    as_.bytes({REX_W, 0x83, 0xEC, 0x08});  // sub rsp, 8
+    as_.bytes({REX_W, 0x89, 0xFB});        // mov rbx, rdi
+    as_.bytes({REX_W, 0x89, 0xF5});        // mov rbp, rsi
+
+    // the frame has to fit into the value stack and the native stack has to have room for the call
+    as_.mem(REX_W, {0x8D}, RAX, RBX, disp(func_.frameSize));
+    as_.mem(REX_W, {0x3B}, RAX, RBP, offsetof(JitRuntime, stack_end));
+    jcc(CC_A, overflow_label_);
+    as_.mem(REX_W, {0x3B}, RSP, RBP, offsetof(JitRuntime, native_stack_limit));
+    jcc(CC_B, overflow_label_);
+}
+
+void FunctionCompiler::prologue() {
+    enter();
+    u32 params = func_.signature.params.size();
+    if (params < locals_) {
+        as_.bytes({0x31, 0xC0});           // xor eax, eax
+        for (u32 i = params; i < locals_; ++i) {
+            store(i, RAX);
+        }
+    }
+}
+
+void FunctionCompiler::epilogue() {
+    as_.bytes({REX_W, 0x83, 0xC4, 0x08});  // add rsp, 8
+    as_.bytes({0x5D});                     // pop rbp
+    as_.bytes({0x5B});                     // pop rbx
+    as_.bytes({0xC3});                     // ret
+
+    bind(overflow_label_);
+    as_.callAbsolute(reinterpret_cast<const void *>(&jitStackOverflow));
+
+    // loop entries take over a live frame: locals are already set and the operands below
+    // the loop sit in the slots the compiled code expects
+    for (auto [loop, label] : loop_labels_) {
+        osr_entries_.push_back({loop, as_.pos()});
+        enter();
+        jmp(label);
+    }
+}
+
+void FunctionCompiler::compileCall(u32 f_ind) {
+    auto &sig = types_.types->at(types_.func_types.at(f_ind));
+    u32 args = locals_ + height_ - sig.params.size();
+    u32 done = newLabel();
+    u32 slow = newLabel();
+    bool native = compiled_.getFunc(f_ind).isNative;
+    if (!native) {
+        // a compiled callee is called directly, functions can get compiled while the module runs
+        as_.mem(REX_W, {0x8B}, RAX, RBP, offsetof(JitRuntime, entries));
+        as_.mem(REX_W, {0x8B}, RAX, RAX, disp(f_ind));
+        as_.bytes({REX_W, 0x85, 0xC0});                // test rax, rax
+        jcc(CC_E, slow);
+        as_.mem(REX_W, {0x8D}, RDI, RBX, disp(args));  // lea rdi, [args]
+        as_.bytes({REX_W, 0x89, 0xEE});                // mov rsi, rbp
+        as_.bytes({0xFF, 0xD0});                       // call rax
+        jmp(done);
+    }
+    bind(slow);
+    as_.bytes({REX_W, 0x89, 0xEF});                    // mov rdi, rbp
+    as_.bytes({0xBE});                                 // mov esi, f_ind
+    as_.imm32(f_ind);
+    as_.mem(REX_W, {0x8D}, RDX, RBX, disp(args));      // lea rdx, [args]
+    as_.mem(REX_W, {0x8B}, RAX, RBP, offsetof(JitRuntime, call));
+    as_.bytes({0xFF, 0xD0});                           // call rax
+    bind(done);
+    height_ = height_ - sig.params.size() + sig.results.size();
+}
+
+void FunctionCompiler::compileBrTable(const DecodedInstr &instr, const u8 *&ptr, const u8 *end) {
+    std::vector<u64> labels(instr.imm.i + 1);
+    for (auto &label : labels) {
+        label = util::readULEB128(ptr, end);
+    }
+    load32(RAX, top());
+    --height_;
+    for (u32 i = 0; i + 1 < labels.size(); ++i) {
+        as_.bytes({0x3D});   // cmp eax, i
+        as_.imm32(i);
+        if (!needsMoves(target(labels[i]))) {
+            jcc(CC_E, target(labels[i]).label);
+            continue;
+        }
+        u32 next = newLabel();
+        jcc(CC_NE, next);
+        branchTo(labels[i]);
+        bind(next);
+    }
+    branchTo(labels.back());
+}
+
+void FunctionCompiler::binary32(std::initializer_list<u8> opcode) {
+    load32(RAX, top(1));
+    as_.mem(NO_REX, opcode, RAX, RBX, disp(top()));
+    signExtendEax();
+    store(top(1), RAX);
+    --height_;
+}
+
+void FunctionCompiler::binary64(std::initializer_list<u8> opcode) {
+    load(RAX, top(1));
+    as_.mem(REX_W, opcode, RAX, RBX, disp(top()));
+    store(top(1), RAX);
+    --height_;
+}
+
+void FunctionCompiler::compare(u8 rex, Cond cond) {
+    if (rex) {
+        load(RAX, top(1));
+    } else {
+        load32(RAX, top(1));
+    }
+    as_.mem(rex, {0x3B}, RAX, RBX, disp(top()));
+    setcc(cond);
+    store(top(1), RAX);
+    --height_;
+}
+
+void FunctionCompiler::shift(u8 rex, u8 modrm) {
+    load32(RCX, top());
+    if (rex) {
+        load(RAX, top(1));
+        as_.bytes({REX_W, 0xD3, modrm});
+    } else {
+        load32(RAX, top(1));
+        as_.bytes({0xD3, modrm});
+        signExtendEax();
+    }
+    store(top(1), RAX);
+    --height_;
+}
+
+// memory.grow with the delta in the top slot, memory.size pushes a zero delta first
+void FunctionCompiler::compileMemoryGrow() {
+    load32(RSI, top());
+    as_.bytes({REX_W, 0x89, 0xEF});   // mov rdi, rbp
+    as_.mem(REX_W, {0x8B}, RAX, RBP, offsetof(JitRuntime, memory_grow));
+    as_.bytes({0xFF, 0xD0});          // call rax
+    signExtendEax();
+    store(top(), RAX);
+}
+
+void FunctionCompiler::compileBulkMemory(const DecodedInstr &instr) {
+    u32 operands = instr.sub_op == misc::data_drop ? 0 : 3;
+    as_.mem(REX_W, {0x8D}, RCX, RBX, disp(locals_ + height_ - operands));   // lea rcx, [operands]
+    as_.bytes({REX_W, 0x89, 0xEF});   // mov rdi, rbp
+    as_.bytes({0xBE});                // mov esi, sub_op
+    as_.imm32(instr.sub_op);
+    as_.bytes({0xBA});                // mov edx, data index
+    as_.imm32(static_cast<u32>(instr.imm.i));
+    as_.mem(REX_W, {0x8B}, RAX, RBP, offsetof(JitRuntime, bulk_memory));
+    as_.bytes({0xFF, 0xD0});          // call rax
+    height_ -= operands;
+}
+
+void FunctionCompiler::compileLoad(u8 op, i32 offset) {
+    // u32 address zero-extended in rax, memory base in rdx: a single load, guard pages catch the rest
+    load32(RAX, top());
+    as_.mem(REX_W, {0x8B}, RDX, RBP, offsetof(JitRuntime, memory));
+    switch (op) {
+        case Bytecode::i32_load:
+        case Bytecode::i64_load32_s:
+            as_.memIndexed(REX_W, {0x63}, RAX, RDX, RAX, offset);        // movsxd rax, dword
+            break;
+        case Bytecode::i64_load:
+            as_.memIndexed(REX_W, {0x8B}, RAX, RDX, RAX, offset);        // mov rax, qword
+            break;
+        case Bytecode::i32_load8_s:
+        case Bytecode::i64_load8_s:
+            as_.memIndexed(REX_W, {0x0F, 0xBE}, RAX, RDX, RAX, offset);  // movsx rax, byte
+            break;
+        case Bytecode::i32_load8_u:
+        case Bytecode::i64_load8_u:
+            as_.memIndexed(NO_REX, {0x0F, 0xB6}, RAX, RDX, RAX, offset); // movzx eax, byte
+            break;
+        case Bytecode::i32_load16_s:
+        case Bytecode::i64_load16_s:
+            as_.memIndexed(REX_W, {0x0F, 0xBF}, RAX, RDX, RAX, offset);  // movsx rax, word
+            break;
+        case Bytecode::i32_load16_u:
+        case Bytecode::i64_load16_u:
+            as_.memIndexed(NO_REX, {0x0F, 0xB7}, RAX, RDX, RAX, offset); // movzx eax, word
+            break;
+        case Bytecode::i64_load32_u:
+            as_.memIndexed(NO_REX, {0x8B}, RAX, RDX, RAX, offset);       // mov eax, dword
+            break;
+        default:
+            throw std::runtime_error("jit: unexpected opcode " + std::to_string(op));
+    }
+    store(top(), RAX);
+}
+
+void FunctionCompiler::compileStore(u8 op, i32 offset) {
+    load(RCX, top());
+    load32(RAX, top(1));
+    as_.mem(REX_W, {0x8B}, RDX, RBP, offsetof(JitRuntime, memory));
+    switch (op) {
+        case Bytecode::i32_store:
+        case Bytecode::i64_store32:
+            as_.memIndexed(NO_REX, {0x89}, RCX, RDX, RAX, offset);       // mov dword, ecx
+            break;
+        case Bytecode::i64_store:
+            as_.memIndexed(REX_W, {0x89}, RCX, RDX, RAX, offset);        // mov qword, rcx
+            break;
+        case Bytecode::i32_store8:
+        case Bytecode::i64_store8:
+            as_.memIndexed(NO_REX, {0x88}, RCX, RDX, RAX, offset);       // mov byte, cl
+            break;
+        case Bytecode::i32_store16:
+        case Bytecode::i64_store16:
+            as_.memIndexed(NO_REX, {0x66, 0x89}, RCX, RDX, RAX, offset); // mov word, cx
+            break;
+        default:
+            throw std::runtime_error("jit: unexpected opcode " + std::to_string(op));
+    }
+    height_ -= 2;
+}
+
+void FunctionCompiler::compileNumeric(u8 op) {
+    constexpr Cond COMPARES[] = {CC_E, CC_NE, CC_L, CC_B, CC_G, CC_A, CC_LE, CC_BE, CC_GE, CC_AE};
+    switch (op) {
+        case Bytecode::i32_eqz:
+        case Bytecode::i64_eqz:
+            as_.mem(op == Bytecode::i64_eqz ? REX_W : NO_REX, {0x83}, 7, RBX, disp(top()));   // cmp [top], 0
+            as_.bytes({0x00});
+            setcc(CC_E);
+            store(top(), RAX);
+            return;
+        case Bytecode::i32_add: binary32({0x03}); return;
+        case Bytecode::i32_sub: binary32({0x2B}); return;
+        case Bytecode::i32_mul: binary32({0x0F, 0xAF}); return;
+        case Bytecode::i32_and: binary32({0x23}); return;
+        case Bytecode::i32_or:  binary32({0x0B}); return;
+        case Bytecode::i32_xor: binary32({0x33}); return;
+        case Bytecode::i64_add: binary64({0x03}); return;
+        case Bytecode::i64_sub: binary64({0x2B}); return;
+        case Bytecode::i64_mul: binary64({0x0F, 0xAF}); return;
+        case Bytecode::i64_and: binary64({0x23}); return;
+        case Bytecode::i64_or:  binary64({0x0B}); return;
+        case Bytecode::i64_xor: binary64({0x33}); return;
+        case Bytecode::i32_shl:   shift(NO_REX, 0xE0); return;
+        case Bytecode::i32_shr_s: shift(NO_REX, 0xF8); return;
+        case Bytecode::i32_shr_u: shift(NO_REX, 0xE8); return;
+        case Bytecode::i32_rotl:  shift(NO_REX, 0xC0); return;
+        case Bytecode::i32_rotr:  shift(NO_REX, 0xC8); return;
+        case Bytecode::i64_shl:   shift(REX_W, 0xE0); return;
+        case Bytecode::i64_shr_s: shift(REX_W, 0xF8); return;
+        case Bytecode::i64_shr_u: shift(REX_W, 0xE8); return;
+        case Bytecode::i64_rotl:  shift(REX_W, 0xC0); return;
+        case Bytecode::i64_rotr:  shift(REX_W, 0xC8); return;
+        case Bytecode::i32_wrap_i64:
+        case 0xC4:  // i64.extend32_s
+            as_.mem(REX_W, {0x63}, RAX, RBX, disp(top()));         // movsxd rax, dword [top]
+            store(top(), RAX);
+            return;
+        case Bytecode::i64_extend_s_i32:
+            // i32 values are kept sign-extended already
+            return;
+        case Bytecode::i64_extend_u_i32:
+            load32(RAX, top());
+            store(top(), RAX);
+            return;
+        case 0xC0:  // i32.extend8_s
+        case 0xC2:  // i64.extend8_s
+            as_.mem(REX_W, {0x0F, 0xBE}, RAX, RBX, disp(top()));   // movsx rax, byte [top]
+            store(top(), RAX);
+            return;
+        case 0xC1:  // i32.extend16_s
+        case 0xC3:  // i64.extend16_s
+            as_.mem(REX_W, {0x0F, 0xBF}, RAX, RBX, disp(top()));   // movsx rax, word [top]
+            store(top(), RAX);
+            return;
+        default:
+            break;
+    }
+    if (op >= Bytecode::i32_eq && op <= Bytecode::i32_ge_u) {
+        compare(NO_REX, COMPARES[op - Bytecode::i32_eq]);
+    } else if (op >= Bytecode::i64_eq && op <= Bytecode::i64_ge_u) {
+        compare(REX_W, COMPARES[op - Bytecode::i64_eq]);
+    } else {
+        throw std::runtime_error("jit: unexpected opcode " + std::to_string(op));
+    }
+}
+
+void FunctionCompiler::compile(std::span<const u8> code) {
+    overflow_label_ = newLabel();
+    u32 return_label = newLabel();
+    prologue();
+
+    // function body acts as the outermost block, its results go to the frame base
+    controls_.push_back({
+        .op = Bytecode::block,
+        .height = 0,
+        .arity = {0, static_cast<u32>(func_.signature.results.size())},
+        .label = return_label,
+        .else_label = 0,
+        .result_slot = 0
+    });
+
+    bool dead = false;
+    u32 dead_depth = 0;
+    const u8 *ptr = code.data();
+    const u8 *end = ptr + code.size();
+    while (ptr < end && !controls_.empty()) {
+        DecodedInstr instr = decodeInstr(ptr, end);
+        u8 op = instr.op;
+        // loops are numbered in body order, dead ones included, like the loop headers of the stack tier
+        u32 loop_index = loop_count_;
+        if (op == Bytecode::loop) {
+            ++loop_count_;
+        }
+
+        if (dead) {
+            // unreachable code is not compiled, only its nesting is tracked
+            if (op == Bytecode::block || op == Bytecode::loop || op == Bytecode::if_) {
+                ++dead_depth;
+                continue;
+            }
+            if (op == Bytecode::br_table) {
+                for (i64 i = 0; i <= instr.imm.i; ++i) {
+                    util::readULEB128(ptr, end);
+                }
+                continue;
+            }
+            if (op == Bytecode::end && dead_depth > 0) {
+                --dead_depth;
+                continue;
+            }
+            if ((op != Bytecode::end && op != Bytecode::else_) || dead_depth > 0) {
+                continue;
+            }
+        }
+
+        switch (op) {
+            case Bytecode::unreachable:
+                as_.callAbsolute(reinterpret_cast<const void *>(&jitUnreachable));
+                dead = true;
+                break;
+            case Bytecode::nop:
+                break;
+            case Bytecode::block:
+            case Bytecode::loop:
+            case Bytecode::if_: {
+                u32 else_label = 0;
+                if (op == Bytecode::if_) {
+                    else_label = newLabel();
+                    as_.mem(REX_W, {0x83}, 7, RBX, disp(top()));   // cmp qword [cond], 0
+                    as_.bytes({0x00});
+                    jcc(CC_E, else_label);
+                    --height_;
+                }
+                BlockArity arity = blockArity(instr.imm.i, types_);
+                u32 label = newLabel();
+                if (op == Bytecode::loop) {
+                    bind(label);
+                    loop_labels_.push_back({loop_index, label});
+                }
+                u32 height = height_ - arity.params;
+                controls_.push_back({
+                    .op = op,
+                    .height = height,
+                    .arity = arity,
+                    .label = label,
+                    .else_label = else_label,
+                    .result_slot = locals_ + height
+                });
+                break;
+            }
+            case Bytecode::else_: {
+                JitControl &ctrl = controls_.back();
+                if (!dead) {
+                    jmp(ctrl.label);
+                }
+                bind(ctrl.else_label);
+                ctrl.op = Bytecode::block;
+                height_ = ctrl.height + ctrl.arity.params;
+                dead = false;
+                break;
+            }
+            case Bytecode::end: {
+                JitControl ctrl = controls_.back();
+                controls_.pop_back();
+                if (ctrl.op == Bytecode::if_) {
+                    // if without else falls through with its parameters as results
+                    bind(ctrl.else_label);
+                }
+                if (controls_.empty()) {
+                    if (!dead) {
+                        moveValues(locals_ + height_ - ctrl.arity.results, 0, ctrl.arity.results);
+                    }
+                    bind(ctrl.label);
+                    break;
+                }
+                if (ctrl.op != Bytecode::loop) {
+                    bind(ctrl.label);
+                }
+                height_ = ctrl.height + ctrl.arity.results;
+                dead = false;
+                break;
+            }
+            case Bytecode::br:
+                branchTo(instr.imm.i);
+                dead = true;
+                break;
+            case Bytecode::br_if:
+                conditionalBranch(instr.imm.i);
+                break;
+            case Bytecode::br_table:
+                compileBrTable(instr, ptr, end);
+                dead = true;
+                break;
+            case Bytecode::return_:
+                branchTo(controls_.size() - 1);
+                dead = true;
+                break;
+            case Bytecode::call:
+                compileCall(instr.imm.i);
+                break;
+            case Bytecode::memory_size:
+                ++height_;
+                as_.bytes({0x31, 0xC0});   // xor eax, eax
+                store(top(), RAX);
+                compileMemoryGrow();
+                break;
+            case Bytecode::memory_grow:
+                compileMemoryGrow();
+                break;
+            case prefix::misc:
+                compileBulkMemory(instr);
+                break;
+            case Bytecode::drop:
+                --height_;
+                break;
+            case Bytecode::select:
+            case Bytecode::select_t:
+                load(RAX, top(2));
+                as_.mem(REX_W, {0x83}, 7, RBX, disp(top()));      // cmp qword [cond], 0
+                as_.bytes({0x00});
+                as_.mem(REX_W, {0x0F, 0x44}, RAX, RBX, disp(top(1)));   // cmove rax, [rhs]
+                store(top(2), RAX);
+                height_ -= 2;
+                break;
+            case Bytecode::local_get:
+                load(RAX, instr.imm.i);
+                ++height_;
+                store(top(), RAX);
+                break;
+            case Bytecode::local_set:
+                load(RAX, top());
+                store(instr.imm.i, RAX);
+                --height_;
+                break;
+            case Bytecode::local_tee:
+                load(RAX, top());
+                store(instr.imm.i, RAX);
+                break;
+            case Bytecode::i32_const:
+            case Bytecode::i64_const:
+                ++height_;
+                storeConst(top(), instr.imm.i);
+                break;
+            default:
+                if (op >= Bytecode::i32_load && op <= Bytecode::i64_load32_u) {
+                    compileLoad(op, instr.imm.i);
+                } else if (op >= Bytecode::i32_store && op <= Bytecode::i64_store32) {
+                    compileStore(op, instr.imm.i);
+                } else {
+                    compileNumeric(op);
+                }
+                break;
+        }
+    }
+    epilogue();
+}
+
+}
+
+JitCode::JitCode(JitCode &&other) noexcept : regions_(std::move(other.regions_)) {
+    other.regions_.clear();
+}
+
+JitCode &JitCode::operator=(JitCode &&other) noexcept {
+    std::swap(regions_, other.regions_);
+    return *this;
+}
+
+JitCode::~JitCode() {
+    for (auto &region : regions_) {
+        munmap(region.base, region.size);
+        munmap(region.write, region.size);
+    }
+}
+
+const u8 *JitCode::install(const std::vector<u8> &code) {
+    // function entries stay 16 byte aligned
+    size_t size = (code.size() + 15) & ~size_t{15};
+    if (regions_.empty() || regions_.back().size - regions_.back().used < size) {
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t region_size = (std::max(size, REGION_SIZE) + page - 1) / page * page;
+        int fd = memfd_create("owasm-jit", MFD_CLOEXEC);
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(region_size)) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            throw std::runtime_error("jit: cannot create code region");
+        }
+        void *base = mmap(nullptr, region_size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+        void *write = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        // the mappings keep the pages
+        close(fd);
+        if (base == MAP_FAILED || write == MAP_FAILED) {
+            if (base != MAP_FAILED) {
+                munmap(base, region_size);
+            }
+            if (write != MAP_FAILED) {
+                munmap(write, region_size);
+            }
+            throw std::runtime_error("jit: cannot map code region");
+        }
+        regions_.push_back({static_cast<u8 *>(base), static_cast<u8 *>(write), region_size, 0});
+    }
+    Region &region = regions_.back();
+    std::memcpy(region.write + region.used, code.data(), code.size());
+    const u8 *target = region.base + region.used;
+    region.used += size;
+    return target;
+}
+
+JitCompiler::JitCompiler(CompiledModule &compiled)
+    : module_(compiled.module()), compiled_(compiled), types_(collectModuleTypes(module_)),
+      imports_(compiled.funcCount() - module_.codeSection.size()), entries_(compiled.funcCount(), nullptr) {}
+
+void JitCompiler::compileModule() {
+    for (u32 f_ind = imports_; f_ind < compiled_.funcCount(); ++f_ind) {
+        compileFunction(f_ind);
+    }
+}
+
+bool JitCompiler::compileFunction(u32 f_ind) {
+    RuntimeFunction &f = compiled_.getFunc(f_ind);
+    std::lock_guard lock(lock_);
+    if (f.jitCode) {
+        return true;
+    }
+    std::span<const u8> body = module_.codeSection.at(f_ind - imports_).code;
+    if (f.jitRejected || f.simd || !isCompilable(body)) {
+        publish(f.jitRejected, true);
+        return false;
+    }
+
+    Assembler as;
+    FunctionCompiler compiler(as, f, types_, compiled_);
+    compiler.compile(body);
+    const u8 *code = code_.install(as.code());
+
+    f.osrEntries.assign(compiler.loopCount(), nullptr);
+    for (auto &entry : compiler.osrEntries()) {
+        f.osrEntries[entry.loop] = reinterpret_cast<JitFunc>(const_cast<u8 *>(code + entry.pos));
+    }
+    // the loop entries and the code are in place before a thread can see the function compiled
+    auto entry = reinterpret_cast<JitFunc>(const_cast<u8 *>(code));
+    publish(entries_[f_ind], entry);
+    publish(f.jitCode, entry);
+    return true;
+}
+
+}
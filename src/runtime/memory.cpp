@@ -0,0 +1,332 @@
+#include "runtime/memory.hpp"
+#include "runtime/runtime_structs.hpp"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csetjmp>
+#include <csignal>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+namespace omega::wass {
+
+namespace {
+
+// Reservations the fault handler recognizes, read from signal context so kept lock free
+constexpr size_t MAX_MEMORIES = 4096;   // 32 TiB of reservations, a quarter of the user address space
+std::array<std::atomic<u8 *>, MAX_MEMORIES> reservations{};
+
+thread_local sigjmp_buf *trap_target = nullptr;
+thread_local std::exception_ptr trap_error;   // raised by trap, null for faults
+struct sigaction previous_action{};
+
+void registerReservation(u8 *base) {
+    for (auto &slot : reservations) {
+        u8 *expected = nullptr;
+        if (slot.compare_exchange_strong(expected, base)) {
+            return;
+        }
+    }
+    throw std::runtime_error("too many linear memories");
+}
+
+void unregisterReservation(u8 *base) {
+    for (auto &slot : reservations) {
+        u8 *expected = base;
+        if (slot.compare_exchange_strong(expected, nullptr)) {
+            return;
+        }
+    }
+}
+
+bool inReservation(const u8 *addr) {
+    for (auto &slot : reservations) {
+        u8 *base = slot.load(std::memory_order_relaxed);
+        if (base && addr >= base && addr < base + LinearMemory::RESERVATION) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void onFault(int sig, siginfo_t *info, void *context) {
+    if (trap_target && inReservation(static_cast<const u8 *>(info->si_addr))) {
+        siglongjmp(*trap_target, 1);
+    }
+    // not a Wasm memory access: handled as without the runtime, which keeps its own handler
+    if (previous_action.sa_flags & SA_SIGINFO) {
+        previous_action.sa_sigaction(sig, info, context);
+    } else if (previous_action.sa_handler != SIG_DFL && previous_action.sa_handler != SIG_IGN) {
+        previous_action.sa_handler(sig);
+    } else {
+        // a fault cannot be ignored, the process ends with it once the access repeats
+        signal(sig, SIG_DFL);
+    }
+}
+
+void installFaultHandler() {
+    static std::once_flag installed;
+    std::call_once(installed, [] {
+        struct sigaction action{};
+        action.sa_sigaction = onFault;
+        action.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, &previous_action);
+    });
+}
+
+}
+
+struct LinearMemory::SharedState {
+    struct Waiter {
+        u64 address = 0;
+        bool woken = false;
+        std::condition_variable wake;
+    };
+
+    std::mutex grow_lock;
+    std::mutex wait_lock;       // guards waiters and the woken flags
+    std::list<Waiter *> waiters;   // in arrival order
+};
+
+LinearMemory::LinearMemory(u32 pages, u32 max_pages, bool shared)
+    : size_(size_t{pages} * WASM_PAGE_SIZE), max_pages_(std::min(max_pages, MAX_PAGES)),
+      shared_(shared ? std::make_unique<SharedState>() : nullptr) {
+    if (pages > max_pages_) {
+        throw std::runtime_error("initial memory exceeds its maximum");
+    }
+    void *region = mmap(nullptr, RESERVATION, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+        throw std::runtime_error("cannot reserve linear memory");
+    }
+    base_ = static_cast<u8 *>(region);
+    if (size() && mprotect(base_, size(), PROT_READ | PROT_WRITE) != 0) {
+        munmap(base_, RESERVATION);
+        throw std::runtime_error("cannot commit linear memory");
+    }
+    registerReservation(base_);
+}
+
+LinearMemory::LinearMemory(LinearMemory &&other) noexcept
+    : base_(other.base_), size_(other.size_.exchange(0)), max_pages_(other.max_pages_),
+      shared_(std::move(other.shared_)) {
+    other.base_ = nullptr;
+}
+
+LinearMemory &LinearMemory::operator=(LinearMemory &&other) noexcept {
+    std::swap(base_, other.base_);
+    size_ = other.size_.exchange(size_);
+    std::swap(max_pages_, other.max_pages_);
+    std::swap(shared_, other.shared_);
+    return *this;
+}
+
+LinearMemory::~LinearMemory() {
+    if (base_) {
+        unregisterReservation(base_);
+        munmap(base_, RESERVATION);
+    }
+}
+
+u32 LinearMemory::pages() const {
+    return static_cast<u32>(size() / WASM_PAGE_SIZE);
+}
+
+i32 LinearMemory::grow(u32 delta) {
+    std::unique_lock<std::mutex> lock;
+    if (shared_) {
+        lock = std::unique_lock(shared_->grow_lock);
+    }
+    u32 old_pages = pages();
+    if (delta > max_pages_ - old_pages) {
+        return -1;
+    }
+    // the new pages are already reserved and zero, only their protection changes
+    size_t bytes = size_t{delta} * WASM_PAGE_SIZE;
+    if (bytes && mprotect(base_ + size(), bytes, PROT_READ | PROT_WRITE) != 0) {
+        return -1;
+    }
+    // published after the pages are accessible, other threads may check bounds against it
+    size_.fetch_add(bytes, std::memory_order_release);
+    return static_cast<i32>(old_pages);
+}
+
+void LinearMemory::reset(u32 pages) {
+    size_t bytes = size_t{pages} * WASM_PAGE_SIZE;
+    size_t current = size();
+    // anonymous pages read as zero afterwards, pages mapped from the module file as the file
+    if (current && madvise(base_, current, MADV_DONTNEED) != 0) {
+        throw std::runtime_error("cannot reset linear memory");
+    }
+    if (current > bytes && mprotect(base_ + bytes, current - bytes, PROT_NONE) != 0) {
+        throw std::runtime_error("cannot reset linear memory");
+    }
+    if (current < bytes && mprotect(base_ + current, bytes - current, PROT_READ | PROT_WRITE) != 0) {
+        throw std::runtime_error("cannot reset linear memory");
+    }
+    size_.store(bytes, std::memory_order_release);
+}
+
+void LinearMemory::writeSegment(u64 offset, const u8 *data, size_t size, int fd, u64 file_offset) {
+    const u64 page = sysconf(_SC_PAGESIZE);
+    u64 first = (offset + page - 1) & ~(page - 1);
+    u64 last = (offset + size) & ~(page - 1);
+    if (fd < 0 || (offset - file_offset) % page != 0 || first >= last) {
+        std::memcpy(base_ + offset, data, size);
+        return;
+    }
+    void *mapped = mmap(base_ + first, last - first, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd,
+                        static_cast<off_t>(file_offset + (first - offset)));
+    if (mapped == MAP_FAILED) {
+        // a failed fixed mapping may have dropped the old pages, put zero pages back
+        if (mmap(base_ + first, last - first, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0) == MAP_FAILED) {
+            throw std::runtime_error("cannot map data segment");
+        }
+        std::memcpy(base_ + offset, data, size);
+        return;
+    }
+    std::memcpy(base_ + offset, data, first - offset);
+    std::memcpy(base_ + last, data + (last - offset), offset + size - last);
+}
+
+void LinearMemory::mapImage(int fd, u64 file_offset, u32 pages) {
+    if (pages > max_pages_) {
+        throw std::runtime_error("memory image exceeds the maximum size");
+    }
+    size_t bytes = size_t{pages} * WASM_PAGE_SIZE;
+    size_t current = size();
+    if (current > bytes) {
+        madvise(base_ + bytes, current - bytes, MADV_DONTNEED);
+        if (mprotect(base_ + bytes, current - bytes, PROT_NONE) != 0) {
+            throw std::runtime_error("cannot map memory image");
+        }
+    }
+    if (bytes && mmap(base_, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd,
+                      static_cast<off_t>(file_offset)) == MAP_FAILED) {
+        // keep the reservation whole, nothing else may be mapped into it
+        mmap(base_, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+        size_.store(0, std::memory_order_release);
+        throw std::runtime_error("cannot map memory image");
+    }
+    size_.store(bytes, std::memory_order_release);
+}
+
+void LinearMemory::checkRange(u64 address, u64 n) const {
+    if (address + n > size()) {
+        trapOutOfBounds();
+    }
+}
+
+void LinearMemory::copy(u32 dst, u32 src, u32 n) {
+    checkRange(dst, n);
+    checkRange(src, n);
+    std::memmove(base_ + dst, base_ + src, n);
+}
+
+void LinearMemory::fill(u32 dst, u8 value, u32 n) {
+    checkRange(dst, n);
+    std::memset(base_ + dst, value, n);
+}
+
+void LinearMemory::init(u32 dst, std::span<const u8> segment, u32 src, u32 n) {
+    checkRange(dst, n);
+    if (u64{src} + n > segment.size()) {
+        trapOutOfBounds();
+    }
+    if (n) {
+        // a dropped segment has no data at all
+        std::memcpy(base_ + dst, segment.data() + src, n);
+    }
+}
+
+u32 LinearMemory::wait(u64 address, u64 expected, u32 size, i64 timeout_ns) {
+    checkRange(address, size);
+    if (!shared_) {
+        throw std::runtime_error("wait on unshared memory");
+    }
+    // the value is read under the lock notify takes, so a store and notify in between cannot be missed
+    std::unique_lock lock(shared_->wait_lock);
+    u64 value = size == sizeof(u32) ? std::atomic_ref(*reinterpret_cast<u32 *>(base_ + address)).load()
+                                    : std::atomic_ref(*reinterpret_cast<u64 *>(base_ + address)).load();
+    if (size == sizeof(u32)) {
+        expected = static_cast<u32>(expected);
+    }
+    if (value != expected) {
+        return 1;
+    }
+    SharedState::Waiter waiter;
+    waiter.address = address;
+    auto entry = shared_->waiters.insert(shared_->waiters.end(), &waiter);
+    auto woken = [&waiter] { return waiter.woken; };
+    if (timeout_ns < 0) {
+        waiter.wake.wait(lock, woken);
+    } else if (!waiter.wake.wait_for(lock, std::chrono::nanoseconds(timeout_ns), woken)) {
+        shared_->waiters.erase(entry);
+        return 2;
+    }
+    return 0;
+}
+
+u32 LinearMemory::notify(u64 address, u32 count) {
+    checkRange(address, sizeof(u32));
+    if (!shared_) {
+        return 0;
+    }
+    std::lock_guard lock(shared_->wait_lock);
+    u32 woken = 0;
+    for (auto it = shared_->waiters.begin(); it != shared_->waiters.end() && woken < count;) {
+        SharedState::Waiter *waiter = *it;
+        if (waiter->address != address) {
+            ++it;
+            continue;
+        }
+        waiter->woken = true;
+        waiter->wake.notify_one();
+        it = shared_->waiters.erase(it);
+        ++woken;
+    }
+    return woken;
+}
+
+void runTrapping(const std::function<void()> &fn) {
+    installFaultHandler();
+    struct RestoreTarget {
+        sigjmp_buf *outer;
+        ~RestoreTarget() { trap_target = outer; }
+    } restore{trap_target};
+
+    sigjmp_buf target;
+    if (sigsetjmp(target, 1)) {
+        if (trap_error) {
+            std::rethrow_exception(std::exchange(trap_error, nullptr));
+        }
+        throw std::runtime_error("out of bounds memory access");
+    }
+    trap_target = &target;
+    fn();
+}
+
+void trapOutOfBounds() {
+    if (trap_target) {
+        siglongjmp(*trap_target, 1);
+    }
+    throw std::runtime_error("out of bounds memory access");
+}
+
+void trap(std::exception_ptr error) {
+    if (!trap_target) {
+        std::rethrow_exception(error);
+    }
+    trap_error = std::move(error);
+    siglongjmp(*trap_target, 1);
+}
+
+}
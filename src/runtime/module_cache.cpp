@@ -0,0 +1,461 @@
+#include "runtime/module_cache.hpp"
+#include "util/module_parser.hpp"
+#include "util/util.hpp"
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+#include <unordered_map>
+
+namespace omega::wass {
+
+namespace {
+
+// File layout: header, the module section by section, then the functions the module defines.
+// Vectors are a u64 count followed by their elements.
+constexpr char CACHE_MAGIC[8] = {'O', 'W', 'M', 'C', 'A', 'C', 'H', 'E'};
+// bumped whenever the layout, the bytecodes or their translation change
+constexpr u32 CACHE_FORMAT_VERSION = 1;
+// sizes of the dispatch tables, the stored opcodes index them
+constexpr size_t STACK_OPCODES = runtime::InternalBytecode::atomic_fence + 1;
+constexpr size_t REG_OPCODES = runtime::reg::return_ + 1;
+// stored instead of the handler of data slots
+constexpr uintptr_t NO_HANDLER = UINTPTR_MAX;
+
+struct CacheHeader {
+    char magic[8];
+    u32 version;
+    u32 tier;   // the functions were translated for, as CompiledModule settled it
+    u64 key;
+    u64 size;   // of the whole file, a shorter one was cut off
+};
+
+// Thrown by CacheReader when the file does not hold what it should
+struct CorruptCache {};
+
+class CacheWriter {
+public:
+    template<typename T>
+    void put(const T &value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        bytes_.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void putArray(const std::vector<T> &values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        put<u64>(values.size());
+        bytes_.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+    }
+
+    void putBytes(std::span<const u8> bytes) {
+        put<u64>(bytes.size());
+        bytes_.append(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    }
+
+    void putString(std::string_view s) {
+        put<u64>(s.size());
+        bytes_.append(s);
+    }
+
+    template<typename T, typename PutItem>
+    void putEach(const std::vector<T> &items, PutItem put_item) {
+        put<u64>(items.size());
+        for (auto &item : items) {
+            put_item(item);
+        }
+    }
+
+    std::string &bytes() { return bytes_; }
+private:
+    std::string bytes_;
+};
+
+class CacheReader {
+public:
+    CacheReader(const u8 *begin, const u8 *end) : p_(begin), end_(end) {}
+
+    template<typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    std::vector<T> getArray() {
+        u64 count = get<u64>();
+        if (count > remaining() / sizeof(T)) {
+            throw CorruptCache{};
+        }
+        std::vector<T> values(count);
+        if (count) {
+            std::memcpy(values.data(), take(count * sizeof(T)), count * sizeof(T));
+        }
+        return values;
+    }
+
+    // points into the file, which the module keeps mapped
+    std::span<const u8> getBytes() {
+        u64 size = get<u64>();
+        if (size > remaining()) {
+            throw CorruptCache{};
+        }
+        return {take(size), size};
+    }
+
+    std::string getString() {
+        u64 size = get<u64>();
+        if (size > remaining()) {
+            throw CorruptCache{};
+        }
+        return std::string(reinterpret_cast<const char *>(take(size)), size);
+    }
+
+    template<typename T, typename GetItem>
+    std::vector<T> getEach(GetItem get_item) {
+        u64 count = get<u64>();
+        // every item takes a byte at least, a bogus count fails before allocating
+        if (count > remaining()) {
+            throw CorruptCache{};
+        }
+        std::vector<T> items;
+        items.reserve(count);
+        for (u64 i = 0; i < count; ++i) {
+            items.push_back(get_item());
+        }
+        return items;
+    }
+
+    size_t remaining() const { return end_ - p_; }
+private:
+    const u8 *take(size_t size) {
+        if (size > remaining()) {
+            throw CorruptCache{};
+        }
+        const u8 *p = p_;
+        p_ += size;
+        return p;
+    }
+
+    const u8 *p_;
+    const u8 *end_;
+};
+
+void putSignature(CacheWriter &out, const module::FuncSignature &sig) {
+    out.putArray(sig.params);
+    out.putArray(sig.results);
+}
+
+module::FuncSignature getSignature(CacheReader &in) {
+    module::FuncSignature sig;
+    sig.params = in.getArray<ValType>();
+    sig.results = in.getArray<ValType>();
+    return sig;
+}
+
+void putModule(CacheWriter &out, const module::WasmModule &module) {
+    out.putEach(module.customSection, [&](const module::CustomSection &custom) {
+        out.putString(custom.name);
+        out.putArray(custom.data);
+    });
+    out.putEach(module.typesSection, [&](const module::FuncSignature &sig) { putSignature(out, sig); });
+    out.putEach(module.importSection, [&](const module::Import &import) {
+        out.putString(import.module);
+        out.putString(import.name);
+        out.put(import.kind);
+        switch (import.kind) {
+            case module::ImportKind::FUNC:   out.put(import.typeIndex); break;
+            case module::ImportKind::TABLE:  out.put(import.tableLimits); break;
+            case module::ImportKind::MEMORY: out.put(import.memLimits); break;
+            case module::ImportKind::GLOBAL: out.put(import.globalType); break;
+        }
+    });
+    out.putArray(module.functionSection);
+    out.putArray(module.tableSection);
+    out.putArray(module.memorySection);
+    out.putEach(module.globalSection, [&](const module::Global &global) {
+        out.put(global.valType);
+        out.put(global.mutable_);
+        out.putArray(global.initExpr);
+    });
+    out.putEach(module.exportSection, [&](const module::Export &exp) {
+        out.putString(exp.name);
+        out.put(exp.kind);
+        out.put(exp.index);
+    });
+    out.put(module.startSection);
+    out.putEach(module.elementSection, [&](const module::Element &element) {
+        out.put(element.tableIndex);
+        out.putArray(element.offsetExpr);
+        out.putArray(element.functionIndices);
+    });
+    out.putEach(module.codeSection, [&](const module::FunctionBody &body) {
+        out.putArray(body.locals);
+        out.putBytes(body.code);
+    });
+    out.putEach(module.dataSection, [&](const module::DataSegment &segment) {
+        out.put(segment.passive);
+        out.put(segment.memIndex);
+        out.putArray(segment.offsetExpr);
+        out.putBytes(segment.data);
+        out.put(segment.fileOffset);
+    });
+    out.put(module.dataCountSection);
+}
+
+module::WasmModule getModule(CacheReader &in) {
+    module::WasmModule module;
+    module.customSection = in.getEach<module::CustomSection>([&] {
+        module::CustomSection custom;
+        custom.name = in.getString();
+        custom.data = in.getArray<u8>();
+        return custom;
+    });
+    module.typesSection = in.getEach<module::FuncSignature>([&] { return getSignature(in); });
+    module.importSection = in.getEach<module::Import>([&] {
+        module::Import import{};
+        import.module = in.getString();
+        import.name = in.getString();
+        import.kind = in.get<module::ImportKind>();
+        switch (import.kind) {
+            case module::ImportKind::FUNC:   import.typeIndex = in.get<u32>(); break;
+            case module::ImportKind::TABLE:  import.tableLimits = in.get<module::Limits>(); break;
+            case module::ImportKind::MEMORY: import.memLimits = in.get<module::Limits>(); break;
+            case module::ImportKind::GLOBAL: import.globalType = in.get<decltype(import.globalType)>(); break;
+            default: throw CorruptCache{};
+        }
+        return import;
+    });
+    module.functionSection = in.getArray<module::FuncIndex>();
+    module.tableSection = in.getArray<module::TableType>();
+    module.memorySection = in.getArray<module::Limits>();
+    module.globalSection = in.getEach<module::Global>([&] {
+        module::Global global;
+        global.valType = in.get<ValType>();
+        global.mutable_ = in.get<MutableType>();
+        global.initExpr = in.getArray<u8>();
+        return global;
+    });
+    module.exportSection = in.getEach<module::Export>([&] {
+        module::Export exp;
+        exp.name = in.getString();
+        exp.kind = in.get<module::ExportKind>();
+        exp.index = in.get<u32>();
+        return exp;
+    });
+    module.startSection = in.get<module::StartSection>();
+    module.elementSection = in.getEach<module::Element>([&] {
+        module::Element element;
+        element.tableIndex = in.get<u32>();
+        element.offsetExpr = in.getArray<u8>();
+        element.functionIndices = in.getArray<u32>();
+        return element;
+    });
+    module.codeSection = in.getEach<module::FunctionBody>([&] {
+        module::FunctionBody body;
+        body.locals = in.getArray<module::LocalVar>();
+        body.code = in.getBytes();
+        return body;
+    });
+    module.dataSection = in.getEach<module::DataSegment>([&] {
+        module::DataSegment segment;
+        segment.passive = in.get<bool>();
+        segment.memIndex = in.get<u32>();
+        segment.offsetExpr = in.getArray<u8>();
+        segment.data = in.getBytes();
+        segment.fileOffset = in.get<u64>();
+        return segment;
+    });
+    module.dataCountSection = in.get<module::DataCountSection>();
+    return module;
+}
+
+// Opcode of every handler in the dispatch table, the lowest when several share one
+std::unordered_map<const void *, uintptr_t> opcodeMap(HandlerTable handlers, size_t count) {
+    std::unordered_map<const void *, uintptr_t> opcodes;
+    for (size_t op = 0; op < count; ++op) {
+        if (handlers[op]) {
+            opcodes.emplace(handlers[op], op);
+        }
+    }
+    return opcodes;
+}
+
+template<typename Instruction>
+std::vector<Instruction> withOpcodes(std::vector<Instruction> code,
+                                     const std::unordered_map<const void *, uintptr_t> &opcodes) {
+    for (auto &instr : code) {
+        uintptr_t opcode = NO_HANDLER;
+        if (instr.handler) {
+            auto it = opcodes.find(instr.handler);
+            if (it == opcodes.end()) {
+                throw std::runtime_error("module cache: handler outside the dispatch table");
+            }
+            opcode = it->second;
+        }
+        instr.handler = reinterpret_cast<const void *>(opcode);
+    }
+    return code;
+}
+
+template<typename Instruction>
+void withHandlers(std::vector<Instruction> &code, HandlerTable handlers, size_t count) {
+    for (auto &instr : code) {
+        auto opcode = reinterpret_cast<uintptr_t>(instr.handler);
+        if (opcode != NO_HANDLER && opcode >= count) {
+            throw CorruptCache{};
+        }
+        instr.handler = opcode == NO_HANDLER ? nullptr : handlers[opcode];
+    }
+}
+
+void putFunc(CacheWriter &out, const RuntimeFunction &f, const std::unordered_map<const void *, uintptr_t> &opcodes) {
+    putSignature(out, f.signature);
+    out.put(f.localsCount);
+    out.put(f.frameSize);
+    out.put(f.simd);
+    out.put<u64>(f.loopHotness.size());
+    out.putArray(withOpcodes(f.code, opcodes));
+    out.putArray(withOpcodes(f.regCode, opcodes));
+}
+
+RuntimeFunction getFunc(CacheReader &in, HandlerTable handlers, size_t count) {
+    RuntimeFunction f;
+    f.signature = getSignature(in);
+    f.localsCount = in.get<u32>();
+    f.frameSize = in.get<u32>();
+    f.simd = in.get<bool>();
+    u64 loops = in.get<u64>();
+    if (loops > in.remaining()) {
+        throw CorruptCache{};
+    }
+    f.loopHotness.assign(loops, 0);
+    f.code = in.getArray<Instr>();
+    withHandlers(f.code, handlers, count);
+    f.regCode = in.getArray<RegInstr>();
+    withHandlers(f.regCode, handlers, count);
+    return f;
+}
+
+// everything CompiledModule translates differently for goes into the key
+u64 cacheKey(const std::string &path, const RuntimeOptions &options) {
+    u64 inputs[] = {CACHE_FORMAT_VERSION, static_cast<u64>(options.tier), options.fuse, options.jit,
+                    options.tier_up, !options.aot_path.empty()};
+    return util::hashBytes(inputs, sizeof(inputs), util::hashFile(path));
+}
+
+std::shared_ptr<CompiledModule> readCache(const std::string &cache_path, u64 key, const std::string &module_path,
+                                          const RuntimeOptions &options,
+                                          HandlerTable stack_handlers, HandlerTable reg_handlers) {
+    std::shared_ptr<const util::MappedFile> file;
+    try {
+        file = std::make_shared<const util::MappedFile>(cache_path);
+    } catch (const std::runtime_error &) {
+        return nullptr;
+    }
+    std::span<const u8> bytes = file->bytes();
+    if (bytes.size() < sizeof(CacheHeader)) {
+        return nullptr;
+    }
+    CacheReader in(bytes.data(), bytes.data() + bytes.size());
+    auto header = in.get<CacheHeader>();
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_FORMAT_VERSION ||
+        header.key != key || header.size != bytes.size() || header.tier > static_cast<u32>(ExecTier::Register)) {
+        return nullptr;
+    }
+    module::WasmModule module;
+    FunctionsContainer defined;
+    try {
+        module = getModule(in);
+        bool reg = header.tier == static_cast<u32>(ExecTier::Register);
+        defined = in.getEach<RuntimeFunction>([&] {
+            return reg ? getFunc(in, reg_handlers, REG_OPCODES) : getFunc(in, stack_handlers, STACK_OPCODES);
+        });
+    } catch (const CorruptCache &) {
+        return nullptr;
+    }
+    if (defined.size() != module.codeSection.size()) {
+        return nullptr;
+    }
+    // data segments are mapped from the module file, which has the same contents
+    module.path = module_path;
+    // code and data segments point into the cache file
+    module.bytes = std::move(file);
+    // the tier as settled when the module was translated, so the bodies are not scanned again
+    return std::make_shared<CompiledModule>(std::move(module), options, static_cast<ExecTier>(header.tier),
+                                            std::move(defined));
+}
+
+void writeCache(const std::string &cache_path, u64 key, const CompiledModule &compiled,
+                HandlerTable stack_handlers, HandlerTable reg_handlers) {
+    bool reg = compiled.options().tier == ExecTier::Register;
+    auto opcodes = reg ? opcodeMap(reg_handlers, REG_OPCODES) : opcodeMap(stack_handlers, STACK_OPCODES);
+    CacheWriter out;
+    out.put(CacheHeader{});
+    putModule(out, compiled.module());
+    u32 imports = compiled.funcCount() - compiled.module().codeSection.size();
+    out.put<u64>(compiled.funcCount() - imports);
+    for (u32 f_ind = imports; f_ind < compiled.funcCount(); ++f_ind) {
+        putFunc(out, compiled.getFunc(f_ind), opcodes);
+    }
+    CacheHeader header{};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_FORMAT_VERSION;
+    header.tier = static_cast<u32>(compiled.options().tier);
+    header.key = key;
+    header.size = out.bytes().size();
+    std::memcpy(out.bytes().data(), &header, sizeof(header));
+
+    // concurrent loads of the same module write files of their own, the last rename wins
+    std::string tmp_path = cache_path + ".tmp" + std::to_string(getpid());
+    try {
+        {
+            std::ofstream file(tmp_path, std::ios::binary);
+            file.write(out.bytes().data(), out.bytes().size());
+            if (!file) {
+                throw std::runtime_error("module cache: cannot write " + tmp_path);
+            }
+        }
+        std::filesystem::rename(tmp_path, cache_path);
+    } catch (...) {
+        std::error_code ignored;
+        std::filesystem::remove(tmp_path, ignored);
+        throw;
+    }
+}
+
+}
+
+std::shared_ptr<CompiledModule> loadCompiledModule(std::string_view path, const RuntimeOptions &options,
+                                                   HandlerTable stack_handlers, HandlerTable reg_handlers) {
+    if (options.cache_dir.empty()) {
+        ModuleParser parser(path);
+        return std::make_shared<CompiledModule>(parser.parseFromFile(), options, stack_handlers, reg_handlers);
+    }
+    std::string module_path(path);
+    u64 key = cacheKey(module_path, options);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.owmc", static_cast<unsigned long long>(key));
+    std::string cache_path = (std::filesystem::path(options.cache_dir) / name).string();
+    if (auto compiled = readCache(cache_path, key, module_path, options, stack_handlers, reg_handlers)) {
+        return compiled;
+    }
+    // the cache keeps whole modules, a miss translates every function up front
+    RuntimeOptions eager = options;
+    eager.lazy = false;
+    ModuleParser parser(path);
+    auto compiled = std::make_shared<CompiledModule>(parser.parseFromFile(), eager, stack_handlers, reg_handlers);
+    try {
+        std::filesystem::create_directories(options.cache_dir);
+        writeCache(cache_path, key, *compiled, stack_handlers, reg_handlers);
+    } catch (const std::exception &) {
+        // a read-only or full cache directory only costs the next load its translation
+    }
+    return compiled;
+}
+
+}
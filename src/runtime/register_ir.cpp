@@ -0,0 +1,472 @@
+#include "runtime/register_ir.hpp"
+#include "util/util.hpp"
+#include <algorithm>
+
+namespace omega::wass {
+using namespace runtime;
+
+namespace {
+
+constexpr u32 NO_PC = UINT32_MAX;
+
+struct RegControl {
+    u8 op;
+    u32 height;              // operand stack height below the block parameters
+    BlockArity arity;
+    u32 start_pc;            // branch target of a loop
+    u32 else_patch;          // br_unless of an if, patched to the else branch
+    std::vector<u32> patches; // forward branches patched to the end of the block
+};
+
+class RegisterTranslator {
+public:
+    RegisterTranslator(const module::FuncSignature &sig, u32 locals_count, const ModuleTypes &types, HandlerTable handlers)
+        : sig_(sig), locals_(locals_count), types_(types), handlers_(handlers) {}
+
+    std::vector<RegInstr> translate(std::span<const u8> code, u32 &frame_size);
+private:
+    u32 slot(u32 height) const { return locals_ + height; }
+    u32 height() const { return vstack_.size(); }
+
+    u32 emit(u16 op, u32 dst = 0, u32 lhs = 0, u32 rhs = 0, i64 imm = 0) {
+        code_.push_back({.handler = handlers_[op], .imm = {.i = imm}, .dst = dst, .lhs = lhs, .rhs = rhs});
+        return code_.size() - 1;
+    }
+
+    // Emits an instruction producing a value into the next stack slot, which a following local.set may retarget
+    void emitDef(u16 op, u32 lhs = 0, u32 rhs = 0, i64 imm = 0) {
+        u32 dst = slot(height());
+        last_def_ = emit(op, dst, lhs, rhs, imm);
+        push(dst);
+    }
+
+    void push(u32 reg) {
+        vstack_.push_back(reg);
+        max_height_ = std::max(max_height_, height());
+    }
+
+    u32 pop() {
+        if (vstack_.empty()) {
+            throw std::runtime_error("operand stack underflow in function body");
+        }
+        u32 reg = vstack_.back();
+        vstack_.pop_back();
+        return reg;
+    }
+
+    void materialize(u32 pos) {
+        if (vstack_[pos] != slot(pos)) {
+            emit(reg::mov, slot(pos), vstack_[pos]);
+            vstack_[pos] = slot(pos);
+        }
+    }
+
+    void materializeAll() {
+        for (u32 i = 0; i < height(); ++i) {
+            materialize(i);
+        }
+        last_def_ = NO_PC;
+    }
+
+    void materializeLocal(u32 local) {
+        for (u32 i = 0; i < height(); ++i) {
+            if (vstack_[i] == local) {
+                materialize(i);
+                last_def_ = NO_PC;
+            }
+        }
+    }
+
+    void resetStack(u32 new_height) {
+        vstack_.clear();
+        for (u32 i = 0; i < new_height; ++i) {
+            push(slot(i));
+        }
+    }
+
+    void setLocal(u32 local);
+    void branch(u32 depth);
+    void branchIf(u32 cond, u32 depth);
+    void ret();
+    void enterBlock(const DecodedInstr &instr);
+    void endBlock();
+    void elseBlock();
+    void translateBrTable(u32 cond, const u8 *&ptr, const u8 *end, u32 count);
+    void translateOp(const DecodedInstr &instr);
+    void translateUnsupported(const DecodedInstr &instr);
+
+    const module::FuncSignature &sig_;
+    u32 locals_;
+    const ModuleTypes &types_;
+    HandlerTable handlers_;
+
+    std::vector<RegInstr> code_;
+    std::vector<u32> vstack_;     // register holding each operand stack value
+    std::vector<RegControl> controls_;
+    u32 max_height_ = 0;
+    u32 last_def_ = NO_PC;
+    bool dead_ = false;
+    u32 dead_depth_ = 0;
+};
+
+void RegisterTranslator::translateUnsupported(const DecodedInstr &instr) {
+    StackEffect effect = stackEffect(instr, types_);
+    materializeAll();
+    emit(reg::unsupported, 0, 0, 0, instr.op);
+    resetStack(height() - effect.pops + effect.pushes);
+}
+
+void RegisterTranslator::setLocal(u32 local) {
+    u32 val = vstack_.back();
+    // pending reads of the old local value below the top must keep it
+    for (u32 i = 0; i + 1 < height(); ++i) {
+        if (vstack_[i] == local) {
+            materialize(i);
+            last_def_ = NO_PC;
+        }
+    }
+    pop();
+    if (last_def_ == code_.size() - 1 && code_[last_def_].dst == val && val == slot(height())) {
+        code_[last_def_].dst = local;
+    } else if (val != local) {
+        emit(reg::mov, local, val);
+    }
+    last_def_ = NO_PC;
+}
+
+void RegisterTranslator::branch(u32 depth) {
+    materializeAll();
+    if (depth >= controls_.size()) {
+        throw std::runtime_error("branch depth out of range");
+    }
+    if (depth == controls_.size() - 1) {
+        ret();
+        return;
+    }
+    RegControl &target = controls_[controls_.size() - 1 - depth];
+    u32 arity = target.op == Bytecode::loop ? target.arity.params : target.arity.results;
+    u32 src = height() - arity;
+    if (src != target.height) {
+        emit(reg::copy, slot(target.height), slot(src), 0, arity);
+    }
+    if (target.op == Bytecode::loop) {
+        emit(reg::br, 0, 0, 0, target.start_pc);
+    } else {
+        target.patches.push_back(emit(reg::br));
+    }
+}
+
+void RegisterTranslator::branchIf(u32 cond, u32 depth) {
+    materializeAll();
+    if (depth >= controls_.size()) {
+        throw std::runtime_error("branch depth out of range");
+    }
+    RegControl &target = controls_[controls_.size() - 1 - depth];
+    u32 arity = target.op == Bytecode::loop ? target.arity.params : target.arity.results;
+    bool is_return = depth == controls_.size() - 1;
+    if (!is_return && height() - arity == target.height) {
+        if (target.op == Bytecode::loop) {
+            emit(reg::br_if, 0, cond, 0, target.start_pc);
+        } else {
+            target.patches.push_back(emit(reg::br_if, 0, cond));
+        }
+        return;
+    }
+    u32 skip = emit(reg::br_unless, 0, cond);
+    branch(depth);
+    code_[skip].imm.i = code_.size();
+}
+
+void RegisterTranslator::ret() {
+    materializeAll();
+    u32 results = sig_.results.size();
+    emit(reg::return_, 0, slot(height() - results));
+}
+
+void RegisterTranslator::enterBlock(const DecodedInstr &instr) {
+    BlockArity arity = blockArity(instr.imm.i, types_);
+    u32 else_patch = NO_PC;
+    if (instr.op == Bytecode::if_) {
+        u32 cond = pop();
+        materializeAll();
+        else_patch = emit(reg::br_unless, 0, cond);
+    } else {
+        materializeAll();
+    }
+    controls_.push_back({
+        .op = instr.op,
+        .height = height() - arity.params,
+        .arity = arity,
+        .start_pc = static_cast<u32>(code_.size()),
+        .else_patch = else_patch,
+        .patches = {}
+    });
+}
+
+void RegisterTranslator::elseBlock() {
+    RegControl &ctrl = controls_.back();
+    if (!dead_) {
+        materializeAll();
+        ctrl.patches.push_back(emit(reg::br));
+    }
+    code_[ctrl.else_patch].imm.i = code_.size();
+    ctrl.else_patch = NO_PC;
+    resetStack(ctrl.height + ctrl.arity.params);
+    last_def_ = NO_PC;
+    dead_ = false;
+}
+
+void RegisterTranslator::endBlock() {
+    if (!dead_) {
+        materializeAll();
+    }
+    RegControl ctrl = std::move(controls_.back());
+    controls_.pop_back();
+    if (controls_.empty()) {
+        // end of the function body
+        if (!dead_) {
+            ret();
+        }
+        return;
+    }
+    for (u32 pc : ctrl.patches) {
+        code_[pc].imm.i = code_.size();
+    }
+    if (ctrl.else_patch != NO_PC) {
+        code_[ctrl.else_patch].imm.i = code_.size();
+    }
+    resetStack(ctrl.height + ctrl.arity.results);
+    last_def_ = NO_PC;
+    dead_ = false;
+}
+
+void RegisterTranslator::translateBrTable(u32 cond, const u8 *&ptr, const u8 *end, u32 count) {
+    materializeAll();
+    std::vector<u32> depths;
+    for (u32 i = 0; i <= count; ++i) {
+        depths.push_back(util::readULEB128(ptr, end));
+    }
+    u32 table = emit(reg::br_table, 0, cond, 0, count);
+    for (u32 i = 0; i <= count; ++i) {
+        emit(reg::br);
+    }
+    // every label gets a stub moving the branch values into place
+    std::vector<u32> vstack = vstack_;
+    for (u32 i = 0; i <= count; ++i) {
+        code_[table + 1 + i].imm.i = code_.size();
+        vstack_ = vstack;
+        branch(depths[i]);
+    }
+}
+
+void RegisterTranslator::translateOp(const DecodedInstr &instr) {
+    switch (instr.op) {
+        case Bytecode::nop:
+            break;
+        case Bytecode::unreachable:
+            materializeAll();
+            emit(reg::unreachable);
+            dead_ = true;
+            break;
+        case Bytecode::local_get:
+            push(instr.imm.i);
+            break;
+        case Bytecode::local_set:
+            setLocal(instr.imm.i);
+            break;
+        case Bytecode::local_tee:
+            setLocal(instr.imm.i);
+            push(instr.imm.i);
+            break;
+        case Bytecode::drop:
+            pop();
+            last_def_ = NO_PC;
+            break;
+        case Bytecode::select: {
+            u32 cond = pop();
+            u32 rhs = pop();
+            u32 lhs = pop();
+            emitDef(reg::select, lhs, rhs, cond);
+            break;
+        }
+        case Bytecode::i32_const:
+            emitDef(reg::i32_const, 0, 0, instr.imm.i);
+            break;
+        case Bytecode::i32_add:
+        case Bytecode::i32_sub:
+        case Bytecode::i32_and:
+        case Bytecode::i32_ne:
+        case Bytecode::i32_lt_s: {
+            u32 rhs = pop();
+            u32 lhs = pop();
+            u16 op = instr.op == Bytecode::i32_add ? reg::i32_add :
+                     instr.op == Bytecode::i32_sub ? reg::i32_sub :
+                     instr.op == Bytecode::i32_and ? reg::i32_and :
+                     instr.op == Bytecode::i32_ne ? reg::i32_ne : reg::i32_lt_s;
+            emitDef(op, lhs, rhs);
+            break;
+        }
+        case Bytecode::i32_load:
+        case Bytecode::i64_load:
+        case Bytecode::f32_load:
+        case Bytecode::f64_load:
+        case Bytecode::i32_load8_s:
+        case Bytecode::i32_load8_u:
+        case Bytecode::i32_load16_s:
+        case Bytecode::i32_load16_u:
+        case Bytecode::i64_load8_s:
+        case Bytecode::i64_load8_u:
+        case Bytecode::i64_load16_s:
+        case Bytecode::i64_load16_u:
+        case Bytecode::i64_load32_s:
+        case Bytecode::i64_load32_u: {
+            u32 addr = pop();
+            emitDef(reg::i32_load + (instr.op - Bytecode::i32_load), addr, 0, instr.imm.i);
+            break;
+        }
+        case Bytecode::i32_store:
+        case Bytecode::i64_store:
+        case Bytecode::f32_store:
+        case Bytecode::f64_store:
+        case Bytecode::i32_store8:
+        case Bytecode::i32_store16:
+        case Bytecode::i64_store8:
+        case Bytecode::i64_store16:
+        case Bytecode::i64_store32: {
+            u32 value = pop();
+            u32 addr = pop();
+            emit(reg::i32_store + (instr.op - Bytecode::i32_store), 0, addr, value, instr.imm.i);
+            last_def_ = NO_PC;
+            break;
+        }
+        case Bytecode::memory_size:
+            emitDef(reg::memory_size, 0, 0);
+            break;
+        case Bytecode::memory_grow: {
+            u32 delta = pop();
+            emitDef(reg::memory_grow, delta);
+            break;
+        }
+        case prefix::misc:
+            if (instr.sub_op == misc::data_drop) {
+                emit(reg::data_drop, 0, 0, 0, instr.imm.i);
+                break;
+            }
+            if (instr.sub_op == misc::memory_init || instr.sub_op == misc::memory_copy ||
+                instr.sub_op == misc::memory_fill) {
+                u32 n = pop();
+                u32 src = pop();
+                u32 dst = pop();
+                emit(reg::memory_init + (instr.sub_op - misc::memory_init), dst, src, n, instr.imm.i);
+                last_def_ = NO_PC;
+                break;
+            }
+            translateUnsupported(instr);
+            break;
+        case Bytecode::call: {
+            StackEffect effect = stackEffect(instr, types_);
+            materializeAll();
+            u32 base = height() - effect.pops;
+            emit(reg::call, slot(base), 0, 0, instr.imm.i);
+            resetStack(base + effect.pushes);
+            break;
+        }
+        default:
+            translateUnsupported(instr);
+            break;
+    }
+}
+
+std::vector<RegInstr> RegisterTranslator::translate(std::span<const u8> code, u32 &frame_size) {
+    controls_.push_back({
+        .op = Bytecode::block,
+        .height = 0,
+        .arity = {0, static_cast<u32>(sig_.results.size())},
+        .start_pc = 0,
+        .else_patch = NO_PC,
+        .patches = {}
+    });
+
+    const u8 *ptr = code.data();
+    const u8 *end = ptr + code.size();
+    while (ptr < end && !controls_.empty()) {
+        DecodedInstr instr = decodeInstr(ptr, end);
+
+        if (dead_) {
+            // unreachable code is skipped, only its nesting is tracked
+            switch (instr.op) {
+                case Bytecode::block:
+                case Bytecode::loop:
+                case Bytecode::if_:
+                    ++dead_depth_;
+                    continue;
+                case Bytecode::br_table:
+                    for (i64 i = 0; i <= instr.imm.i; ++i) {
+                        util::readULEB128(ptr, end);
+                    }
+                    continue;
+                case Bytecode::end:
+                    if (dead_depth_ > 0) {
+                        --dead_depth_;
+                        continue;
+                    }
+                    break;
+                case Bytecode::else_:
+                    if (dead_depth_ > 0) {
+                        continue;
+                    }
+                    break;
+                default:
+                    continue;
+            }
+        }
+
+        switch (instr.op) {
+            case Bytecode::block:
+            case Bytecode::loop:
+            case Bytecode::if_:
+                enterBlock(instr);
+                break;
+            case Bytecode::else_:
+                elseBlock();
+                break;
+            case Bytecode::end:
+                endBlock();
+                break;
+            case Bytecode::br:
+                branch(instr.imm.i);
+                dead_ = true;
+                break;
+            case Bytecode::br_if:
+                branchIf(pop(), instr.imm.i);
+                break;
+            case Bytecode::br_table:
+                translateBrTable(pop(), ptr, end, instr.imm.i);
+                dead_ = true;
+                break;
+            case Bytecode::return_:
+                ret();
+                dead_ = true;
+                break;
+            default:
+                translateOp(instr);
+                break;
+        }
+    }
+    frame_size = locals_ + max_height_;
+    return std::move(code_);
+}
+
+}
+
+std::vector<RegInstr> translateRegisterCode(std::span<const u8> code,
+                                            const module::FuncSignature &sig,
+                                            u32 locals_count,
+                                            const ModuleTypes &types,
+                                            HandlerTable handlers,
+                                            u32 &frame_size) {
+    RegisterTranslator translator(sig, locals_count, types, handlers);
+    return translator.translate(code, frame_size);
+}
+
+}
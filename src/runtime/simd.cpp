@@ -0,0 +1,749 @@
+#include "runtime/simd.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+namespace omega::wass::simd {
+
+namespace {
+
+using i8 = int8_t;
+using i16 = int16_t;
+
+constexpr std::array<OpInfo, 256> makeOpInfo() {
+    std::array<OpInfo, 256> info{};
+    auto set = [&info](u32 first, u32 last, Shape shape) {
+        for (u32 op = first; op <= last; ++op) {
+            info[op] = {shape, ValType::V128, 0, 0};
+        }
+    };
+    auto memory = [&info](u32 op, Shape shape, u8 size, u8 lanes) { info[op] = {shape, ValType::V128, lanes, size}; };
+    auto lane = [&info](u32 op, Shape shape, ValType scalar, u8 lanes) { info[op] = {shape, scalar, lanes, 0}; };
+
+    memory(0, Shape::Load, 16, 0);
+    for (u32 op = 1; op <= 6; ++op) {
+        memory(op, Shape::Load, 8, 0);            // v128.load8x8_s ... v128.load32x2_u
+    }
+    memory(7, Shape::Load, 1, 0);                 // v128.load8_splat
+    memory(8, Shape::Load, 2, 0);
+    memory(9, Shape::Load, 4, 0);
+    memory(10, Shape::Load, 8, 0);
+    memory(11, Shape::Store, 16, 0);
+    set(12, 12, Shape::Const);
+    set(13, 13, Shape::Shuffle);
+    set(14, 14, Shape::Binary);                   // i8x16.swizzle
+    lane(15, Shape::Splat, I32, 0);
+    lane(16, Shape::Splat, I32, 0);
+    lane(17, Shape::Splat, I32, 0);
+    lane(18, Shape::Splat, I64, 0);
+    lane(19, Shape::Splat, F32, 0);
+    lane(20, Shape::Splat, F64, 0);
+    lane(21, Shape::ExtractLane, I32, 16);
+    lane(22, Shape::ExtractLane, I32, 16);
+    lane(23, Shape::ReplaceLane, I32, 16);
+    lane(24, Shape::ExtractLane, I32, 8);
+    lane(25, Shape::ExtractLane, I32, 8);
+    lane(26, Shape::ReplaceLane, I32, 8);
+    lane(27, Shape::ExtractLane, I32, 4);
+    lane(28, Shape::ReplaceLane, I32, 4);
+    lane(29, Shape::ExtractLane, I64, 2);
+    lane(30, Shape::ReplaceLane, I64, 2);
+    lane(31, Shape::ExtractLane, F32, 4);
+    lane(32, Shape::ReplaceLane, F32, 4);
+    lane(33, Shape::ExtractLane, F64, 2);
+    lane(34, Shape::ReplaceLane, F64, 2);
+    set(35, 76, Shape::Binary);                   // comparisons
+    set(77, 77, Shape::Unary);                    // v128.not
+    set(78, 81, Shape::Binary);
+    set(82, 82, Shape::Ternary);                  // v128.bitselect
+    set(83, 83, Shape::Test);                     // v128.any_true
+    for (u32 i = 0; i < 4; ++i) {
+        u8 size = 1 << i;
+        memory(84 + i, Shape::LoadLane, size, 16 / size);
+        memory(88 + i, Shape::StoreLane, size, 16 / size);
+    }
+    memory(92, Shape::Load, 4, 0);                // v128.load32_zero
+    memory(93, Shape::Load, 8, 0);
+    set(94, 98, Shape::Unary);
+    set(99, 100, Shape::Test);
+    set(101, 102, Shape::Binary);
+    set(103, 106, Shape::Unary);
+    set(107, 109, Shape::Shift);
+    set(110, 115, Shape::Binary);
+    set(116, 117, Shape::Unary);
+    set(118, 121, Shape::Binary);
+    set(122, 122, Shape::Unary);
+    set(123, 123, Shape::Binary);
+    set(124, 129, Shape::Unary);
+    set(130, 130, Shape::Binary);
+    set(131, 132, Shape::Test);
+    set(133, 134, Shape::Binary);
+    set(135, 138, Shape::Unary);
+    set(139, 141, Shape::Shift);
+    set(142, 147, Shape::Binary);
+    set(148, 148, Shape::Unary);
+    set(149, 153, Shape::Binary);
+    set(155, 159, Shape::Binary);
+    set(160, 161, Shape::Unary);
+    set(163, 164, Shape::Test);
+    set(167, 170, Shape::Unary);
+    set(171, 173, Shape::Shift);
+    set(174, 174, Shape::Binary);
+    set(177, 177, Shape::Binary);
+    set(181, 186, Shape::Binary);
+    set(188, 191, Shape::Binary);
+    set(192, 193, Shape::Unary);
+    set(195, 196, Shape::Test);
+    set(199, 202, Shape::Unary);
+    set(203, 205, Shape::Shift);
+    set(206, 206, Shape::Binary);
+    set(209, 209, Shape::Binary);
+    set(213, 223, Shape::Binary);
+    set(224, 225, Shape::Unary);
+    set(227, 227, Shape::Unary);
+    set(228, 235, Shape::Binary);
+    set(236, 237, Shape::Unary);
+    set(239, 239, Shape::Unary);
+    set(240, 247, Shape::Binary);
+    set(248, 255, Shape::Unary);
+    return info;
+}
+
+constexpr std::array<OpInfo, 256> OP_INFO = makeOpInfo();
+constexpr OpInfo UNKNOWN_OP{Shape::None, ValType::V128, 0, 0};
+
+template <typename T>
+using Lanes = std::array<T, 16 / sizeof(T)>;
+
+// integer lane of the same width, all ones where a comparison holds
+template <typename T>
+using Mask = std::conditional_t<sizeof(T) == 1, i8,
+             std::conditional_t<sizeof(T) == 2, i16,
+             std::conditional_t<sizeof(T) == 4, i32, i64>>>;
+
+// lane arithmetic wraps, narrow lanes are computed in u32 to stay clear of int overflow
+template <typename T>
+using Wide = std::conditional_t<(sizeof(T) < 4), u32, std::make_unsigned_t<T>>;
+
+template <typename T>
+Lanes<T> lanes(V128 v) {
+    Lanes<T> l;
+    std::memcpy(l.data(), &v, sizeof(v));
+    return l;
+}
+
+template <typename T>
+V128 vec(const Lanes<T> &l) {
+    V128 v;
+    std::memcpy(&v, l.data(), sizeof(v));
+    return v;
+}
+
+template <typename T>
+T saturate(i64 v) {
+    return static_cast<T>(std::clamp<i64>(v, std::numeric_limits<T>::min(), std::numeric_limits<T>::max()));
+}
+
+inline __m128 ps(V128 v) { return _mm_castsi128_ps(v); }
+inline __m128d pd(V128 v) { return _mm_castsi128_pd(v); }
+inline V128 bits(__m128 v) { return _mm_castps_si128(v); }
+inline V128 bits(__m128d v) { return _mm_castpd_si128(v); }
+
+// Lane operations of the generic kernels
+
+struct Add { template <typename T> T operator()(T a, T b) const { return static_cast<T>(Wide<T>(a) + Wide<T>(b)); } };
+struct Sub { template <typename T> T operator()(T a, T b) const { return static_cast<T>(Wide<T>(a) - Wide<T>(b)); } };
+struct Mul { template <typename T> T operator()(T a, T b) const { return static_cast<T>(Wide<T>(a) * Wide<T>(b)); } };
+struct Min { template <typename T> T operator()(T a, T b) const { return std::min(a, b); } };
+struct Max { template <typename T> T operator()(T a, T b) const { return std::max(a, b); } };
+struct Neg { template <typename T> T operator()(T a) const { return static_cast<T>(Wide<T>(0) - Wide<T>(a)); } };
+struct Abs { template <typename T> T operator()(T a) const { return a < 0 ? Neg{}(a) : a; } };
+struct Popcnt { u8 operator()(u8 a) const { return std::popcount(a); } };
+struct Ceil { template <typename T> T operator()(T a) const { return std::ceil(a); } };
+struct Floor { template <typename T> T operator()(T a) const { return std::floor(a); } };
+struct Trunc { template <typename T> T operator()(T a) const { return std::trunc(a); } };
+struct Nearest { template <typename T> T operator()(T a) const { return std::nearbyint(a); } };
+struct Shl { template <typename T> T operator()(T a, u32 count) const { return static_cast<T>(Wide<T>(a) << count); } };
+struct Shr { template <typename T> T operator()(T a, u32 count) const { return static_cast<T>(a >> count); } };
+
+// i16x8.q15mulr_sat_s
+struct Q15MulrSat {
+    i16 operator()(i16 a, i16 b) const { return saturate<i16>((i32{a} * b + 0x4000) >> 15); }
+};
+
+// Float min and max propagate NaN and order -0 below +0, unlike minps and maxps
+struct FMin {
+    template <typename T>
+    T operator()(T a, T b) const {
+        if (std::isnan(a) || std::isnan(b)) {
+            return a + b;
+        }
+        if (a == b) {
+            return std::signbit(a) ? a : b;
+        }
+        return a < b ? a : b;
+    }
+};
+
+struct FMax {
+    template <typename T>
+    T operator()(T a, T b) const {
+        if (std::isnan(a) || std::isnan(b)) {
+            return a + b;
+        }
+        if (a == b) {
+            return std::signbit(a) ? b : a;
+        }
+        return a > b ? a : b;
+    }
+};
+
+// Generic kernels, for the opcodes without a short instruction sequence
+
+template <typename T, typename Op>
+V128 lanewise(V128 a) {
+    Lanes<T> l = lanes<T>(a);
+    for (T &x : l) {
+        x = Op{}(x);
+    }
+    return vec<T>(l);
+}
+
+template <typename T, typename Op>
+V128 lanewise(V128 a, V128 b) {
+    Lanes<T> x = lanes<T>(a);
+    Lanes<T> y = lanes<T>(b);
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = Op{}(x[i], y[i]);
+    }
+    return vec<T>(x);
+}
+
+template <typename T, typename Op>
+V128 compare(V128 a, V128 b) {
+    Lanes<T> x = lanes<T>(a);
+    Lanes<T> y = lanes<T>(b);
+    Lanes<Mask<T>> r;
+    for (size_t i = 0; i < r.size(); ++i) {
+        r[i] = Op{}(x[i], y[i]) ? Mask<T>(-1) : Mask<T>(0);
+    }
+    return vec<Mask<T>>(r);
+}
+
+template <typename T, typename Op>
+V128 shift(V128 a, u32 count) {
+    Lanes<T> l = lanes<T>(a);
+    for (T &x : l) {
+        x = Op{}(x, count & (sizeof(T) * 8 - 1));
+    }
+    return vec<T>(l);
+}
+
+// Lane conversion starting at input lane first, output lanes without an input stay zero
+template <typename From, typename To, size_t First = 0>
+V128 convert(V128 a) {
+    Lanes<From> x = lanes<From>(a);
+    Lanes<To> r{};
+    for (size_t i = 0; i < r.size() && First + i < x.size(); ++i) {
+        r[i] = static_cast<To>(x[First + i]);
+    }
+    return vec<To>(r);
+}
+
+template <typename From, typename To>
+V128 truncSat(V128 a) {
+    Lanes<From> x = lanes<From>(a);
+    Lanes<To> r{};
+    for (size_t i = 0; i < x.size(); ++i) {
+        From v = x[i];
+        if (std::isnan(v)) {
+            r[i] = 0;
+        } else if (v <= static_cast<From>(std::numeric_limits<To>::min())) {
+            r[i] = std::numeric_limits<To>::min();
+        } else if (v >= static_cast<From>(std::numeric_limits<To>::max())) {
+            r[i] = std::numeric_limits<To>::max();
+        } else {
+            r[i] = static_cast<To>(v);
+        }
+    }
+    return vec<To>(r);
+}
+
+template <typename From, typename To>
+V128 narrow(V128 a, V128 b) {
+    Lanes<From> x = lanes<From>(a);
+    Lanes<From> y = lanes<From>(b);
+    Lanes<To> r;
+    for (size_t i = 0; i < x.size(); ++i) {
+        r[i] = saturate<To>(x[i]);
+        r[x.size() + i] = saturate<To>(y[i]);
+    }
+    return vec<To>(r);
+}
+
+template <typename From, typename To>
+V128 extaddPairwise(V128 a) {
+    Lanes<From> x = lanes<From>(a);
+    Lanes<To> r;
+    for (size_t i = 0; i < r.size(); ++i) {
+        r[i] = static_cast<To>(x[2 * i] + x[2 * i + 1]);
+    }
+    return vec<To>(r);
+}
+
+template <typename From, typename To, size_t First>
+V128 extmul(V128 a, V128 b) {
+    Lanes<From> x = lanes<From>(a);
+    Lanes<From> y = lanes<From>(b);
+    Lanes<To> r;
+    for (size_t i = 0; i < r.size(); ++i) {
+        r[i] = Mul{}(static_cast<To>(x[First + i]), static_cast<To>(y[First + i]));
+    }
+    return vec<To>(r);
+}
+
+template <typename T>
+i32 allTrue(V128 a) {
+    for (T x : lanes<T>(a)) {
+        if (x == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+template <typename T>
+V128 splat(WasmVal x) {
+    Lanes<T> l;
+    if constexpr (std::is_floating_point_v<T>) {
+        l.fill(static_cast<T>(x.f));
+    } else {
+        l.fill(static_cast<T>(x.i));
+    }
+    return vec<T>(l);
+}
+
+template <typename T>
+WasmVal extractLane(V128 a, u32 lane) {
+    T value = lanes<T>(a)[lane];
+    WasmVal r;
+    if constexpr (std::is_floating_point_v<T>) {
+        r.f = value;
+    } else {
+        r.i = value;
+    }
+    return r;
+}
+
+template <typename T>
+V128 replaceLane(V128 a, WasmVal x, u32 lane) {
+    Lanes<T> l = lanes<T>(a);
+    if constexpr (std::is_floating_point_v<T>) {
+        l[lane] = static_cast<T>(x.f);
+    } else {
+        l[lane] = static_cast<T>(x.i);
+    }
+    return vec<T>(l);
+}
+
+V128 shuffle(V128 a, V128 b, V128 mask) {
+    Lanes<u8> x = lanes<u8>(a);
+    Lanes<u8> y = lanes<u8>(b);
+    Lanes<u8> m = lanes<u8>(mask);
+    Lanes<u8> r;
+    for (size_t i = 0; i < r.size(); ++i) {
+        r[i] = m[i] < 16 ? x[m[i]] : y[m[i] - 16];
+    }
+    return vec<u8>(r);
+}
+
+V128 swizzle(V128 a, V128 indices) {
+    Lanes<u8> x = lanes<u8>(a);
+    Lanes<u8> m = lanes<u8>(indices);
+    Lanes<u8> r;
+    for (size_t i = 0; i < r.size(); ++i) {
+        r[i] = m[i] < 16 ? x[m[i]] : 0;
+    }
+    return vec<u8>(r);
+}
+
+// Comparisons of the generic table, signed ones with SSE2 instructions where they exist
+template <typename T>
+void setCompares(std::array<Kernel, 256> &k, u32 first) {
+    using S = std::make_signed_t<T>;
+    using U = std::make_unsigned_t<T>;
+    k[first].binary = compare<S, std::equal_to<>>;
+    k[first + 1].binary = compare<S, std::not_equal_to<>>;
+    k[first + 2].binary = compare<S, std::less<>>;
+    k[first + 3].binary = compare<U, std::less<>>;
+    k[first + 4].binary = compare<S, std::greater<>>;
+    k[first + 5].binary = compare<U, std::greater<>>;
+    k[first + 6].binary = compare<S, std::less_equal<>>;
+    k[first + 7].binary = compare<U, std::less_equal<>>;
+    k[first + 8].binary = compare<S, std::greater_equal<>>;
+    k[first + 9].binary = compare<U, std::greater_equal<>>;
+}
+
+std::array<Kernel, 256> baselineKernels() {
+    std::array<Kernel, 256> k{};
+
+    k[7].unary = [](V128 a) { return _mm_set1_epi8(static_cast<char>(low(a))); };
+    k[8].unary = [](V128 a) { return _mm_set1_epi16(static_cast<i16>(low(a))); };
+    k[9].unary = [](V128 a) { return _mm_shuffle_epi32(a, 0); };
+    k[10].unary = [](V128 a) { return _mm_unpacklo_epi64(a, a); };
+    k[92].unary = [](V128 a) { return a; };   // the load already left the upper lanes zero
+    k[93].unary = k[92].unary;
+
+    k[13].ternary = shuffle;
+    k[14].binary = swizzle;
+    k[15].splat = [](WasmVal x) { return _mm_set1_epi8(static_cast<char>(x.i)); };
+    k[16].splat = [](WasmVal x) { return _mm_set1_epi16(static_cast<i16>(x.i)); };
+    k[17].splat = [](WasmVal x) { return _mm_set1_epi32(static_cast<i32>(x.i)); };
+    k[18].splat = [](WasmVal x) { return _mm_set1_epi64x(x.i); };
+    k[19].splat = [](WasmVal x) { return bits(_mm_set1_ps(static_cast<f32>(x.f))); };
+    k[20].splat = [](WasmVal x) { return bits(_mm_set1_pd(x.f)); };
+    k[21].extract = extractLane<i8>;
+    k[22].extract = extractLane<u8>;
+    k[23].replace = replaceLane<i8>;
+    k[24].extract = extractLane<i16>;
+    k[25].extract = extractLane<u16>;
+    k[26].replace = replaceLane<i16>;
+    k[27].extract = extractLane<i32>;
+    k[28].replace = replaceLane<i32>;
+    k[29].extract = extractLane<i64>;
+    k[30].replace = replaceLane<i64>;
+    k[31].extract = extractLane<f32>;
+    k[32].replace = replaceLane<f32>;
+    k[33].extract = extractLane<f64>;
+    k[34].replace = replaceLane<f64>;
+
+    setCompares<i8>(k, 35);
+    setCompares<i16>(k, 45);
+    setCompares<i32>(k, 55);
+    k[35].binary = [](V128 a, V128 b) { return _mm_cmpeq_epi8(a, b); };
+    k[37].binary = [](V128 a, V128 b) { return _mm_cmplt_epi8(a, b); };
+    k[39].binary = [](V128 a, V128 b) { return _mm_cmpgt_epi8(a, b); };
+    k[45].binary = [](V128 a, V128 b) { return _mm_cmpeq_epi16(a, b); };
+    k[47].binary = [](V128 a, V128 b) { return _mm_cmplt_epi16(a, b); };
+    k[49].binary = [](V128 a, V128 b) { return _mm_cmpgt_epi16(a, b); };
+    k[55].binary = [](V128 a, V128 b) { return _mm_cmpeq_epi32(a, b); };
+    k[57].binary = [](V128 a, V128 b) { return _mm_cmplt_epi32(a, b); };
+    k[59].binary = [](V128 a, V128 b) { return _mm_cmpgt_epi32(a, b); };
+    k[65].binary = [](V128 a, V128 b) { return bits(_mm_cmpeq_ps(ps(a), ps(b))); };
+    k[66].binary = [](V128 a, V128 b) { return bits(_mm_cmpneq_ps(ps(a), ps(b))); };
+    k[67].binary = [](V128 a, V128 b) { return bits(_mm_cmplt_ps(ps(a), ps(b))); };
+    k[68].binary = [](V128 a, V128 b) { return bits(_mm_cmpgt_ps(ps(a), ps(b))); };
+    k[69].binary = [](V128 a, V128 b) { return bits(_mm_cmple_ps(ps(a), ps(b))); };
+    k[70].binary = [](V128 a, V128 b) { return bits(_mm_cmpge_ps(ps(a), ps(b))); };
+    k[71].binary = [](V128 a, V128 b) { return bits(_mm_cmpeq_pd(pd(a), pd(b))); };
+    k[72].binary = [](V128 a, V128 b) { return bits(_mm_cmpneq_pd(pd(a), pd(b))); };
+    k[73].binary = [](V128 a, V128 b) { return bits(_mm_cmplt_pd(pd(a), pd(b))); };
+    k[74].binary = [](V128 a, V128 b) { return bits(_mm_cmpgt_pd(pd(a), pd(b))); };
+    k[75].binary = [](V128 a, V128 b) { return bits(_mm_cmple_pd(pd(a), pd(b))); };
+    k[76].binary = [](V128 a, V128 b) { return bits(_mm_cmpge_pd(pd(a), pd(b))); };
+
+    k[77].unary = [](V128 a) { return _mm_xor_si128(a, _mm_set1_epi32(-1)); };
+    k[78].binary = [](V128 a, V128 b) { return _mm_and_si128(a, b); };
+    k[79].binary = [](V128 a, V128 b) { return _mm_andnot_si128(b, a); };
+    k[80].binary = [](V128 a, V128 b) { return _mm_or_si128(a, b); };
+    k[81].binary = [](V128 a, V128 b) { return _mm_xor_si128(a, b); };
+    k[82].ternary = [](V128 a, V128 b, V128 c) { return _mm_or_si128(_mm_and_si128(a, c), _mm_andnot_si128(c, b)); };
+    k[83].test = [](V128 a) { return i32{_mm_movemask_epi8(_mm_cmpeq_epi8(a, _mm_setzero_si128())) != 0xFFFF}; };
+    k[94].unary = [](V128 a) { return bits(_mm_cvtpd_ps(pd(a))); };
+    k[95].unary = [](V128 a) { return bits(_mm_cvtps_pd(ps(a))); };
+
+    // i8x16
+    k[96].unary = lanewise<i8, Abs>;
+    k[97].unary = [](V128 a) { return _mm_sub_epi8(_mm_setzero_si128(), a); };
+    k[98].unary = lanewise<u8, Popcnt>;
+    k[99].test = [](V128 a) { return i32{_mm_movemask_epi8(_mm_cmpeq_epi8(a, _mm_setzero_si128())) == 0}; };
+    k[100].test = [](V128 a) { return _mm_movemask_epi8(a); };
+    k[101].binary = [](V128 a, V128 b) { return _mm_packs_epi16(a, b); };
+    k[102].binary = [](V128 a, V128 b) { return _mm_packus_epi16(a, b); };
+    k[103].unary = lanewise<f32, Ceil>;
+    k[104].unary = lanewise<f32, Floor>;
+    k[105].unary = lanewise<f32, Trunc>;
+    k[106].unary = lanewise<f32, Nearest>;
+    k[107].shift = shift<u8, Shl>;
+    k[108].shift = shift<i8, Shr>;
+    k[109].shift = shift<u8, Shr>;
+    k[110].binary = [](V128 a, V128 b) { return _mm_add_epi8(a, b); };
+    k[111].binary = [](V128 a, V128 b) { return _mm_adds_epi8(a, b); };
+    k[112].binary = [](V128 a, V128 b) { return _mm_adds_epu8(a, b); };
+    k[113].binary = [](V128 a, V128 b) { return _mm_sub_epi8(a, b); };
+    k[114].binary = [](V128 a, V128 b) { return _mm_subs_epi8(a, b); };
+    k[115].binary = [](V128 a, V128 b) { return _mm_subs_epu8(a, b); };
+    k[116].unary = lanewise<f64, Ceil>;
+    k[117].unary = lanewise<f64, Floor>;
+    k[118].binary = lanewise<i8, Min>;
+    k[119].binary = [](V128 a, V128 b) { return _mm_min_epu8(a, b); };
+    k[120].binary = lanewise<i8, Max>;
+    k[121].binary = [](V128 a, V128 b) { return _mm_max_epu8(a, b); };
+    k[122].unary = lanewise<f64, Trunc>;
+    k[123].binary = [](V128 a, V128 b) { return _mm_avg_epu8(a, b); };
+
+    // i16x8
+    k[124].unary = extaddPairwise<i8, i16>;
+    k[125].unary = extaddPairwise<u8, u16>;
+    k[126].unary = [](V128 a) { return _mm_madd_epi16(a, _mm_set1_epi16(1)); };
+    k[127].unary = extaddPairwise<u16, u32>;
+    k[128].unary = lanewise<i16, Abs>;
+    k[129].unary = [](V128 a) { return _mm_sub_epi16(_mm_setzero_si128(), a); };
+    k[130].binary = lanewise<i16, Q15MulrSat>;
+    k[131].test = [](V128 a) { return i32{_mm_movemask_epi8(_mm_cmpeq_epi16(a, _mm_setzero_si128())) == 0}; };
+    k[132].test = [](V128 a) { return _mm_movemask_epi8(_mm_packs_epi16(a, _mm_setzero_si128())); };
+    k[133].binary = [](V128 a, V128 b) { return _mm_packs_epi32(a, b); };
+    k[134].binary = narrow<i32, u16>;
+    k[135].unary = [](V128 a) { return _mm_unpacklo_epi8(a, _mm_cmpgt_epi8(_mm_setzero_si128(), a)); };
+    k[136].unary = [](V128 a) { return _mm_unpackhi_epi8(a, _mm_cmpgt_epi8(_mm_setzero_si128(), a)); };
+    k[137].unary = [](V128 a) { return _mm_unpacklo_epi8(a, _mm_setzero_si128()); };
+    k[138].unary = [](V128 a) { return _mm_unpackhi_epi8(a, _mm_setzero_si128()); };
+    k[139].shift = [](V128 a, u32 n) { return _mm_sll_epi16(a, _mm_cvtsi32_si128(n & 15)); };
+    k[140].shift = [](V128 a, u32 n) { return _mm_sra_epi16(a, _mm_cvtsi32_si128(n & 15)); };
+    k[141].shift = [](V128 a, u32 n) { return _mm_srl_epi16(a, _mm_cvtsi32_si128(n & 15)); };
+    k[142].binary = [](V128 a, V128 b) { return _mm_add_epi16(a, b); };
+    k[143].binary = [](V128 a, V128 b) { return _mm_adds_epi16(a, b); };
+    k[144].binary = [](V128 a, V128 b) { return _mm_adds_epu16(a, b); };
+    k[145].binary = [](V128 a, V128 b) { return _mm_sub_epi16(a, b); };
+    k[146].binary = [](V128 a, V128 b) { return _mm_subs_epi16(a, b); };
+    k[147].binary = [](V128 a, V128 b) { return _mm_subs_epu16(a, b); };
+    k[148].unary = lanewise<f64, Nearest>;
+    k[149].binary = [](V128 a, V128 b) { return _mm_mullo_epi16(a, b); };
+    k[150].binary = [](V128 a, V128 b) { return _mm_min_epi16(a, b); };
+    k[151].binary = lanewise<u16, Min>;
+    k[152].binary = [](V128 a, V128 b) { return _mm_max_epi16(a, b); };
+    k[153].binary = lanewise<u16, Max>;
+    k[155].binary = [](V128 a, V128 b) { return _mm_avg_epu16(a, b); };
+    k[156].binary = extmul<i8, i16, 0>;
+    k[157].binary = extmul<i8, i16, 8>;
+    k[158].binary = extmul<u8, u16, 0>;
+    k[159].binary = extmul<u8, u16, 8>;
+
+    // i32x4
+    k[160].unary = lanewise<i32, Abs>;
+    k[161].unary = [](V128 a) { return _mm_sub_epi32(_mm_setzero_si128(), a); };
+    k[163].test = [](V128 a) { return i32{_mm_movemask_epi8(_mm_cmpeq_epi32(a, _mm_setzero_si128())) == 0}; };
+    k[164].test = [](V128 a) { return _mm_movemask_ps(ps(a)); };
+    k[167].unary = [](V128 a) { return _mm_unpacklo_epi16(a, _mm_srai_epi16(a, 15)); };
+    k[168].unary = [](V128 a) { return _mm_unpackhi_epi16(a, _mm_srai_epi16(a, 15)); };
+    k[169].unary = [](V128 a) { return _mm_unpacklo_epi16(a, _mm_setzero_si128()); };
+    k[170].unary = [](V128 a) { return _mm_unpackhi_epi16(a, _mm_setzero_si128()); };
+    k[171].shift = [](V128 a, u32 n) { return _mm_sll_epi32(a, _mm_cvtsi32_si128(n & 31)); };
+    k[172].shift = [](V128 a, u32 n) { return _mm_sra_epi32(a, _mm_cvtsi32_si128(n & 31)); };
+    k[173].shift = [](V128 a, u32 n) { return _mm_srl_epi32(a, _mm_cvtsi32_si128(n & 31)); };
+    k[174].binary = [](V128 a, V128 b) { return _mm_add_epi32(a, b); };
+    k[177].binary = [](V128 a, V128 b) { return _mm_sub_epi32(a, b); };
+    k[181].binary = lanewise<i32, Mul>;
+    k[182].binary = lanewise<i32, Min>;
+    k[183].binary = lanewise<u32, Min>;
+    k[184].binary = lanewise<i32, Max>;
+    k[185].binary = lanewise<u32, Max>;
+    k[186].binary = [](V128 a, V128 b) { return _mm_madd_epi16(a, b); };
+    k[188].binary = [](V128 a, V128 b) { return _mm_unpacklo_epi16(_mm_mullo_epi16(a, b), _mm_mulhi_epi16(a, b)); };
+    k[189].binary = [](V128 a, V128 b) { return _mm_unpackhi_epi16(_mm_mullo_epi16(a, b), _mm_mulhi_epi16(a, b)); };
+    k[190].binary = [](V128 a, V128 b) { return _mm_unpacklo_epi16(_mm_mullo_epi16(a, b), _mm_mulhi_epu16(a, b)); };
+    k[191].binary = [](V128 a, V128 b) { return _mm_unpackhi_epi16(_mm_mullo_epi16(a, b), _mm_mulhi_epu16(a, b)); };
+
+    // i64x2
+    k[192].unary = lanewise<i64, Abs>;
+    k[193].unary = [](V128 a) { return _mm_sub_epi64(_mm_setzero_si128(), a); };
+    k[195].test = allTrue<i64>;
+    k[196].test = [](V128 a) { return _mm_movemask_pd(pd(a)); };
+    k[199].unary = [](V128 a) { return _mm_unpacklo_epi32(a, _mm_srai_epi32(a, 31)); };
+    k[200].unary = [](V128 a) { return _mm_unpackhi_epi32(a, _mm_srai_epi32(a, 31)); };
+    k[201].unary = [](V128 a) { return _mm_unpacklo_epi32(a, _mm_setzero_si128()); };
+    k[202].unary = [](V128 a) { return _mm_unpackhi_epi32(a, _mm_setzero_si128()); };
+    k[203].shift = [](V128 a, u32 n) { return _mm_sll_epi64(a, _mm_cvtsi32_si128(n & 63)); };
+    k[204].shift = shift<i64, Shr>;
+    k[205].shift = [](V128 a, u32 n) { return _mm_srl_epi64(a, _mm_cvtsi32_si128(n & 63)); };
+    k[206].binary = [](V128 a, V128 b) { return _mm_add_epi64(a, b); };
+    k[209].binary = [](V128 a, V128 b) { return _mm_sub_epi64(a, b); };
+    k[213].binary = lanewise<i64, Mul>;
+    k[214].binary = compare<i64, std::equal_to<>>;
+    k[215].binary = compare<i64, std::not_equal_to<>>;
+    k[216].binary = compare<i64, std::less<>>;
+    k[217].binary = compare<i64, std::greater<>>;
+    k[218].binary = compare<i64, std::less_equal<>>;
+    k[219].binary = compare<i64, std::greater_equal<>>;
+    k[220].binary = extmul<i32, i64, 0>;
+    k[221].binary = extmul<i32, i64, 2>;
+    k[222].binary = extmul<u32, u64, 0>;
+    k[223].binary = extmul<u32, u64, 2>;
+
+    // f32x4
+    k[224].unary = [](V128 a) { return _mm_and_si128(a, _mm_set1_epi32(0x7FFFFFFF)); };
+    k[225].unary = [](V128 a) { return _mm_xor_si128(a, _mm_set1_epi32(INT32_MIN)); };
+    k[227].unary = [](V128 a) { return bits(_mm_sqrt_ps(ps(a))); };
+    k[228].binary = [](V128 a, V128 b) { return bits(_mm_add_ps(ps(a), ps(b))); };
+    k[229].binary = [](V128 a, V128 b) { return bits(_mm_sub_ps(ps(a), ps(b))); };
+    k[230].binary = [](V128 a, V128 b) { return bits(_mm_mul_ps(ps(a), ps(b))); };
+    k[231].binary = [](V128 a, V128 b) { return bits(_mm_div_ps(ps(a), ps(b))); };
+    k[232].binary = lanewise<f32, FMin>;
+    k[233].binary = lanewise<f32, FMax>;
+    // pmin is b < a ? b : a, which is minps with swapped operands
+    k[234].binary = [](V128 a, V128 b) { return bits(_mm_min_ps(ps(b), ps(a))); };
+    k[235].binary = [](V128 a, V128 b) { return bits(_mm_max_ps(ps(b), ps(a))); };
+
+    // f64x2
+    k[236].unary = [](V128 a) { return _mm_and_si128(a, _mm_set1_epi64x(INT64_MAX)); };
+    k[237].unary = [](V128 a) { return _mm_xor_si128(a, _mm_set1_epi64x(INT64_MIN)); };
+    k[239].unary = [](V128 a) { return bits(_mm_sqrt_pd(pd(a))); };
+    k[240].binary = [](V128 a, V128 b) { return bits(_mm_add_pd(pd(a), pd(b))); };
+    k[241].binary = [](V128 a, V128 b) { return bits(_mm_sub_pd(pd(a), pd(b))); };
+    k[242].binary = [](V128 a, V128 b) { return bits(_mm_mul_pd(pd(a), pd(b))); };
+    k[243].binary = [](V128 a, V128 b) { return bits(_mm_div_pd(pd(a), pd(b))); };
+    k[244].binary = lanewise<f64, FMin>;
+    k[245].binary = lanewise<f64, FMax>;
+    k[246].binary = [](V128 a, V128 b) { return bits(_mm_min_pd(pd(b), pd(a))); };
+    k[247].binary = [](V128 a, V128 b) { return bits(_mm_max_pd(pd(b), pd(a))); };
+
+    // conversions
+    k[248].unary = truncSat<f32, i32>;
+    k[249].unary = truncSat<f32, u32>;
+    k[250].unary = [](V128 a) { return bits(_mm_cvtepi32_ps(a)); };
+    k[251].unary = convert<u32, f32>;
+    k[252].unary = truncSat<f64, i32>;
+    k[253].unary = truncSat<f64, u32>;
+    k[254].unary = [](V128 a) { return bits(_mm_cvtepi32_pd(a)); };
+    k[255].unary = convert<u32, f64>;
+
+    // extending loads widen the low half like the extend_low opcodes
+    k[1].unary = k[135].unary;
+    k[2].unary = k[137].unary;
+    k[3].unary = k[167].unary;
+    k[4].unary = k[169].unary;
+    k[5].unary = k[199].unary;
+    k[6].unary = k[201].unary;
+    return k;
+}
+
+// SSE4.2 kernels, only installed when the CPU has it
+#define SSE42 __attribute__((target("sse4.2")))
+
+SSE42 V128 shuffleSse42(V128 a, V128 b, V128 mask) {
+    // pshufb zeroes lanes whose index has the top bit set
+    V128 from_a = _mm_or_si128(mask, _mm_cmpgt_epi8(mask, _mm_set1_epi8(15)));
+    V128 from_b = _mm_sub_epi8(mask, _mm_set1_epi8(16));
+    return _mm_or_si128(_mm_shuffle_epi8(a, from_a), _mm_shuffle_epi8(b, from_b));
+}
+
+SSE42 V128 swizzleSse42(V128 a, V128 indices) {
+    // saturation moves indices past 15 to the top bit
+    return _mm_shuffle_epi8(a, _mm_adds_epu8(indices, _mm_set1_epi8(0x70)));
+}
+
+SSE42 V128 popcntSse42(V128 a) {
+    const V128 counts = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const V128 nibble = _mm_set1_epi8(0x0F);
+    V128 lo = _mm_shuffle_epi8(counts, _mm_and_si128(a, nibble));
+    V128 hi = _mm_shuffle_epi8(counts, _mm_and_si128(_mm_srli_epi16(a, 4), nibble));
+    return _mm_add_epi8(lo, hi);
+}
+
+SSE42 V128 q15MulrSatSse42(V128 a, V128 b) {
+    // pmulhrsw gives 0x8000 for -1 * -1, which has to saturate
+    V128 r = _mm_mulhrs_epi16(a, b);
+    return _mm_xor_si128(r, _mm_cmpeq_epi16(r, _mm_set1_epi16(INT16_MIN)));
+}
+
+SSE42 i32 anyTrueSse42(V128 a) { return !_mm_testz_si128(a, a); }
+SSE42 i32 allTrue64Sse42(V128 a) { return _mm_testz_si128(_mm_cmpeq_epi64(a, _mm_setzero_si128()), _mm_set1_epi32(-1)); }
+SSE42 V128 abs8Sse42(V128 a) { return _mm_abs_epi8(a); }
+SSE42 V128 abs16Sse42(V128 a) { return _mm_abs_epi16(a); }
+SSE42 V128 abs32Sse42(V128 a) { return _mm_abs_epi32(a); }
+SSE42 V128 ceil32Sse42(V128 a) { return bits(_mm_round_ps(ps(a), _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC)); }
+SSE42 V128 floor32Sse42(V128 a) { return bits(_mm_round_ps(ps(a), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)); }
+SSE42 V128 trunc32Sse42(V128 a) { return bits(_mm_round_ps(ps(a), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)); }
+SSE42 V128 nearest32Sse42(V128 a) { return bits(_mm_round_ps(ps(a), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)); }
+SSE42 V128 ceil64Sse42(V128 a) { return bits(_mm_round_pd(pd(a), _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC)); }
+SSE42 V128 floor64Sse42(V128 a) { return bits(_mm_round_pd(pd(a), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)); }
+SSE42 V128 trunc64Sse42(V128 a) { return bits(_mm_round_pd(pd(a), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)); }
+SSE42 V128 nearest64Sse42(V128 a) { return bits(_mm_round_pd(pd(a), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)); }
+SSE42 V128 narrowU32Sse42(V128 a, V128 b) { return _mm_packus_epi32(a, b); }
+SSE42 V128 minS8Sse42(V128 a, V128 b) { return _mm_min_epi8(a, b); }
+SSE42 V128 maxS8Sse42(V128 a, V128 b) { return _mm_max_epi8(a, b); }
+SSE42 V128 minU16Sse42(V128 a, V128 b) { return _mm_min_epu16(a, b); }
+SSE42 V128 maxU16Sse42(V128 a, V128 b) { return _mm_max_epu16(a, b); }
+SSE42 V128 mul32Sse42(V128 a, V128 b) { return _mm_mullo_epi32(a, b); }
+SSE42 V128 minS32Sse42(V128 a, V128 b) { return _mm_min_epi32(a, b); }
+SSE42 V128 minU32Sse42(V128 a, V128 b) { return _mm_min_epu32(a, b); }
+SSE42 V128 maxS32Sse42(V128 a, V128 b) { return _mm_max_epi32(a, b); }
+SSE42 V128 maxU32Sse42(V128 a, V128 b) { return _mm_max_epu32(a, b); }
+SSE42 V128 eq64Sse42(V128 a, V128 b) { return _mm_cmpeq_epi64(a, b); }
+SSE42 V128 ne64Sse42(V128 a, V128 b) { return _mm_xor_si128(_mm_cmpeq_epi64(a, b), _mm_set1_epi32(-1)); }
+SSE42 V128 ltS64Sse42(V128 a, V128 b) { return _mm_cmpgt_epi64(b, a); }
+SSE42 V128 gtS64Sse42(V128 a, V128 b) { return _mm_cmpgt_epi64(a, b); }
+SSE42 V128 leS64Sse42(V128 a, V128 b) { return _mm_xor_si128(_mm_cmpgt_epi64(a, b), _mm_set1_epi32(-1)); }
+SSE42 V128 geS64Sse42(V128 a, V128 b) { return _mm_xor_si128(_mm_cmpgt_epi64(b, a), _mm_set1_epi32(-1)); }
+SSE42 V128 extmulLowS64Sse42(V128 a, V128 b) {
+    return _mm_mul_epi32(_mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0)), _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+SSE42 V128 extmulHighS64Sse42(V128 a, V128 b) {
+    return _mm_mul_epi32(_mm_shuffle_epi32(a, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 3, 2, 2)));
+}
+
+#undef SSE42
+
+void useSse42(std::array<Kernel, 256> &k) {
+    k[13].ternary = shuffleSse42;
+    k[14].binary = swizzleSse42;
+    k[83].test = anyTrueSse42;
+    k[96].unary = abs8Sse42;
+    k[98].unary = popcntSse42;
+    k[103].unary = ceil32Sse42;
+    k[104].unary = floor32Sse42;
+    k[105].unary = trunc32Sse42;
+    k[106].unary = nearest32Sse42;
+    k[116].unary = ceil64Sse42;
+    k[117].unary = floor64Sse42;
+    k[118].binary = minS8Sse42;
+    k[120].binary = maxS8Sse42;
+    k[122].unary = trunc64Sse42;
+    k[128].unary = abs16Sse42;
+    k[130].binary = q15MulrSatSse42;
+    k[134].binary = narrowU32Sse42;
+    k[148].unary = nearest64Sse42;
+    k[151].binary = minU16Sse42;
+    k[153].binary = maxU16Sse42;
+    k[160].unary = abs32Sse42;
+    k[181].binary = mul32Sse42;
+    k[182].binary = minS32Sse42;
+    k[183].binary = minU32Sse42;
+    k[184].binary = maxS32Sse42;
+    k[185].binary = maxU32Sse42;
+    k[195].test = allTrue64Sse42;
+    k[214].binary = eq64Sse42;
+    k[215].binary = ne64Sse42;
+    k[216].binary = ltS64Sse42;
+    k[217].binary = gtS64Sse42;
+    k[218].binary = leS64Sse42;
+    k[219].binary = geS64Sse42;
+    k[220].binary = extmulLowS64Sse42;
+    k[221].binary = extmulHighS64Sse42;
+}
+
+std::array<Kernel, 256> hostKernels() {
+    std::array<Kernel, 256> k = baselineKernels();
+    if (__builtin_cpu_supports("sse4.2")) {
+        useSse42(k);
+    }
+    return k;
+}
+
+}
+
+const OpInfo &opInfo(u32 sub_op) {
+    return sub_op < OP_INFO.size() ? OP_INFO[sub_op] : UNKNOWN_OP;
+}
+
+const Kernel *kernels() {
+    static const std::array<Kernel, 256> table = hostKernels();
+    return table.data();
+}
+
+}
@@ -0,0 +1,192 @@
+#include "runtime/snapshot.hpp"
+#include "util/util.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+namespace omega::wass {
+
+namespace {
+
+// File layout: header, global values, one dropped flag per data segment, memory entries, then
+// the memory images at multiples of WASM_PAGE_SIZE. Pages of an image that are all zero are
+// left as holes.
+constexpr char SNAPSHOT_MAGIC[8] = {'O', 'W', 'S', 'N', 'A', 'P', '0', '1'};
+
+struct SnapshotHeader {
+    char magic[8];
+    u64 key;
+    u32 globals;
+    u32 data;
+    u32 memories;
+    u32 reserved;
+};
+
+struct MemoryEntry {
+    u64 offset;
+    u32 pages;
+    u32 reserved;
+};
+
+void writeAll(int fd, const void *bytes, size_t size, u64 offset) {
+    auto p = static_cast<const u8 *>(bytes);
+    while (size) {
+        ssize_t n = pwrite(fd, p, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw std::runtime_error("snapshot: cannot write the image");
+        }
+        p += n;
+        size -= n;
+        offset += n;
+    }
+}
+
+bool readAll(int fd, void *bytes, size_t size, u64 offset) {
+    auto p = static_cast<u8 *>(bytes);
+    while (size) {
+        ssize_t n = pread(fd, p, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+// pages never written read as the shared zero page, scanning them allocates nothing
+bool allZero(const u8 *bytes, size_t size) {
+    auto words = reinterpret_cast<const u64 *>(bytes);
+    for (size_t i = 0; i < size / sizeof(u64); ++i) {
+        if (words[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+u64 alignToPage(u64 offset) {
+    return (offset + WASM_PAGE_SIZE - 1) / WASM_PAGE_SIZE * WASM_PAGE_SIZE;
+}
+
+u64 tableSize(u32 globals, u32 data, u32 memories) {
+    return sizeof(SnapshotHeader) + u64{globals} * sizeof(WasmVal) + data + u64{memories} * sizeof(MemoryEntry);
+}
+
+}
+
+Snapshot::Snapshot(const std::string &path, u64 key, const GlobalsContainer &globals, const DataContainer &data,
+                   const MemsContainer &mems) {
+    std::string tmp_path = path + ".tmp";
+    fd_ = path.empty() ? memfd_create("owasm-snapshot", MFD_CLOEXEC)
+                       : ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("snapshot: cannot create " + (path.empty() ? std::string("a memfd") : tmp_path));
+    }
+    try {
+        for (auto &g : globals) {
+            globals_.push_back(g.op.val);
+        }
+        std::vector<u8> dropped;
+        for (auto &segment : data) {
+            dropped_.push_back(segment.empty());
+            dropped.push_back(segment.empty());
+        }
+        std::vector<MemoryEntry> entries;
+        u64 end = tableSize(globals_.size(), dropped.size(), mems.size());
+        for (auto &mem : mems) {
+            u64 offset = alignToPage(end);
+            entries.push_back({offset, mem.pages(), 0});
+            memories_.push_back({offset, mem.pages()});
+            end = offset + mem.size();
+        }
+        if (ftruncate(fd_, static_cast<off_t>(end)) != 0) {
+            throw std::runtime_error("snapshot: cannot size the image");
+        }
+        for (size_t i = 0; i < mems.size(); ++i) {
+            for (size_t page = 0; page < mems[i].size(); page += WASM_PAGE_SIZE) {
+                if (!allZero(mems[i].base() + page, WASM_PAGE_SIZE)) {
+                    writeAll(fd_, mems[i].base() + page, WASM_PAGE_SIZE, entries[i].offset + page);
+                }
+            }
+        }
+        SnapshotHeader header{};
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        header.key = key;
+        header.globals = globals_.size();
+        header.data = dropped.size();
+        header.memories = entries.size();
+        u64 offset = 0;
+        writeAll(fd_, &header, sizeof(header), offset);
+        writeAll(fd_, globals_.data(), globals_.size() * sizeof(WasmVal), offset += sizeof(header));
+        writeAll(fd_, dropped.data(), dropped.size(), offset += globals_.size() * sizeof(WasmVal));
+        writeAll(fd_, entries.data(), entries.size() * sizeof(MemoryEntry), offset += dropped.size());
+        if (!path.empty()) {
+            // a concurrent reader sees the old snapshot or the whole new one
+            std::filesystem::rename(tmp_path, path);
+        }
+    } catch (...) {
+        close(fd_);
+        if (!path.empty()) {
+            unlink(tmp_path.c_str());
+        }
+        throw;
+    }
+}
+
+Snapshot::~Snapshot() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+std::shared_ptr<const Snapshot> Snapshot::open(const std::string &path, u64 key) {
+    std::shared_ptr<Snapshot> snapshot(new Snapshot());
+    // written copy-on-write only, a read-only descriptor maps them writable just as well
+    snapshot->fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    int fd = snapshot->fd_;
+    SnapshotHeader header{};
+    if (fd < 0 || !readAll(fd, &header, sizeof(header), 0) ||
+        std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.key != key) {
+        return nullptr;
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || tableSize(header.globals, header.data, header.memories) > u64(info.st_size)) {
+        return nullptr;
+    }
+    snapshot->globals_.resize(header.globals);
+    std::vector<u8> dropped(header.data);
+    std::vector<MemoryEntry> entries(header.memories);
+    u64 offset = sizeof(header);
+    if (!readAll(fd, snapshot->globals_.data(), header.globals * sizeof(WasmVal), offset) ||
+        !readAll(fd, dropped.data(), dropped.size(), offset += header.globals * sizeof(WasmVal)) ||
+        !readAll(fd, entries.data(), entries.size() * sizeof(MemoryEntry), offset += dropped.size())) {
+        return nullptr;
+    }
+    snapshot->dropped_.assign(dropped.begin(), dropped.end());
+    for (auto &entry : entries) {
+        u64 bytes = u64{entry.pages} * WASM_PAGE_SIZE;
+        if (entry.offset % WASM_PAGE_SIZE != 0 || entry.offset + bytes > u64(info.st_size)) {
+            return nullptr;
+        }
+        snapshot->memories_.push_back({entry.offset, entry.pages});
+    }
+    return snapshot;
+}
+
+u64 snapshotKey(const module::WasmModule &module, std::string_view init_export) {
+    return util::hashBytes(init_export.data(), init_export.size(), util::hashFile(module.path));
+}
+
+}
@@ -2,18 +2,60 @@
 #include "runtime/init.hpp"
 namespace omega::wass {
 
-void Store::init(module::WasmModule &module) {
-    funcs_   = initRuntimeFunctions(module);
-    globals_ = initGlobals(module);
+void Store::init(std::shared_ptr<CompiledModule> compiled, std::shared_ptr<const Snapshot> snapshot) {
+    compiled_ = std::move(compiled);
+    snapshot_ = std::move(snapshot);
+    const module::WasmModule &module = compiled_->module();
     mems_    = initMemory(module);
-    initData(module, mems_);
+    if (snapshot_) {
+        const std::vector<Snapshot::Memory> &images = snapshot_->memories();
+        if (images.size() != mems_.size() || snapshot_->globals().size() != module.globalSection.size() ||
+            snapshot_->dataCount() != module.dataSection.size()) {
+            throw std::runtime_error("snapshot does not match the module");
+        }
+        for (size_t i = 0; i < mems_.size(); ++i) {
+            mems_[i].mapImage(snapshot_->fd(), images[i].offset, images[i].pages);
+        }
+    } else {
+        initData(module, mems_);
+    }
+    initValues();
+}
+
+void Store::reset() {
+    const module::WasmModule &module = compiled_->module();
+    for (size_t i = 0; i < mems_.size(); ++i) {
+        // discarded pages of a mapped image read as the image again
+        mems_[i].reset(snapshot_ ? snapshot_->memories()[i].pages : module.memorySection[i].min);
+    }
+    if (!snapshot_) {
+        initData(module, mems_);
+    }
+    initValues();
 }
 
-RuntimeFunction& Store::getFunc(u32 f_ind) {
-    return funcs_[f_ind];
+std::shared_ptr<const Snapshot> Store::snapshot(const std::string &path, u64 key) const {
+    return std::make_shared<const Snapshot>(path, key, globals_, data_, mems_);
+}
+
+void Store::initValues() {
+    const module::WasmModule &module = compiled_->module();
+    globals_ = initGlobals(module);
+    data_    = initDataSegments(module);
+    if (!snapshot_) {
+        return;
+    }
+    for (size_t i = 0; i < globals_.size(); ++i) {
+        globals_[i].op.val = snapshot_->globals()[i];
+    }
+    for (u32 i = 0; i < data_.size(); ++i) {
+        if (snapshot_->dropped(i)) {
+            data_[i] = {};
+        }
+    }
 }
 
 char *Store::getMem(u32 mem_ind, u32 ind) {
-    return mems_[mem_ind].data() + ind;
+    return reinterpret_cast<char *>(mems_[mem_ind].base()) + ind;
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,650 @@
+#include "runtime/interpreter.hpp"
+#include "runtime/simd.hpp"
+#include "runtime/atomics.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+
+// Stack tier engine where every opcode is a separate function and dispatch is a guaranteed tail
+// call. ip, sp, the locals base, the cached top of stack and the code base travel in argument
+// registers from handler to handler. Frame layout and semantics match threadedCode.
+// Without the attribute the engine still builds for reference, but deep dispatch chains can
+// exhaust the native stack, so selecting it needs a compiler that guarantees the tail calls.
+#if defined(__has_cpp_attribute) && __has_cpp_attribute(clang::musttail)
+#define MUSTTAIL [[clang::musttail]]
+#elif defined(OWASM_TAIL_CALL_DISPATCH)
+#error "OWASM_TAIL_CALL_DISPATCH requires [[clang::musttail]] support"
+#else
+#define MUSTTAIL
+#endif
+
+namespace omega::wass {
+
+// every handler takes all of them so that calls between handlers stay tail calls, most use only some
+#define TAIL_ARGS [[maybe_unused]] Interpreter *vm, [[maybe_unused]] const Instr *ip, [[maybe_unused]] WasmVal *sp, \
+                  [[maybe_unused]] WasmVal *locals, [[maybe_unused]] WasmVal tos, [[maybe_unused]] const Instr *code
+#define NEXT() MUSTTAIL return reinterpret_cast<TailHandler>(ip[1].handler)(vm, ip + 1, sp, locals, tos, code)
+#define JUMP(target) MUSTTAIL return reinterpret_cast<TailHandler>((target)->handler)(vm, target, sp, locals, tos, code)
+// upper halves of v128 values, see threadedCode
+#define UPPER(p) ((p) + vm->value_stack_.upperOffset())
+
+struct TailCallEngine {
+    using TailHandler = void (*)(Interpreter *, const Instr *, WasmVal *, WasmVal *, WasmVal, const Instr *);
+
+    [[noreturn]] static void unimplemented(const Instr *ip, const Instr *code, i64 op) {
+        std::cerr << "Unimplemented opcode: " << op << " at IP=" << ip - code << std::endl;
+        std::abort();
+    }
+
+    static void unreachable(TAIL_ARGS) {
+        std::cerr << "Unimplemented opcode: unreachable at IP=" << ip - code << std::endl;
+        std::abort();
+    }
+
+    static void unsupported(TAIL_ARGS) {
+        unimplemented(ip, code, ip->imm.i);
+    }
+
+    static void nop(TAIL_ARGS) {
+        NEXT();
+    }
+
+    static void if_(TAIL_ARGS) {
+        i64 cond = tos.i;
+        tos = *--sp;
+        if (!cond) {
+            const Instr *target = code + ip->imm.br.ip;
+            JUMP(target);
+        }
+        NEXT();
+    }
+
+    static void else_(TAIL_ARGS) {
+        const Instr *target = code + ip->imm.br.ip;
+        JUMP(target);
+    }
+
+    // ip points at the instruction or data slot holding the branch target
+    static void branch(TAIL_ARGS) {
+        const BranchTarget &br = ip->imm.br;
+        if (br.drop) {
+            *sp++ = tos;
+            std::copy(sp - br.keep, sp, sp - br.keep - br.drop);
+            std::copy(UPPER(sp) - br.keep, UPPER(sp), UPPER(sp) - br.keep - br.drop);
+            sp -= br.drop;
+            tos = *--sp;
+        }
+        const Instr *target = code + br.ip;
+        JUMP(target);
+    }
+
+    static void br(TAIL_ARGS) {
+        MUSTTAIL return branch(vm, ip, sp, locals, tos, code);
+    }
+
+    static void br_if(TAIL_ARGS) {
+        i64 cond = tos.i;
+        tos = *--sp;
+        if (cond) {
+            MUSTTAIL return branch(vm, ip, sp, locals, tos, code);
+        }
+        NEXT();
+    }
+
+    static void br_table(TAIL_ARGS) {
+        // label slots follow the instruction, an out of range index takes the default label
+        i64 index = static_cast<u32>(tos.i);
+        tos = *--sp;
+        const Instr *label = ip + 1 + std::min(index, ip->imm.i);
+        MUSTTAIL return branch(vm, label, sp, locals, tos, code);
+    }
+
+    static void end(TAIL_ARGS) {
+        // only the function end is left in the pre-decoded code: move the results down to the frame base
+        *sp++ = tos;
+        MUSTTAIL return frameExit(vm, ip, sp, locals, tos, code);
+    }
+
+    static void frameExit(TAIL_ARGS) {
+        if (vm->frames_.size() == vm->entry_depth_) {
+            vm->top_frame_->ip = ip + 1 - code;
+            vm->value_stack_.setSp(sp);
+            return;
+        }
+        u32 results = vm->top_frame_->func->signature.results.size();
+        std::copy_n(sp - results, results, locals);
+        if (vm->top_frame_->func->simd) {
+            std::copy_n(UPPER(sp) - results, results, UPPER(locals));
+        }
+        vm->value_stack_.setSp(locals + results);
+        vm->popFrame();
+
+        Frame *frame = vm->top_frame_;
+        code = frame->code;
+        ip = code + frame->ip;
+        locals = frame->locals;
+        sp = vm->value_stack_.sp();
+        tos = *--sp;
+        JUMP(ip);
+    }
+
+    static void call(TAIL_ARGS) {
+        // a Wasm callee gets a new frame, a host function returns into the current one
+        *sp++ = tos;
+        Frame *caller = vm->top_frame_;
+        caller->ip = ip + 1 - code;
+        vm->value_stack_.setSp(sp);
+        vm->callFunc(ip->imm.i);
+
+        Frame *frame = vm->top_frame_;
+        code = frame->code;
+        ip = code + frame->ip;
+        locals = frame->locals;
+        sp = vm->value_stack_.sp();
+        if (frame == caller) {
+            tos = *--sp;
+        }
+        JUMP(ip);
+    }
+
+    static void drop(TAIL_ARGS) {
+        tos = *--sp;
+        NEXT();
+    }
+
+    static void select(TAIL_ARGS) {
+        i64 cond = tos.i;
+        sp -= 2;
+        tos = cond ? sp[0] : sp[1];
+        NEXT();
+    }
+
+    static void local_get(TAIL_ARGS) {
+        *sp++ = tos;
+        tos = locals[ip->imm.i];
+        NEXT();
+    }
+
+    static void local_set(TAIL_ARGS) {
+        locals[ip->imm.i] = tos;
+        tos = *--sp;
+        NEXT();
+    }
+
+    static void local_tee(TAIL_ARGS) {
+        locals[ip->imm.i] = tos;
+        NEXT();
+    }
+
+    static void i32_const(TAIL_ARGS) {
+        *sp++ = tos;
+        tos.i = ip->imm.i;
+        NEXT();
+    }
+
+    static void i32_ne(TAIL_ARGS) {
+        WasmVal lhs = *--sp;
+        tos.i = static_cast<i32>(lhs.i) != static_cast<i32>(tos.i);
+        NEXT();
+    }
+
+    static void i32_lt_s(TAIL_ARGS) {
+        WasmVal lhs = *--sp;
+        tos.i = static_cast<i32>(lhs.i) < static_cast<i32>(tos.i);
+        NEXT();
+    }
+
+    static void i32_add(TAIL_ARGS) {
+        WasmVal lhs = *--sp;
+        tos.i = static_cast<i32>(lhs.i + tos.i);
+        NEXT();
+    }
+
+    static void i32_sub(TAIL_ARGS) {
+        WasmVal lhs = *--sp;
+        tos.i = static_cast<i32>(lhs.i - tos.i);
+        NEXT();
+    }
+
+    static void i32_and(TAIL_ARGS) {
+        WasmVal lhs = *--sp;
+        tos.i &= lhs.i;
+        NEXT();
+    }
+
+    // Integer accesses: T is the memory type, widened to the slot by its signedness
+    template <typename T>
+    static void load(TAIL_ARGS) {
+        T value;
+        std::memcpy(&value, vm->memory_ + static_cast<u32>(tos.i) + ip->imm.i, sizeof(T));
+        tos.i = value;
+        NEXT();
+    }
+
+    template <typename T>
+    static void store(TAIL_ARGS) {
+        WasmVal addr = *--sp;
+        T value = static_cast<T>(tos.i);
+        std::memcpy(vm->memory_ + static_cast<u32>(addr.i) + ip->imm.i, &value, sizeof(T));
+        tos = *--sp;
+        NEXT();
+    }
+
+    // Float accesses: slots hold floats as f64 like in threadedCode, f32 values are widened on
+    // load and narrowed on store
+    template <typename T>
+    static void float_load(TAIL_ARGS) {
+        T value;
+        std::memcpy(&value, vm->memory_ + static_cast<u32>(tos.i) + ip->imm.i, sizeof(T));
+        tos.f = value;
+        NEXT();
+    }
+
+    template <typename T>
+    static void float_store(TAIL_ARGS) {
+        WasmVal addr = *--sp;
+        T value = static_cast<T>(tos.f);
+        std::memcpy(vm->memory_ + static_cast<u32>(addr.i) + ip->imm.i, &value, sizeof(T));
+        tos = *--sp;
+        NEXT();
+    }
+
+    static void memory_size(TAIL_ARGS) {
+        *sp++ = tos;
+        tos.i = vm->linear_memory_->pages();
+        NEXT();
+    }
+
+    static void memory_grow(TAIL_ARGS) {
+        tos.i = vm->linear_memory_->grow(static_cast<u32>(tos.i));
+        NEXT();
+    }
+
+    static void memory_init(TAIL_ARGS) {
+        vm->linear_memory_->init(static_cast<u32>(sp[-2].i), vm->store_->dataSegment(ip->imm.i),
+                                 static_cast<u32>(sp[-1].i), static_cast<u32>(tos.i));
+        sp -= 2;
+        tos = *--sp;
+        NEXT();
+    }
+
+    static void data_drop(TAIL_ARGS) {
+        vm->store_->dropData(ip->imm.i);
+        NEXT();
+    }
+
+    static void memory_copy(TAIL_ARGS) {
+        vm->linear_memory_->copy(static_cast<u32>(sp[-2].i), static_cast<u32>(sp[-1].i), static_cast<u32>(tos.i));
+        sp -= 2;
+        tos = *--sp;
+        NEXT();
+    }
+
+    static void memory_fill(TAIL_ARGS) {
+        vm->linear_memory_->fill(static_cast<u32>(sp[-2].i), static_cast<u8>(sp[-1].i), static_cast<u32>(tos.i));
+        sp -= 2;
+        tos = *--sp;
+        NEXT();
+    }
+
+    static simd::V128 v128At(const Interpreter *vm, const WasmVal *p) {
+        return simd::join(p->i, UPPER(p)->i);
+    }
+
+    // the cached top of stack has its upper half at the position it would be spilled to
+    static simd::V128 topV128(const Interpreter *vm, const WasmVal *sp, WasmVal tos) {
+        return simd::join(tos.i, UPPER(sp)->i);
+    }
+
+    static void setTopV128(const Interpreter *vm, WasmVal *sp, WasmVal &tos, simd::V128 v) {
+        tos.i = simd::low(v);
+        UPPER(sp)->i = simd::high(v);
+    }
+
+    static const simd::Kernel &kernel(const Instr *ip) {
+        return simd::kernels()[ip->imm.simd.kernel];
+    }
+
+    static u8 *simdAddress(const Interpreter *vm, const Instr *ip, WasmVal addr) {
+        return vm->memory_ + static_cast<u32>(addr.i) + ip->imm.simd.offset;
+    }
+
+    static void v128_const(TAIL_ARGS) {
+        // the upper half is kept in the following slot
+        *sp++ = tos;
+        tos.i = ip->imm.i;
+        UPPER(sp)->i = (++ip)->imm.i;
+        NEXT();
+    }
+
+    static void v128_load(TAIL_ARGS) {
+        u8 *address = simdAddress(vm, ip, tos);
+        std::memcpy(&tos.i, address, 8);
+        std::memcpy(&UPPER(sp)->i, address + 8, 8);
+        NEXT();
+    }
+
+    // Loads of fewer than 16 bytes, widened or splatted by the kernel
+    template <typename T>
+    static void v128_load_part(TAIL_ARGS) {
+        T value;
+        std::memcpy(&value, simdAddress(vm, ip, tos), sizeof(T));
+        setTopV128(vm, sp, tos, kernel(ip).unary(simd::join(static_cast<i64>(value), 0)));
+        NEXT();
+    }
+
+    static void v128_store(TAIL_ARGS) {
+        u8 *address = simdAddress(vm, ip, sp[-1]);
+        std::memcpy(address, &tos.i, 8);
+        std::memcpy(address + 8, &UPPER(sp)->i, 8);
+        --sp;
+        tos = *--sp;
+        NEXT();
+    }
+
+    static void v128_load_lane(TAIL_ARGS) {
+        simd::V128 vec = topV128(vm, sp, tos);
+        std::memcpy(reinterpret_cast<u8 *>(&vec) + ip->imm.simd.lane * ip->imm.simd.size,
+                    simdAddress(vm, ip, sp[-1]), ip->imm.simd.size);
+        --sp;
+        setTopV128(vm, sp, tos, vec);
+        NEXT();
+    }
+
+    static void v128_store_lane(TAIL_ARGS) {
+        simd::V128 vec = topV128(vm, sp, tos);
+        std::memcpy(simdAddress(vm, ip, sp[-1]),
+                    reinterpret_cast<u8 *>(&vec) + ip->imm.simd.lane * ip->imm.simd.size, ip->imm.simd.size);
+        --sp;
+        tos = *--sp;
+        NEXT();
+    }
+
+    static void i8x16_shuffle(TAIL_ARGS) {
+        // the upper lane indices are kept in the following slot
+        simd::V128 mask = simd::join(ip->imm.i, ip[1].imm.i);
+        simd::V128 vec = simd::kernels()[simd::SHUFFLE].ternary(v128At(vm, sp - 1), topV128(vm, sp, tos), mask);
+        ++ip;
+        --sp;
+        setTopV128(vm, sp, tos, vec);
+        NEXT();
+    }
+
+    static void v128_unary(TAIL_ARGS) {
+        setTopV128(vm, sp, tos, kernel(ip).unary(topV128(vm, sp, tos)));
+        NEXT();
+    }
+
+    static void v128_binary(TAIL_ARGS) {
+        simd::V128 vec = kernel(ip).binary(v128At(vm, sp - 1), topV128(vm, sp, tos));
+        --sp;
+        setTopV128(vm, sp, tos, vec);
+        NEXT();
+    }
+
+    static void v128_ternary(TAIL_ARGS) {
+        simd::V128 vec = kernel(ip).ternary(v128At(vm, sp - 2), v128At(vm, sp - 1), topV128(vm, sp, tos));
+        sp -= 2;
+        setTopV128(vm, sp, tos, vec);
+        NEXT();
+    }
+
+    static void v128_test(TAIL_ARGS) {
+        tos.i = kernel(ip).test(topV128(vm, sp, tos));
+        NEXT();
+    }
+
+    static void v128_shift(TAIL_ARGS) {
+        simd::V128 vec = kernel(ip).shift(v128At(vm, sp - 1), static_cast<u32>(tos.i));
+        --sp;
+        setTopV128(vm, sp, tos, vec);
+        NEXT();
+    }
+
+    static void v128_splat(TAIL_ARGS) {
+        setTopV128(vm, sp, tos, kernel(ip).splat(tos));
+        NEXT();
+    }
+
+    static void v128_extract_lane(TAIL_ARGS) {
+        tos = kernel(ip).extract(topV128(vm, sp, tos), ip->imm.simd.lane);
+        NEXT();
+    }
+
+    static void v128_replace_lane(TAIL_ARGS) {
+        simd::V128 vec = kernel(ip).replace(v128At(vm, sp - 1), tos, ip->imm.simd.lane);
+        --sp;
+        setTopV128(vm, sp, tos, vec);
+        NEXT();
+    }
+
+    static void v128_local_get(TAIL_ARGS) {
+        *sp++ = tos;
+        tos = locals[ip->imm.i];
+        *UPPER(sp) = *UPPER(locals + ip->imm.i);
+        NEXT();
+    }
+
+    static void v128_local_set(TAIL_ARGS) {
+        locals[ip->imm.i] = tos;
+        *UPPER(locals + ip->imm.i) = *UPPER(sp);
+        tos = *--sp;
+        NEXT();
+    }
+
+    static void v128_local_tee(TAIL_ARGS) {
+        locals[ip->imm.i] = tos;
+        *UPPER(locals + ip->imm.i) = *UPPER(sp);
+        NEXT();
+    }
+
+    static void select_v128(TAIL_ARGS) {
+        i64 cond = tos.i;
+        sp -= 2;
+        tos = cond ? sp[0] : sp[1];
+        if (!cond) {
+            *UPPER(sp) = UPPER(sp)[1];
+        }
+        NEXT();
+    }
+
+    static void atomic_load(TAIL_ARGS) {
+        u8 *address = atomics::address(vm->memory_, tos, ip->imm.atomic);
+        tos.i = atomics::result(atomics::load(address, ip->imm.atomic.size), ip->imm.atomic);
+        NEXT();
+    }
+
+    static void atomic_store(TAIL_ARGS) {
+        u8 *address = atomics::address(vm->memory_, sp[-1], ip->imm.atomic);
+        atomics::store(address, ip->imm.atomic.size, tos.i);
+        --sp;
+        tos = *--sp;
+        NEXT();
+    }
+
+    static void atomic_rmw(TAIL_ARGS) {
+        u8 *address = atomics::address(vm->memory_, *--sp, ip->imm.atomic);
+        tos.i = atomics::result(atomics::rmw(address, ip->imm.atomic.size,
+                                             static_cast<atomics::Rmw>(ip->imm.atomic.rmw), tos.i),
+                                ip->imm.atomic);
+        NEXT();
+    }
+
+    static void atomic_cmpxchg(TAIL_ARGS) {
+        sp -= 2;
+        u8 *address = atomics::address(vm->memory_, sp[0], ip->imm.atomic);
+        tos.i = atomics::result(atomics::cmpxchg(address, ip->imm.atomic.size, sp[1].i, tos.i), ip->imm.atomic);
+        NEXT();
+    }
+
+    static void memory_atomic_wait(TAIL_ARGS) {
+        sp -= 2;
+        u8 *address = atomics::address(vm->memory_, sp[0], ip->imm.atomic);
+        tos.i = vm->linear_memory_->wait(address - vm->memory_, sp[1].i, ip->imm.atomic.size, tos.i);
+        NEXT();
+    }
+
+    static void memory_atomic_notify(TAIL_ARGS) {
+        u8 *address = atomics::address(vm->memory_, *--sp, ip->imm.atomic);
+        tos.i = vm->linear_memory_->notify(address - vm->memory_, static_cast<u32>(tos.i));
+        NEXT();
+    }
+
+    static void atomic_fence(TAIL_ARGS) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        NEXT();
+    }
+
+    static void i32_add_local_const(TAIL_ARGS) {
+        *sp++ = tos;
+        tos.i = static_cast<i32>(locals[ip->imm.local_const.local].i + ip->imm.local_const.value);
+        NEXT();
+    }
+
+    static void br_if_i32_ne(TAIL_ARGS) {
+        WasmVal lhs = *--sp;
+        bool taken = static_cast<i32>(lhs.i) != static_cast<i32>(tos.i);
+        tos = *--sp;
+        if (taken) {
+            MUSTTAIL return branch(vm, ip, sp, locals, tos, code);
+        }
+        NEXT();
+    }
+
+    static void br_if_i32_lt_s_locals(TAIL_ARGS) {
+        // the branch target is kept in the following slot
+        if (static_cast<i32>(locals[ip->imm.locals.lhs].i) < static_cast<i32>(locals[ip->imm.locals.rhs].i)) {
+            MUSTTAIL return branch(vm, ip + 1, sp, locals, tos, code);
+        }
+        ++ip;
+        NEXT();
+    }
+
+    static void loop_header(TAIL_ARGS) {
+        // back edges branch here too, so the counter sees every iteration
+        if (countHot(vm->top_frame_->func->loopHotness[ip->imm.i]) < vm->options_.loop_threshold) {
+            NEXT();
+        }
+        *sp++ = tos;
+        vm->top_frame_->ip = ip + 1 - code;
+        vm->value_stack_.setSp(sp);
+        if (!vm->osrEnter(ip->imm.i)) {
+            tos = *--sp;
+            NEXT();
+        }
+        sp = vm->value_stack_.sp();
+        MUSTTAIL return frameExit(vm, ip, sp, locals, tos, code);
+    }
+
+    // Opcodes without a handler stay empty, the translator turns them into unsupported
+    static std::array<const void *, runtime::InternalBytecode::atomic_fence + 1> makeTable() {
+        std::array<const void *, runtime::InternalBytecode::atomic_fence + 1> table{};
+        auto set = [&table](u16 op, TailHandler handler) {
+            table[op] = reinterpret_cast<const void *>(handler);
+        };
+        set(runtime::Bytecode::unreachable, unreachable);
+        set(runtime::Bytecode::nop, nop);
+        set(runtime::Bytecode::block, nop);
+        set(runtime::Bytecode::loop, nop);
+        set(runtime::Bytecode::if_, if_);
+        set(runtime::Bytecode::else_, else_);
+        set(runtime::Bytecode::end, end);
+        set(runtime::Bytecode::br, br);
+        set(runtime::Bytecode::br_if, br_if);
+        set(runtime::Bytecode::br_table, br_table);
+        set(runtime::Bytecode::return_, br);
+        set(runtime::Bytecode::call, call);
+        set(runtime::Bytecode::drop, drop);
+        set(runtime::Bytecode::select, select);
+        set(runtime::Bytecode::local_get, local_get);
+        set(runtime::Bytecode::local_set, local_set);
+        set(runtime::Bytecode::local_tee, local_tee);
+        set(runtime::Bytecode::i32_load, load<i32>);
+        set(runtime::Bytecode::i64_load, load<i64>);
+        set(runtime::Bytecode::i32_load8_s, load<int8_t>);
+        set(runtime::Bytecode::i32_load8_u, load<u8>);
+        set(runtime::Bytecode::i32_load16_s, load<int16_t>);
+        set(runtime::Bytecode::i32_load16_u, load<u16>);
+        set(runtime::Bytecode::i64_load8_s, load<int8_t>);
+        set(runtime::Bytecode::i64_load8_u, load<u8>);
+        set(runtime::Bytecode::i64_load16_s, load<int16_t>);
+        set(runtime::Bytecode::i64_load16_u, load<u16>);
+        set(runtime::Bytecode::i64_load32_s, load<i32>);
+        set(runtime::Bytecode::i64_load32_u, load<u32>);
+        set(runtime::Bytecode::f32_load, float_load<f32>);
+        set(runtime::Bytecode::f64_load, float_load<f64>);
+        set(runtime::Bytecode::i32_store, store<u32>);
+        set(runtime::Bytecode::i64_store, store<u64>);
+        set(runtime::Bytecode::i32_store8, store<u8>);
+        set(runtime::Bytecode::i32_store16, store<u16>);
+        set(runtime::Bytecode::i64_store8, store<u8>);
+        set(runtime::Bytecode::i64_store16, store<u16>);
+        set(runtime::Bytecode::i64_store32, store<u32>);
+        set(runtime::Bytecode::f32_store, float_store<f32>);
+        set(runtime::Bytecode::f64_store, float_store<f64>);
+        set(runtime::Bytecode::memory_size, memory_size);
+        set(runtime::Bytecode::memory_grow, memory_grow);
+        set(runtime::Bytecode::i32_const, i32_const);
+        set(runtime::Bytecode::i32_ne, i32_ne);
+        set(runtime::Bytecode::i32_lt_s, i32_lt_s);
+        set(runtime::Bytecode::i32_add, i32_add);
+        set(runtime::Bytecode::i32_sub, i32_sub);
+        set(runtime::Bytecode::i32_and, i32_and);
+        set(runtime::InternalBytecode::unsupported, unsupported);
+        set(runtime::InternalBytecode::i32_add_local_const, i32_add_local_const);
+        set(runtime::InternalBytecode::br_if_i32_ne, br_if_i32_ne);
+        set(runtime::InternalBytecode::br_if_i32_lt_s_locals, br_if_i32_lt_s_locals);
+        set(runtime::InternalBytecode::loop_header, loop_header);
+        set(runtime::InternalBytecode::memory_init, memory_init);
+        set(runtime::InternalBytecode::data_drop, data_drop);
+        set(runtime::InternalBytecode::memory_copy, memory_copy);
+        set(runtime::InternalBytecode::memory_fill, memory_fill);
+        set(runtime::InternalBytecode::v128_const, v128_const);
+        set(runtime::InternalBytecode::v128_load, v128_load);
+        set(runtime::InternalBytecode::v128_load8, v128_load_part<u8>);
+        set(runtime::InternalBytecode::v128_load16, v128_load_part<u16>);
+        set(runtime::InternalBytecode::v128_load32, v128_load_part<u32>);
+        set(runtime::InternalBytecode::v128_load64, v128_load_part<i64>);
+        set(runtime::InternalBytecode::v128_store, v128_store);
+        set(runtime::InternalBytecode::v128_load_lane, v128_load_lane);
+        set(runtime::InternalBytecode::v128_store_lane, v128_store_lane);
+        set(runtime::InternalBytecode::i8x16_shuffle, i8x16_shuffle);
+        set(runtime::InternalBytecode::v128_unary, v128_unary);
+        set(runtime::InternalBytecode::v128_binary, v128_binary);
+        set(runtime::InternalBytecode::v128_ternary, v128_ternary);
+        set(runtime::InternalBytecode::v128_test, v128_test);
+        set(runtime::InternalBytecode::v128_shift, v128_shift);
+        set(runtime::InternalBytecode::v128_splat, v128_splat);
+        set(runtime::InternalBytecode::v128_extract_lane, v128_extract_lane);
+        set(runtime::InternalBytecode::v128_replace_lane, v128_replace_lane);
+        set(runtime::InternalBytecode::v128_local_get, v128_local_get);
+        set(runtime::InternalBytecode::v128_local_set, v128_local_set);
+        set(runtime::InternalBytecode::v128_local_tee, v128_local_tee);
+        set(runtime::InternalBytecode::select_v128, select_v128);
+        set(runtime::InternalBytecode::atomic_load, atomic_load);
+        set(runtime::InternalBytecode::atomic_store, atomic_store);
+        set(runtime::InternalBytecode::atomic_rmw, atomic_rmw);
+        set(runtime::InternalBytecode::atomic_cmpxchg, atomic_cmpxchg);
+        set(runtime::InternalBytecode::memory_atomic_wait, memory_atomic_wait);
+        set(runtime::InternalBytecode::memory_atomic_notify, memory_atomic_notify);
+        set(runtime::InternalBytecode::atomic_fence, atomic_fence);
+        return table;
+    }
+};
+
+void Interpreter::tailCallCode(bool export_handlers) {
+    static const auto dispatch_table = TailCallEngine::makeTable();
+
+    if (export_handlers) {
+        handlers_ = dispatch_table.data();
+        return;
+    }
+
+    const Instr *code = top_frame_->code;
+    const Instr *ip = code + top_frame_->ip;
+    WasmVal tos{.i = 0};
+    reinterpret_cast<TailCallEngine::TailHandler>(ip->handler)(this, ip, value_stack_.sp(), top_frame_->locals, tos, code);
+}
+
+}
@@ -0,0 +1,41 @@
+#include "runtime/threads.hpp"
+#include "runtime/interpreter.hpp"
+
+namespace omega::wass {
+
+// wasi-threads keeps the top bits of thread ids free
+constexpr u32 MAX_THREAD_ID = 0x1FFFFFFF;
+
+u32 ThreadGroup::newId() {
+    std::lock_guard lock(lock_);
+    if (next_id_ > MAX_THREAD_ID) {
+        throw std::runtime_error("thread ids exhausted");
+    }
+    return next_id_++;
+}
+
+void ThreadGroup::add(std::thread thread) {
+    std::lock_guard lock(lock_);
+    threads_.push_back(std::move(thread));
+}
+
+void ThreadGroup::joinAll() {
+    while (true) {
+        std::thread thread;
+        {
+            std::lock_guard lock(lock_);
+            if (threads_.empty()) {
+                return;
+            }
+            thread = std::move(threads_.back());
+            threads_.pop_back();
+        }
+        thread.join();
+    }
+}
+
+i64 wasiThreadSpawn(i64 start_arg) {
+    return Interpreter::running()->spawnWasiThread(static_cast<i32>(start_arg));
+}
+
+}
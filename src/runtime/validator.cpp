@@ -0,0 +1,650 @@
+#include "runtime/validator.hpp"
+#include "runtime/simd.hpp"
+#include "runtime/atomics.hpp"
+#include "util/util.hpp"
+#include <string>
+#include <iterator>
+
+namespace omega::wass {
+using namespace runtime;
+
+namespace {
+
+constexpr ValType ANY       = static_cast<ValType>(0);   // operand of a polymorphic stack after unconditional branches
+constexpr ValType FUNCREF   = static_cast<ValType>(reftype::funcref);
+constexpr ValType EXTERNREF = static_cast<ValType>(reftype::externref);
+
+struct Conversion {
+    ValType from;
+    ValType to;
+};
+
+// Operand and result type of i32.wrap_i64 (0xA7) through i64.extend32_s (0xC4)
+constexpr Conversion CONVERSIONS[] = {
+    {I64, I32}, {F32, I32}, {F32, I32}, {F64, I32}, {F64, I32},
+    {I32, I64}, {I32, I64}, {F32, I64}, {F32, I64}, {F64, I64}, {F64, I64},
+    {I32, F32}, {I32, F32}, {I64, F32}, {I64, F32}, {F64, F32},
+    {I32, F64}, {I32, F64}, {I64, F64}, {I64, F64}, {F32, F64},
+    {F32, I32}, {F64, I64}, {I32, F32}, {I64, F64},
+    {I32, I32}, {I32, I32}, {I64, I64}, {I64, I64}, {I64, I64},
+};
+
+// Operand and result type of the saturating truncations, 0xFC 0 through 7
+constexpr Conversion SAT_CONVERSIONS[] = {
+    {F32, I32}, {F32, I32}, {F64, I32}, {F64, I32},
+    {F32, I64}, {F32, I64}, {F64, I64}, {F64, I64},
+};
+
+struct ValidationControl {
+    u8 op;
+    std::vector<ValType> params;
+    std::vector<ValType> results;
+    u32 height;         // operand stack height at block entry, below the parameters
+    bool unreachable;
+};
+
+class Validator {
+public:
+    Validator(const module::FuncSignature &sig, const std::vector<ValType> &locals, const ModuleTypes &types)
+        : sig_(sig), locals_(locals), types_(types) {}
+
+    void validate(std::span<const u8> code);
+    bool usesV128() const { return uses_v128_; }
+private:
+    [[noreturn]] void fail(const std::string &msg) const {
+        throw std::runtime_error("invalid function body at offset " + std::to_string(offset_) + ": " + msg);
+    }
+
+    void push(ValType type) {
+        uses_v128_ |= type == V128;
+        stack_.push_back(type);
+    }
+
+    void push(const std::vector<ValType> &types) {
+        for (auto t : types) {
+            push(t);
+        }
+    }
+
+    ValType pop() {
+        ValidationControl &ctrl = controls_.back();
+        if (stack_.size() == ctrl.height) {
+            if (ctrl.unreachable) {
+                return ANY;
+            }
+            fail("operand stack underflow");
+        }
+        ValType type = stack_.back();
+        stack_.pop_back();
+        return type;
+    }
+
+    ValType pop(ValType expected) {
+        ValType actual = pop();
+        if (actual != expected && actual != ANY && expected != ANY) {
+            fail("type mismatch, expected " + std::to_string(expected) + " got " + std::to_string(actual));
+        }
+        return actual == ANY ? expected : actual;
+    }
+
+    void pop(const std::vector<ValType> &types) {
+        for (auto it = types.rbegin(); it != types.rend(); ++it) {
+            pop(*it);
+        }
+    }
+
+    void pushControl(u8 op, std::vector<ValType> params, std::vector<ValType> results) {
+        controls_.push_back({op, std::move(params), std::move(results), static_cast<u32>(stack_.size()), false});
+        push(controls_.back().params);
+    }
+
+    ValidationControl popControl() {
+        ValidationControl &ctrl = controls_.back();
+        pop(ctrl.results);
+        if (stack_.size() != ctrl.height) {
+            fail("values left on the operand stack at the end of a block");
+        }
+        ValidationControl popped = std::move(ctrl);
+        controls_.pop_back();
+        return popped;
+    }
+
+    const std::vector<ValType> &labelTypes(u64 depth) const {
+        if (depth >= controls_.size()) {
+            fail("branch depth out of range");
+        }
+        const ValidationControl &target = controls_[controls_.size() - 1 - depth];
+        return target.op == Bytecode::loop ? target.params : target.results;
+    }
+
+    void setUnreachable() {
+        stack_.resize(controls_.back().height);
+        controls_.back().unreachable = true;
+    }
+
+    void blockType(i64 block_type, std::vector<ValType> &params, std::vector<ValType> &results) const {
+        if (block_type >= 0) {
+            auto &sig = types_.types->at(block_type);
+            params = sig.params;
+            results = sig.results;
+        } else if ((block_type & 0x7F) != blocktype::empty) {
+            results = {static_cast<ValType>(block_type & 0x7F)};
+        }
+    }
+
+    ValType local(u64 index) const {
+        if (index >= locals_.size()) {
+            fail("local index out of range");
+        }
+        return locals_[index];
+    }
+
+    const GlobalType &global(u64 index) const {
+        if (index >= types_.global_types.size()) {
+            fail("global index out of range");
+        }
+        return types_.global_types[index];
+    }
+
+    ValType table(u64 index) const {
+        if (index >= types_.table_types.size()) {
+            fail("table index out of range");
+        }
+        return types_.table_types[index];
+    }
+
+    void memory() const {
+        if (types_.memory_count == 0) {
+            fail("memory instruction without a memory");
+        }
+    }
+
+    void data(u64 index) const {
+        if (index >= types_.data_count) {
+            fail("data segment index out of range");
+        }
+    }
+
+    const module::FuncSignature &funcType(u64 index) const {
+        if (index >= types_.func_types.size()) {
+            fail("function index out of range");
+        }
+        return types_.types->at(types_.func_types[index]);
+    }
+
+    void unop(ValType in, ValType out) {
+        pop(in);
+        push(out);
+    }
+
+    void binop(ValType in, ValType out) {
+        pop(in);
+        pop(in);
+        push(out);
+    }
+
+    void popRef() {
+        ValType type = pop();
+        if (type != ANY && type != FUNCREF && type != EXTERNREF) {
+            fail("expected a reference type");
+        }
+    }
+
+    void validateControl(const DecodedInstr &instr, const u8 *&ptr, const u8 *end);
+    void validateMisc(const DecodedInstr &instr);
+    void validateSimd(const DecodedInstr &instr);
+    void validateAtomic(const DecodedInstr &instr);
+    void validateNumeric(u8 op);
+
+    const module::FuncSignature &sig_;
+    const std::vector<ValType> &locals_;
+    const ModuleTypes &types_;
+    std::vector<ValType> stack_;
+    std::vector<ValidationControl> controls_;
+    size_t offset_ = 0;
+    bool uses_v128_ = false;
+};
+
+void Validator::validate(std::span<const u8> code) {
+    const u8 *ptr = code.data();
+    const u8 *end = ptr + code.size();
+    controls_.push_back({Bytecode::block, {}, sig_.results, 0, false});
+
+    while (ptr < end && !controls_.empty()) {
+        offset_ = ptr - code.data();
+        DecodedInstr instr = decodeInstr(ptr, end);
+        switch (instr.op) {
+            case Bytecode::unreachable:
+            case Bytecode::nop:
+            case Bytecode::block:
+            case Bytecode::loop:
+            case Bytecode::if_:
+            case Bytecode::else_:
+            case Bytecode::end:
+            case Bytecode::br:
+            case Bytecode::br_if:
+            case Bytecode::br_table:
+            case Bytecode::return_:
+            case Bytecode::call:
+            case CALL_INDIRECT:
+            case Bytecode::return_call:
+            case Bytecode::return_call_indirect:
+                validateControl(instr, ptr, end);
+                break;
+            case Bytecode::drop:
+                pop();
+                break;
+            case Bytecode::select: {
+                pop(I32);
+                ValType t1 = pop();
+                ValType t2 = pop();
+                if (t1 == FUNCREF || t1 == EXTERNREF || t2 == FUNCREF || t2 == EXTERNREF) {
+                    fail("untyped select on reference operands");
+                }
+                if (t1 != t2 && t1 != ANY && t2 != ANY) {
+                    fail("select operands differ in type");
+                }
+                push(t1 == ANY ? t2 : t1);
+                break;
+            }
+            case Bytecode::select_t: {
+                ValType type = static_cast<ValType>(instr.imm.i);
+                pop(I32);
+                pop(type);
+                pop(type);
+                push(type);
+                break;
+            }
+            case Bytecode::local_get:
+                push(local(instr.imm.i));
+                break;
+            case Bytecode::local_set:
+                pop(local(instr.imm.i));
+                break;
+            case Bytecode::local_tee:
+                unop(local(instr.imm.i), local(instr.imm.i));
+                break;
+            case Bytecode::global_get:
+                push(global(instr.imm.i).type);
+                break;
+            case Bytecode::global_set:
+                if (!global(instr.imm.i).mut) {
+                    fail("global.set of an immutable global");
+                }
+                pop(global(instr.imm.i).type);
+                break;
+            case Bytecode::table_get:
+                unop(I32, table(instr.imm.i));
+                break;
+            case Bytecode::table_set:
+                pop(table(instr.imm.i));
+                pop(I32);
+                break;
+            case Bytecode::memory_size:
+                memory();
+                push(I32);
+                break;
+            case Bytecode::memory_grow:
+                memory();
+                unop(I32, I32);
+                break;
+            case Bytecode::i32_const:
+                push(I32);
+                break;
+            case Bytecode::i64_const:
+                push(I64);
+                break;
+            case Bytecode::f32_const:
+                push(F32);
+                break;
+            case Bytecode::f64_const:
+                push(F64);
+                break;
+            case REF_NULL:
+                push(static_cast<ValType>(instr.imm.i));
+                break;
+            case REF_IS_NULL:
+                popRef();
+                push(I32);
+                break;
+            case REF_FUNC:
+                funcType(instr.imm.i);
+                push(FUNCREF);
+                break;
+            case prefix::misc:
+                validateMisc(instr);
+                break;
+            case prefix::simd:
+                validateSimd(instr);
+                break;
+            case prefix::atomic:
+                validateAtomic(instr);
+                break;
+            default:
+                validateNumeric(instr.op);
+                break;
+        }
+    }
+    if (!controls_.empty() || ptr != end) {
+        fail("function body is not terminated by its final end");
+    }
+}
+
+void Validator::validateControl(const DecodedInstr &instr, const u8 *&ptr, const u8 *end) {
+    switch (instr.op) {
+        case Bytecode::unreachable:
+            setUnreachable();
+            break;
+        case Bytecode::nop:
+            break;
+        case Bytecode::block:
+        case Bytecode::loop:
+        case Bytecode::if_: {
+            if (instr.op == Bytecode::if_) {
+                pop(I32);
+            }
+            std::vector<ValType> params, results;
+            blockType(instr.imm.i, params, results);
+            pop(params);
+            pushControl(instr.op, std::move(params), std::move(results));
+            break;
+        }
+        case Bytecode::else_: {
+            if (controls_.back().op != Bytecode::if_) {
+                fail("else outside of an if");
+            }
+            ValidationControl ctrl = popControl();
+            pushControl(Bytecode::else_, std::move(ctrl.params), std::move(ctrl.results));
+            break;
+        }
+        case Bytecode::end: {
+            ValidationControl ctrl = popControl();
+            if (ctrl.op == Bytecode::if_ && ctrl.params != ctrl.results) {
+                fail("if without else must leave its parameters unchanged");
+            }
+            push(ctrl.results);
+            break;
+        }
+        case Bytecode::br:
+            pop(labelTypes(instr.imm.i));
+            setUnreachable();
+            break;
+        case Bytecode::br_if: {
+            pop(I32);
+            const std::vector<ValType> &label = labelTypes(instr.imm.i);
+            pop(label);
+            push(label);
+            break;
+        }
+        case Bytecode::br_table: {
+            pop(I32);
+            std::vector<u64> labels(instr.imm.i + 1);
+            for (auto &label : labels) {
+                label = util::readULEB128(ptr, end);
+            }
+            size_t arity = labelTypes(labels.back()).size();
+            for (u64 label : labels) {
+                const std::vector<ValType> &types = labelTypes(label);
+                if (types.size() != arity) {
+                    fail("br_table labels differ in arity");
+                }
+                pop(types);
+                push(types);
+            }
+            pop(labelTypes(labels.back()));
+            setUnreachable();
+            break;
+        }
+        case Bytecode::return_:
+            pop(sig_.results);
+            setUnreachable();
+            break;
+        case Bytecode::call: {
+            auto &callee = funcType(instr.imm.i);
+            pop(callee.params);
+            push(callee.results);
+            break;
+        }
+        case CALL_INDIRECT: {
+            table(instr.imm2);
+            pop(I32);
+            auto &callee = types_.types->at(instr.imm.i);
+            pop(callee.params);
+            push(callee.results);
+            break;
+        }
+        case Bytecode::return_call:
+        case Bytecode::return_call_indirect: {
+            auto &callee = instr.op == Bytecode::return_call ? funcType(instr.imm.i) : types_.types->at(instr.imm.i);
+            if (callee.results != sig_.results) {
+                fail("tail call result types differ from the caller");
+            }
+            if (instr.op == Bytecode::return_call_indirect) {
+                table(instr.imm2);
+                pop(I32);
+            }
+            pop(callee.params);
+            setUnreachable();
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void Validator::validateMisc(const DecodedInstr &instr) {
+    u32 sub_op = instr.sub_op;
+    if (sub_op < std::size(SAT_CONVERSIONS)) {
+        unop(SAT_CONVERSIONS[sub_op].from, SAT_CONVERSIONS[sub_op].to);
+        return;
+    }
+    switch (sub_op) {
+        case 8:  // memory.init
+            data(instr.imm.i);
+            [[fallthrough]];
+        case 10: // memory.copy
+        case 11: // memory.fill
+            memory();
+            pop(I32);
+            pop(I32);
+            pop(I32);
+            break;
+        case 12: // table.init
+            table(instr.imm2);
+            pop(I32);
+            pop(I32);
+            pop(I32);
+            break;
+        case 14: // table.copy
+            table(instr.imm.i);
+            table(instr.imm2);
+            pop(I32);
+            pop(I32);
+            pop(I32);
+            break;
+        case 9:  // data.drop
+            data(instr.imm.i);
+            break;
+        case 13: // elem.drop
+            break;
+        case 15: // table.grow
+            pop(I32);
+            pop(table(instr.imm.i));
+            push(I32);
+            break;
+        case 16: // table.size
+            table(instr.imm.i);
+            push(I32);
+            break;
+        case 17: // table.fill
+            pop(I32);
+            pop(table(instr.imm.i));
+            pop(I32);
+            break;
+        default:
+            fail("unknown 0xFC opcode " + std::to_string(sub_op));
+    }
+}
+
+void Validator::validateSimd(const DecodedInstr &instr) {
+    const simd::OpInfo &info = simd::opInfo(instr.sub_op);
+    if (info.lanes && instr.imm2 >= info.lanes) {
+        fail("lane index out of range");
+    }
+    switch (info.shape) {
+        case simd::Shape::Load:
+            memory();
+            unop(I32, V128);
+            break;
+        case simd::Shape::Store:
+        case simd::Shape::StoreLane:
+            memory();
+            pop(V128);
+            pop(I32);
+            break;
+        case simd::Shape::LoadLane:
+            memory();
+            pop(V128);
+            unop(I32, V128);
+            break;
+        case simd::Shape::Const:
+            push(V128);
+            break;
+        case simd::Shape::Shuffle:
+            for (u64 lanes = instr.imm.i, i = 0; i < 8; ++i) {
+                if (((lanes >> 8 * i) & 0xFF) >= 32 || ((instr.imm_hi >> 8 * i) & 0xFF) >= 32) {
+                    fail("shuffle lane index out of range");
+                }
+            }
+            binop(V128, V128);
+            break;
+        case simd::Shape::Unary:
+            unop(V128, V128);
+            break;
+        case simd::Shape::Binary:
+            binop(V128, V128);
+            break;
+        case simd::Shape::Ternary:
+            pop(V128);
+            binop(V128, V128);
+            break;
+        case simd::Shape::Test:
+            unop(V128, I32);
+            break;
+        case simd::Shape::Shift:
+            pop(I32);
+            unop(V128, V128);
+            break;
+        case simd::Shape::Splat:
+            unop(info.scalar, V128);
+            break;
+        case simd::Shape::ExtractLane:
+            unop(V128, info.scalar);
+            break;
+        case simd::Shape::ReplaceLane:
+            pop(info.scalar);
+            unop(V128, V128);
+            break;
+        case simd::Shape::None:
+            fail("unknown 0xFD opcode " + std::to_string(instr.sub_op));
+    }
+}
+
+void Validator::validateAtomic(const DecodedInstr &instr) {
+    if (instr.sub_op == atomic::fence) {
+        return;
+    }
+    memory();
+    u32 sub_op = instr.sub_op;
+    atomics::Access access = sub_op == atomic::memory_wait64 ? atomics::Access{8, I64}
+                           : sub_op < atomic::load ? atomics::Access{4, I32}
+                           : atomics::access(sub_op);
+    if (instr.imm2 > 3 || (1u << instr.imm2) != access.size) {
+        fail("atomic alignment must be the natural alignment");
+    }
+    switch (sub_op) {
+        case atomic::memory_notify:
+            binop(I32, I32);
+            break;
+        case atomic::memory_wait32:
+        case atomic::memory_wait64:
+            pop(I64);
+            pop(access.type);
+            unop(I32, I32);
+            break;
+        default:
+            if (sub_op < atomic::store) {
+                unop(I32, access.type);
+            } else if (sub_op < atomic::rmw_add) {
+                pop(access.type);
+                pop(I32);
+            } else {
+                if (sub_op >= atomic::rmw_cmpxchg) {
+                    pop(access.type);
+                }
+                pop(access.type);
+                unop(I32, access.type);
+            }
+            break;
+    }
+}
+
+void Validator::validateNumeric(u8 op) {
+    if (op >= Bytecode::i32_load && op <= Bytecode::i64_store32) {
+        memory();
+    }
+    if (op >= Bytecode::i32_load && op <= Bytecode::i64_load32_u) {
+        constexpr ValType LOADS[] = {I32, I64, F32, F64, I32, I32, I32, I32, I64, I64, I64, I64, I64, I64};
+        unop(I32, LOADS[op - Bytecode::i32_load]);
+    } else if (op >= Bytecode::i32_store && op <= Bytecode::i64_store32) {
+        constexpr ValType STORES[] = {I32, I64, F32, F64, I32, I32, I64, I64, I64};
+        pop(STORES[op - Bytecode::i32_store]);
+        pop(I32);
+    } else if (op == Bytecode::i32_eqz) {
+        unop(I32, I32);
+    } else if (op <= Bytecode::i32_ge_u && op >= Bytecode::i32_eq) {
+        binop(I32, I32);
+    } else if (op == Bytecode::i64_eqz) {
+        unop(I64, I32);
+    } else if (op >= Bytecode::i64_eq && op <= Bytecode::i64_ge_u) {
+        binop(I64, I32);
+    } else if (op >= Bytecode::f32_eq && op <= Bytecode::f32_ge) {
+        binop(F32, I32);
+    } else if (op >= Bytecode::f64_eq && op <= Bytecode::f64_ge) {
+        binop(F64, I32);
+    } else if (op >= Bytecode::i32_clz && op <= Bytecode::i32_popcnt) {
+        unop(I32, I32);
+    } else if (op >= Bytecode::i32_add && op <= Bytecode::i32_rotr) {
+        binop(I32, I32);
+    } else if (op >= Bytecode::i64_clz && op <= Bytecode::i64_popcnt) {
+        unop(I64, I64);
+    } else if (op >= Bytecode::i64_add && op <= Bytecode::i64_rotr) {
+        binop(I64, I64);
+    } else if (op >= Bytecode::f32_abs && op <= Bytecode::f32_sqrt) {
+        unop(F32, F32);
+    } else if (op >= Bytecode::f32_add && op <= Bytecode::f32_copysign) {
+        binop(F32, F32);
+    } else if (op >= Bytecode::f64_abs && op <= Bytecode::f64_sqrt) {
+        unop(F64, F64);
+    } else if (op >= Bytecode::f64_add && op <= Bytecode::f64_copysign) {
+        binop(F64, F64);
+    } else if (op >= Bytecode::i32_wrap_i64 && op < Bytecode::i32_wrap_i64 + std::size(CONVERSIONS)) {
+        const Conversion &conv = CONVERSIONS[op - Bytecode::i32_wrap_i64];
+        unop(conv.from, conv.to);
+    } else {
+        fail("unknown opcode " + std::to_string(op));
+    }
+}
+
+}
+
+bool validateFunction(std::span<const u8> code,
+                      const module::FuncSignature &sig,
+                      const std::vector<ValType> &locals,
+                      const ModuleTypes &types) {
+    Validator validator(sig, locals, types);
+    validator.validate(code);
+    return validator.usesV128();
+}
+
+}
@@ -1,15 +1,55 @@
 #include "runtime/vm.hpp"
-#include "util/module_parser.hpp"
+#include "runtime/init.hpp"
 
 namespace omega::wass {
 
 void Vm::loadModule(std::string_view path) {
-    ModuleParser parser(path);
-    module_ = parser.parseFromFile();
-    interpreter_.init(module_);
+    compiled_ = Interpreter::compile(path, options_);
+    if (!options_.snapshot_path.empty()) {
+        snapshot_ = Snapshot::open(options_.snapshot_path, snapshotKey(compiled_->module(), options_.init_export));
+        if (!snapshot_) {
+            snapshot_ = snapshot(options_.init_export, options_.snapshot_path);
+        }
+    }
+    interpreter_.init(compiled_, snapshot_);
+    if (!snapshot_ && !options_.init_export.empty()) {
+        interpreter_.initialize(exportedFunc(options_.init_export));
+    }
+}
+
+std::unique_ptr<Interpreter> Vm::instantiate() const {
+    return instantiate(snapshot_);
+}
+
+std::unique_ptr<Interpreter> Vm::instantiate(std::shared_ptr<const Snapshot> snapshot) const {
+    auto instance = std::make_unique<Interpreter>();
+    instance->init(compiled_, std::move(snapshot));
+    return instance;
+}
+
+std::shared_ptr<const Snapshot> Vm::snapshot(std::string_view init_export, const std::string &path) const {
+    Interpreter instance;
+    instance.init(compiled_);
+    if (!init_export.empty()) {
+        instance.initialize(exportedFunc(init_export));
+    }
+    // an anonymous snapshot is never looked up by key
+    return instance.snapshot(path, path.empty() ? 0 : snapshotKey(compiled_->module(), init_export));
 }
 
 void Vm::start() {
     interpreter_.start();
 }
-}
\ No newline at end of file
+
+u32 Vm::spawnThread(std::string_view export_name, const std::vector<WasmVal> &args) {
+    return interpreter_.spawnThread(exportedFunc(export_name), args);
+}
+
+u32 Vm::exportedFunc(std::string_view name) const {
+    std::optional<u32> f_ind = findExportedFunc(compiled_->module(), name);
+    if (!f_ind) {
+        throw std::runtime_error("exported function not found: " + std::string(name));
+    }
+    return *f_ind;
+}
+}
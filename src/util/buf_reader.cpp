@@ -1,8 +1,41 @@
 #include "util/buf_reader.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdexcept>
+
 namespace omega::wass::util {
 
-BufReader::BufReader(std::ifstream stream): buff_(std::istreambuf_iterator<char>(stream), {}) {
-    buf_ptr_ = buff_.data();
+MappedFile::MappedFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open module " + path);
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot open module " + path);
+    }
+    size_ = info.st_size;
+    void *mapped = size_ ? mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+    // the mapping stays valid without the descriptor
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("cannot map module " + path);
+    }
+    data_ = static_cast<const u8 *>(mapped);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(const_cast<u8 *>(data_), size_);
+    }
+}
+
+BufReader::BufReader(const std::string &path) : file_(std::make_shared<const MappedFile>(path)) {
+    buf_ptr_ = file_->bytes().data();
+    size_ = file_->bytes().size();
 }
 
 i64 BufReader::readLeb128() {
@@ -11,6 +44,7 @@ i64 BufReader::readLeb128() {
     uint8_t byte = 0;
 
     for (i32 i = 0; i < MAX_LEB128_BYTES; i++, next<u8>()) {
+        checkAvailable(1);
         byte = *get();
         result |= i64 (byte & 0x7F) << shift;
         shift += 7;
@@ -28,10 +62,15 @@ i64 BufReader::readLeb128() {
 }
 
 std::string BufReader::readStr() {
-    i64 len = readLeb128();
-    std::string str(reinterpret_cast<char*>(get()), len);
-    offset_ += len;
-    return str;
+    std::span<const u8> bytes = readSpan(readULeb128());
+    return {reinterpret_cast<const char *>(bytes.data()), bytes.size()};
+}
+
+std::span<const u8> BufReader::readSpan(u64 size) {
+    checkAvailable(size);
+    std::span<const u8> bytes(get(), size);
+    offset_ += size;
+    return bytes;
 }
 
 u64 BufReader::readULeb128() {
@@ -39,10 +78,11 @@ u64 BufReader::readULeb128() {
     unsigned shift = 0;
 
     for (i32 i = 0; i < MAX_LEB128_BYTES; i++) {
+        checkAvailable(1);
         u8 byte = *get();
         result |= u64(byte & 0x7F) << shift;
+        next<u8>();
         if ((byte & 0x80) == 0) {
-            next<u8>();
             return result;
         }
         shift += 7;
@@ -1,17 +1,18 @@
 #include "util/module_parser.hpp"
 #include <cstring>
 #include "util/util.hpp"
-#include <fstream>
 
 namespace omega::wass {
 using namespace module;
 
-ModuleParser::ModuleParser(std::string_view path) : bufReader_(std::ifstream(path.data(), std::ios::binary)) {
+ModuleParser::ModuleParser(std::string_view path) : path_(path), bufReader_(path_) {
 
 }
 
 WasmModule ModuleParser::parseFromFile() {
     WasmModule module;
+    module.path = path_;
+    module.bytes = bufReader_.file();
     while (!bufReader_.isEnd()) {
         auto sectionId = static_cast<SectionType>(bufReader_.readULeb128());
 
@@ -63,6 +64,10 @@ WasmModule ModuleParser::parseFromFile() {
             }
         }
     }
+    // a file cut off between sections still parses, its bodies would be missing
+    if (module.functionSection.size() != module.codeSection.size()) {
+        throw std::runtime_error("function and code section have inconsistent lengths");
+    }
     return module;
 
 }
@@ -79,8 +84,16 @@ Limits ModuleParser::parseLimits() {
     u8 flag = bufReader_.read<u8>();
     Limits limits;
     limits.min = bufReader_.readULeb128();
+    if (flag & ~(lims::max_flag | lims::shared_flag)) {
+        throw std::runtime_error("unknown limits flags: " + std::to_string(flag));
+    }
+    limits.hasMax = flag & lims::max_flag;
+    limits.shared = flag & lims::shared_flag;
+    if (limits.shared && !limits.hasMax) {
+        throw std::runtime_error("shared memory must have a maximum");
+    }
 
-    if (flag == lims::max_flag) {
+    if (limits.hasMax) {
         limits.max = bufReader_.readULeb128();
     } else {
         limits.max = 0;
@@ -214,18 +227,16 @@ template<>
 FunctionBody ModuleParser::parseOneSectionEntry() {
     FunctionBody body;
     i64 func_size = bufReader_.readULeb128();
+    const u8 *start = bufReader_.get();
     i64 locals_count = bufReader_.readULeb128();
-    u8 *start = bufReader_.get();
     for (i64 i = 0; i < locals_count; ++i) {
         LocalVar l;
         l.count = bufReader_.readULeb128();
         l.type  = bufReader_.read<ValType>();
         body.locals.emplace_back(l);
     }
-    func_size -= bufReader_.get() - start + 1;
-    body.code.reserve(func_size);
-    body.code.assign(bufReader_.get(), bufReader_.get() + func_size);
-    bufReader_.next(func_size);
+    func_size -= bufReader_.get() - start;
+    body.code = bufReader_.readSpan(func_size);
     return body;
 }
 
@@ -233,14 +244,16 @@ FunctionBody ModuleParser::parseOneSectionEntry() {
 template<>
 DataSegment ModuleParser::parseOneSectionEntry() {
     DataSegment d;
-    d.memIndex = bufReader_.readULeb128();
-    d.offsetExpr = parseExpr();
-    i64 sz = bufReader_.readULeb128();
-    //todo memcpy?
-    d.data.reserve(sz);
-    for (i64 i = 0; i < sz; ++i) {
-        d.data.emplace_back(bufReader_.read<u8>());
+    // 0: active in memory 0, 1: passive, 2: active with an explicit memory index
+    u64 flags = bufReader_.readULeb128();
+    d.passive = flags == 1;
+    d.memIndex = flags == 2 ? bufReader_.readULeb128() : 0;
+    if (!d.passive) {
+        d.offsetExpr = parseExpr();
     }
+    i64 sz = bufReader_.readULeb128();
+    d.fileOffset = bufReader_.offset();
+    d.data = bufReader_.readSpan(sz);
     return d;
 }
 
@@ -1,5 +1,8 @@
 #include "util/util.hpp"
 #include "algorithm"
+#include <cstring>
+#include <fstream>
+#include <vector>
 
 namespace omega::wass::util {
 
@@ -39,6 +42,39 @@ i64 readLEB128(const u8* ptr) {
     throw std::overflow_error("SLEB128 exceeds maximum length for int64_t");
 }
 
+u64 readULEB128(const u8 *&ptr, const u8 *end) {
+    u64 result = 0;
+    unsigned shift = 0;
+
+    for (unsigned i = 0; i < MAX_LEB128_BYTES && ptr < end; i++) {
+        u8 byte = *ptr++;
+        result |= u64(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return result;
+        }
+        shift += 7;
+    }
+    throw std::overflow_error("ULEB128 exceeds maximum length for uint64_t");
+}
+
+i64 readLEB128(const u8 *&ptr, const u8 *end) {
+    i64 result = 0;
+    unsigned shift = 0;
+    u8 byte = 0;
+
+    for (unsigned i = 0; i < MAX_LEB128_BYTES && ptr < end; i++) {
+        byte = *ptr++;
+        result |= i64(byte & 0x7F) << shift;
+        shift += 7;
+        if ((byte & 0x80) == 0) {
+            if ((byte & 0x40) && shift < 64) {
+                result |= - (i64(1) << shift);
+            }
+            return result;
+        }
+    }
+    throw std::overflow_error("SLEB128 exceeds maximum length for int64_t");
+}
 
 void trim(std::string &s) {
     const auto not_space = [](char c){ return !std::isspace(static_cast<unsigned char>(c)); };
@@ -67,4 +103,32 @@ std::pair<std::string, std::string> parse_call(const std::string &input) {
     return {name, inside};
 }
 
+u64 hashBytes(const void *bytes, size_t size, u64 seed) {
+    constexpr u64 prime = 0x100000001b3ULL;
+    auto p = static_cast<const u8 *>(bytes);
+    u64 hash = seed;
+    for (; size >= sizeof(u64); p += sizeof(u64), size -= sizeof(u64)) {
+        u64 word;
+        std::memcpy(&word, p, sizeof(word));
+        hash = (hash ^ word) * prime;
+    }
+    for (; size; ++p, --size) {
+        hash = (hash ^ *p) * prime;
+    }
+    return hash;
+}
+
+u64 hashFile(const std::string &path, u64 seed) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("cannot read " + path);
+    }
+    u64 hash = seed;
+    std::vector<char> buffer(1 << 16);
+    while (file.read(buffer.data(), buffer.size()) || file.gcount()) {
+        hash = hashBytes(buffer.data(), file.gcount(), hash);
+    }
+    return hash;
+}
+
 }
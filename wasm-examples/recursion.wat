@@ -0,0 +1,8 @@
+(module
+  ;; unbounded self recursion without locals, every tier stops it with "call stack exhausted"
+  (func $main
+    call $main
+  )
+
+  (export "_start" (func $main))
+)